@@ -11,17 +11,29 @@ set(PROJECT_STR "fmt-ex")
 
 ## Optional modules
 set(ENABLE_WAVEFORM 1)
+set(ENABLE_WAVE_OUT 0)  # DMA waveform output; see timer_pcbDetails.h (stm32)
 set(ENABLE_GHOST_PROBE 1)
+set(ENABLE_PARAMS 1)     # TouchParam, stored by fmt_params.c
+set(ENABLE_PROFILE 1)    # ISR and task run times; see fmt_profile.h
 include(${FIRMENT_DIR}/cmake-tools/fmtTransport.cmake)
 
 # update_page_size is used in:
 # - web-ui for <Image> upload widget (via /web-ui/src/generated/flashPage.ts)
 # - fmt_update.c from configured fmt_update.h
 set(UPDATE_PAGE_SIZE 256)
+set(UPDATE_WINDOW_PAGES 4) # pages in flight: target buffers, UI unacked pages.
 set(DATA_MSG_PAYLOAD_SIZE_MAX 32)
 set(LOG_TEXT_MAX_SIZE      50)
-set(PROBE_SIGNAL_MAX_COUNT 6) # Todo: remove
+
+# Ghost Probe: max probes in a RunScanCtl, and max signals per ProbeSignals msg.
+# These are checked against the packet size when ghostProbe.c is compiled.
+set(PROBE_MAX_COUNT        16)
+set(PROBE_SIGNAL_MAX_COUNT 5)
+set(ADDR_PROBE_MAX_COUNT   8) # max RAM addresses in a RunAddrScan
+set(PARAM_VALUES_MAX_COUNT 10) # parameter values per ParamValues msg.
 
 message(STATUS "Update page size: ${UPDATE_PAGE_SIZE}")
+message(STATUS "Update window pages: ${UPDATE_WINDOW_PAGES}")
 message(STATUS "Message payload size max: ${DATA_MSG_PAYLOAD_SIZE_MAX}")
 message(STATUS "Log text max size: ${LOG_TEXT_MAX_SIZE}")
+message(STATUS "Probe max count: ${PROBE_MAX_COUNT}")
@@ -21,6 +21,10 @@
 # Generally, the alignment required is the power of 2 that can contain the whole 
 # vector table.  Example: table has beween 65-128 words: alignm to 128*4 = 512B.
 # Regardless of VT alignment requirement, the minimum IMAGE_HEADER_SIZE is 256.
+#
+# PARAMS_STORE_ADDRESS
+# fmt_params.c keeps parameters in PARAMS_SECTOR_COUNT erase-blocks of
+# PARAMS_SECTOR_SIZE from here, used in turn (at least 2, of 2kB or more).
 
 if(${MCU_VARIANT} STREQUAL "XMC4700")
   set(UPDATE_SUPPORTED 1)
@@ -33,6 +37,9 @@ if(${MCU_VARIANT} STREQUAL "XMC4700")
   set(PARTITION_UPDATE_ADDRESS        0x0C080000) # sector 10
   set(PARTITION_BACKUP_ADDRESS        0x0C0C0000) # sector 11
   set(TEST_RESULT_ADDRESS             0x0C01C000) # sector 7 (last 16kB sector)
+  set(PARAMS_STORE_ADDRESS            0x0C014000) # sectors 5-6
+  set(PARAMS_SECTOR_SIZE              0x4000)
+  set(PARAMS_SECTOR_COUNT             2)
   set(IMAGE_HEADER_SIZE 1024)
 elseif(${MCU_VARIANT} STREQUAL "stm32l476") # Total: 1M in 2 banks
   set(UPDATE_SUPPORTED 1)
@@ -45,6 +52,9 @@ elseif(${MCU_VARIANT} STREQUAL "stm32l476") # Total: 1M in 2 banks
   set(PARTITION_UPDATE_ADDRESS        0x08080000) # bank 2
   set(PARTITION_BACKUP_ADDRESS        0x080C0000) # bank 2
   set(TEST_RESULT_ADDRESS             0x080FF800) # last page of flash
+  set(PARAMS_STORE_ADDRESS            0x080FD800) # 4 pages before test result
+  set(PARAMS_SECTOR_SIZE              0x800)
+  set(PARAMS_SECTOR_COUNT             4)
   set(IMAGE_HEADER_SIZE 512)
 elseif(${MCU_VARIANT} STREQUAL "stm32g431")
 # Total: 0x20000 (128kB) in 1 bank
@@ -54,4 +64,7 @@ elseif(${MCU_VARIANT} STREQUAL "stm32g431")
   set(SECTOR_SIZE                 0x800) # 2kB (erase block - STM nomen: "page")
   set(PMEM_ROOT_ADDRESS_DIRECT        0x08000000) # bank 1
   set(PMEM_ROOT_ADDRESS_CACHED        0x08000000) # no cache; same as prev.
+  set(PARAMS_STORE_ADDRESS            0x0801E000) # last 4 pages
+  set(PARAMS_SECTOR_SIZE              0x800)
+  set(PARAMS_SECTOR_COUNT             4)
 endif()
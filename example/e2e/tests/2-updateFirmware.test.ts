@@ -58,7 +58,8 @@ test('Update the firmware', async ({ page }) => {
 
   await sendBtn.click();
 
-  await fastExpect(progress).toHaveText(/Upload in progress: 0/);
+  // Pages already on the target (CRC match) start out complete.
+  await medExpect(progress).toHaveText(/Upload in progress: \d+\//);
   let { pagesComplete, pageCount } = getProgressData(await progress.innerText());
 
   while (pagesComplete < pageCount) {
@@ -53,7 +53,7 @@ test('ChannelA shows right stats for Sin', async ({ page }) => {
   // Turn on Scanning at 10Hz
   const scanCtl = page.getByLabel('RunScanCtl');
   await scanCtl.getByLabel('freq').selectOption('100');
-  await scanCtl.getByLabel('probe_0').selectOption('CHAN_A');
+  await scanCtl.getByLabel('probes_0').selectOption('CHAN_A');
   await scanCtl.getByRole('button', { name: 'Send' }).click();
 
 
@@ -1 +1,4 @@
-#define MAX_NUM_WAVES 10
\ No newline at end of file
+#define MAX_NUM_WAVES 10
+
+#define WAVE_SINE_LUT_BITS 8
+#define WAVE_TABLE_MAX_LEN 256
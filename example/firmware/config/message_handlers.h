@@ -4,25 +4,14 @@
 #pragma once
 #include <messages.pb.h>
 
-bool comm_init(void);
+/** comm_init
+ * Also adds this project's periodic telemetry to fmt_sched, to run ahead of
+ * tasks of greater priority number that are due on the same tick.
+ */
+bool comm_init(uint8_t telemetryPriority);
 
 #define USE_WaveformCtl
 void handleWaveformCtl(WaveformCtl msg);
 
 #define USE_Reset
 void handleReset(Reset msg);
-
-/** Comms Periodic
- * To be called periodically either by making this a timer-driven ISR,
- * or called within a periodic RTOS task.
- * 
- * Generates many of the messages this ECU sends, including:
- *  - Telemetry advertising sensor readings
- *  - Alerts
- * 
- * Messages NOT handled by this function:
- *  - ACKs.  These are managed by handleTx().
- *  - Command responses.  These are driven by the handleRx().
- */
-void comm_handleTelemetry(void);
-
@@ -31,5 +31,19 @@
 #define PERIODIC_USES_TIM17 0
 
 
+/** Wave output (fmt_waveOut.h), enabled by ENABLE_WAVE_OUT in firmentConfig.
+ * Needs a timer not used above, one of its PWM pins, and the DMA channel that
+ * serves the timer's update request (RM0351 DMA1/DMA2 request mapping).
+ * Uncomment to stream to TIM2_CH1 on PA0 (Nucleo A0). */
+// #define FMT_USES_WAVE_OUT
+// #define FMT_WAVE_OUT_TIMER         TIM2
+// #define FMT_WAVE_OUT_CHANNEL       TIM_CHANNEL_1
+// #define FMT_WAVE_OUT_GPIOx         GPIOA
+// #define FMT_WAVE_OUT_GPIO_Pin      GPIO_PIN_0
+// #define FMT_WAVE_OUT_GPIO_AF       GPIO_AF1_TIM2
+// #define FMT_WAVE_OUT_DMA           DMA1_Channel2
+// #define FMT_WAVE_OUT_DMA_REQUEST   DMA_REQUEST_4  // TIM2_UP
+// #define FMT_WAVE_OUT_DMA_IRQn      DMA1_Channel2_IRQn
+// #define FMT_WAVE_OUT_DMA_IRQ_HANDLER DMA1_Channel2_IRQHandler
 
 #endif // timer_pcbDetails_h
\ No newline at end of file
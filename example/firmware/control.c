@@ -28,6 +28,14 @@ int16_t chanB1000xInt;
 
 static float floatTimes2(volatile void *rawValue);
 
+// First terms of a square wave's Fourier series, for WaveShape HARMONICS.
+static const waveHarmonic_t squareish[] = {
+    {.multiple = 1, .amplitude = 1.0F},
+    {.multiple = 3, .amplitude = 1.0F / 3},
+    {.multiple = 5, .amplitude = 1.0F / 5},
+    {.multiple = 7, .amplitude = 1.0F / 7},
+};
+
 void ctl_init(float waveformUpdateFreq)
 {
   // calling this from periodicA at 1000Hz.
@@ -39,6 +47,9 @@ void ctl_init(float waveformUpdateFreq)
   wave_add(&channelB);
   wave_setFrequency(1, 0.15);
 
+  wave_setHarmonics(0, squareish, sizeof(squareish) / sizeof(squareish[0]));
+  wave_setHarmonics(1, squareish, sizeof(squareish) / sizeof(squareish[0]));
+
   gp_initTestPoint(TestPointId_CHAN_A, &chanAOut, SRC_TYPE_FLOAT, NULL);
   gp_initTestPoint(TestPointId_CHAN_A_INV, &chanAInv, SRC_TYPE_FLOAT, NULL);
   gp_initTestPoint(TestPointId_CHAN_A_PLUS, &chanAOffset, SRC_TYPE_FLOAT, NULL);
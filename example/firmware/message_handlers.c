@@ -19,69 +19,92 @@
 #include <fmt_log.h>
 #include <fmt_flash.h>
 #include <fmt_gpio.h>
+#include <fmt_hardfault.h>
+#include <fmt_periodic.h>
+#include <fmt_profile.h>
+#include <fmt_sched.h>
 #include <fmt_version.h>
 #include <gpio_pcbDetails.h>
+#include <timer_pcbDetails.h> // PERIODIC_A_TIMER_ID
 #include <core_port.h> // NVIC_SystemReset()
 #include <build_time.h>
 
-#define CALLS_PER_FULL_ROTATION 1000U
+#define TELEMETRY_PERIOD_TICKS 1000U
+#define PROFILE_PERIOD_TICKS 100U // Sends one profiled site each.
 
-bool comm_init(void)
+static fmt_pin_t led0;
+
+static void sendWaveformTlm(void);
+static void sendVersion(void);
+static void sendProfile(void);
+static void sendPeriodicTlm(void);
+
+bool comm_init(uint8_t telemetryPriority)
 {
   bool success = true;
   success &= fmt_initGpioOutPin(LED_0_PIN_ID, OUTPUT_MODE_PUSH_PULL);
+  success &= fmt_getPin(LED_0_PIN_ID, &led0);
 
   success &= fmt_initComms(); // links queues transport that must be initialized.
 
   fmt_setBuildIdGetter(getBuildTime);
+
+  // Periodic telemetry, each on its own tick of the period.
+  const fmt_taskCfg_t telemetry[] = {
+      {.run = sendWaveformTlm, .phaseTicks = 0},
+      {.run = sendVersion, .phaseTicks = 100},
+      {.run = reportCommsErrors, .phaseTicks = 400},
+      {.run = sendPeriodicTlm, .phaseTicks = 700},
+  };
+  for (uint32_t i = 0; i < sizeof(telemetry) / sizeof(telemetry[0]); i++)
+  {
+    fmt_taskCfg_t task = telemetry[i];
+    task.periodTicks = TELEMETRY_PERIOD_TICKS;
+    task.priority = telemetryPriority;
+    success &= fmt_sched_addTask(&task) >= 0;
+  }
+  const fmt_taskCfg_t profile = {
+      .run = sendProfile,
+      .periodTicks = PROFILE_PERIOD_TICKS,
+      .phaseTicks = FMT_SCHED_PHASE_AUTO,
+      .priority = telemetryPriority};
+  success &= fmt_sched_addTask(&profile) >= 0;
+
+  // No-op unless the last reset was a fault.
+  fmt_sendCrashReport();
   return success;
 }
 
-void comm_handleTelemetry(void)
+static void sendWaveformTlm(void)
 {
-  static uint32_t count = 0;
-  static uint32_t rotations = 0;
+  fmt_pinToggle(led0);
 
-  // execute periodic telemetry sends in round-robin.
-  switch (count++)
-  {
-  case 0:
-  {
-    rotations++;
-    fmt_setPin(LED_0_PIN_ID, OUTPUT_TOGGLE);
-
-    telem_t telem = ctl_getTelem();
-    fmt_sendMsg((const Top){
-        .which_sub = Top_WaveformTlm_tag,
-        .sub = {
-            .WaveformTlm = {
-                .shape = WaveShape_SINE,
-                .currentMa = telem.currentMa,
-                .voltageV = telem.voltage,
-                .ChannelBFault = true,
-            }}});
-
-    break;
-  }
-  case 100:
-  {
-    fmt_sendVersion();
-    break;
-  }
-  case 200:
-  {
-    // fmt_sendLog(LOG_INFO, "A test. ", rotations);
-    break;
-  }
-  case 400:
-  {
-    reportCommsErrors();
-    break;
-  }
-  case CALLS_PER_FULL_ROTATION:
-    count = 0;
-    break;
-  }
+  telem_t telem = ctl_getTelem();
+  fmt_sendMsg((const Top){
+      .which_sub = Top_WaveformTlm_tag,
+      .sub = {
+          .WaveformTlm = {
+              .shape = WaveShape_SINE,
+              .currentMa = telem.currentMa,
+              .voltageV = telem.voltage,
+              .ChannelBFault = true,
+          }}});
+}
+
+static void sendVersion(void)
+{
+  fmt_sendVersion();
+}
+
+static void sendProfile(void)
+{
+  fmt_profile_send();
+}
+
+// Latency and overruns of the timer fmt_sched runs on.
+static void sendPeriodicTlm(void)
+{
+  fmt_periodic_sendTlm(PERIODIC_A_TIMER_ID);
 }
 
 void handleWaveformCtl(WaveformCtl msg)
@@ -96,6 +119,8 @@ void handleWaveformCtl(WaveformCtl msg)
       [WaveShape_SQUARE] = WAVE_SHAPE_SQUARE,
       [WaveShape_SAWTOOTH] = WAVE_SHAPE_SAWTOOTH,
       [WaveShape_DC] = WAVE_SHAPE_DC,
+      [WaveShape_ARBITRARY] = WAVE_SHAPE_ARBITRARY,
+      [WaveShape_HARMONICS] = WAVE_SHAPE_HARMONICS,
   };
   // opportunity here to limit input and notify if command exceeds limits.
   const waveCfg_t cfg = {
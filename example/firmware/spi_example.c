@@ -1,7 +1,10 @@
 
 #include <fmt_rx.h>
 #include <ghostProbe.h>
-#include <fmt_periodic.h>
+#include <fmt_sched.h>
+#include <fmt_log.h>
+#include <fmt_update.h>
+#include <fmt_params.h>
 #include <fmt_sysInit.h>
 #include "control.h"
 #include "frequency.h"
@@ -10,38 +13,58 @@
 #include <timer_pcbDetails.h>
 
 
-static void periodicA(void);
+// Of tasks due on the same tick, those with lesser numbers run first.
+enum
+{
+  TASK_PRIORITY_TELEMETRY,
+  TASK_PRIORITY_RX,
+  TASK_PRIORITY_UPDATE,
+  TASK_PRIORITY_PARAMS,
+  TASK_PRIORITY_CONTROL,
+  TASK_PRIORITY_GHOST_PROBE,
+  TASK_PRIORITY_LOG, // Last, so logs only use send capacity telemetry left.
+};
+
+// Every tick: 1kHz
+static const fmt_taskCfg_t everyTick[] = {
+    {.run = fmt_handleRx, .priority = TASK_PRIORITY_RX},
+    {.run = fmt_handleUpdate, .priority = TASK_PRIORITY_UPDATE},
+    {.run = fmt_params_handle, .priority = TASK_PRIORITY_PARAMS},
+    {.run = ctl_updateVoltageISR,
+     .priority = TASK_PRIORITY_CONTROL,
+     .name = "control"},
+    {.run = gp_periodic, .priority = TASK_PRIORITY_GHOST_PROBE},
+    {.run = fmt_drainLog, .priority = TASK_PRIORITY_LOG},
+};
 
 int main(void)
 {
   fmt_initSys();
+  fmt_params_init();
   
-  comm_init();
-
-  // Set periodicA to 1kHz frequency.
-  fmt_initPeriodic(PERIODIC_A_TIMER_ID, PERIODIC_A_PERIOD_US, 
-    PERIODIC_A_PRIORITY, periodicA);
+  comm_init(TASK_PRIORITY_TELEMETRY);
 
+  // fmt_drainLog() runs every tick.  10 logs/s per call site, bursts of 20.
+  fmt_setLogRateLimit(10, 20, 1000000U / PERIODIC_A_PERIOD_US);
 
   ctl_init(WAVE_UPDATE_FREQ);
   gp_init(GHOST_PROBE_CALL_FREQ);
 
+  for (uint32_t i = 0; i < sizeof(everyTick) / sizeof(everyTick[0]); i++)
+  {
+    fmt_taskCfg_t task = everyTick[i];
+    task.periodTicks = 1;
+    fmt_sched_addTask(&task);
+  }
+  fmt_sched_start(PERIODIC_A_TIMER_ID, PERIODIC_A_PERIOD_US,
+    PERIODIC_A_PRIORITY);
+
   for (uint32_t count = 0;;)
   {
     count++;
     /** Do some intelligent housekeeping. For example:
      *  - record how much time I spend here as a cpu-idle metric.
-     *  - handle logging.
      *  - free memory accounting.
      */
   }
 }
-
-// 1kHz
-static void periodicA(void)
-{
-  comm_handleTelemetry();
-  fmt_handleRx();
-  ctl_updateVoltageISR();
-  gp_periodic();
-}
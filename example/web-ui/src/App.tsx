@@ -1,5 +1,5 @@
 
-import {widgets, BrokerAddress, FWUpdate, Log, Plot, Reset, Version} from 'firment-ui'
+import {widgets, AddrScan, BrokerAddress, FWUpdate, Log, Params, Plot, Profile, Reset, Version, WaveTable} from 'firment-ui'
 import 'firment-ui/src/App.css'
 import 'firment-ui/src/plot/Plot.css'
 
@@ -15,7 +15,10 @@ function App() {
         <div className='widget-column'>
           <h2>Commands</h2>
           <widgets.WaveformCtl />
+          <WaveTable />
           <widgets.RunScanCtl />
+          <AddrScan />
+          <Params />
           <FWUpdate />
           <Reset />
         </div>
@@ -24,6 +27,8 @@ function App() {
           <Version />
           <widgets.WaveformTlm />
           <widgets.FirmentErrorTlm />
+          <Profile />
+          <widgets.PeriodicTlm />
           <Log />
         </div>
         <div className='plot-column'>
@@ -106,6 +106,12 @@ static bool fmt_getMsg_prod(Top *message)
 }
 bool (*fmt_getMsg)(Top *message) = fmt_getMsg_prod;
 
+static uint32_t fmt_getSendSpace_prod(void)
+{
+  return emptySpacesInQueue(sendQueue);
+}
+uint32_t (*fmt_getSendSpace)(void) = fmt_getSendSpace_prod;
+
 bool fmt_initComms(void)
 {
   ASSERT_SUCCESS(initQueue(
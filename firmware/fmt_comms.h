@@ -23,4 +23,9 @@ extern bool (*fmt_sendMsg)(Top message);
 
 extern bool (*fmt_getMsg)(Top *message);
 
+/** fmt_getSendSpace
+ * Returns the number of messages that can be queued before fmt_sendMsg fails.
+ * Lets low-priority senders (fmt_drainLog) yield to telemetry. */
+extern uint32_t (*fmt_getSendSpace)(void);
+
 #endif // fmt_comms_h
\ No newline at end of file
@@ -14,6 +14,53 @@
  */
 int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len);
 
+typedef void (*fmt_flash_callback_t)(int status);
+
+/** fmt_flash_writeAsync
+ * Starts a write like fmt_flash_write() and returns while it is programmed.
+ * data must stay untouched until cb runs with what fmt_flash_write() would
+ * have returned.
+ * - STM32L4: rows are programmed from the flash interrupt, which runs cb.  A
+ *   write to the bank the CPU runs from is done before this returns.
+ * - XMC4: pages are programmed from fmt_flash_pollWrite(), which runs cb.
+ * @returns 0 if the write started (cb will run), a negative value if another
+ * write is in progress.
+ */
+int fmt_flash_writeAsync(uint32_t address, const uint8_t *data, uint32_t len,
+                         fmt_flash_callback_t cb);
+
+/** fmt_flash_pollWrite
+ * Advances the write started by fmt_flash_writeAsync() on ports that poll.
+ * @returns 1 while it is in progress, else 0.
+ */
+int fmt_flash_pollWrite(void);
+
+/** fmt_flash_read
+ * @param address an absolute address in program memory.
+ * @param data where to copy len bytes read from address.
+ * @returns 0 on success, a negative value on failure.
+ */
+int fmt_flash_read(uint32_t address, uint8_t *data, uint32_t len);
+
+/** fmt_flash_startErase
+ * Starts erasing the erase-blocks (sectors) covering [address, address + len)
+ * and, where the MCU allows, returns without waiting for the erase to finish.
+ * Poll fmt_flash_pollErase() until it stops returning 1; fmt_flash_write()
+ * finishes a pending erase before it programs anything.
+ * - STM32L4: pages are erased one by one from fmt_flash_pollErase().  The CPU
+ *   keeps running from the other bank meanwhile (read-while-write); erasing
+ *   its own bank stalls it as a blocking erase would.
+ * - XMC4: program flash can't be read during an erase, so this blocks.
+ * @returns 0 on success, a negative value on failure.
+ */
+int fmt_flash_startErase(uint32_t address, uint32_t len);
+
+/** fmt_flash_pollErase
+ * @returns 1 while the erase started by fmt_flash_startErase() is running, 0
+ * once it is done (or if none was started), a negative value on failure.
+ */
+int fmt_flash_pollErase(void);
+
 /** flash_isErased 
  * @note This is intended for internal use because fmt_flash_write handles 
  * checking if an erase is needed before programming.  However, flash_isErased
@@ -23,4 +70,19 @@ int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len);
  */
 bool flash_isErased(uint32_t address, uint32_t len);
 
-uint32_t getPreceedingWriteBoundary(uint32_t address);
\ No newline at end of file
+/** flash_markErased, flash_markWritten
+ * Keep flash_isErased() from re-scanning what is known to be erased.  Ports
+ * call flash_markErased() with the whole erase-blocks they erase and
+ * flash_markWritten() with every range they program.
+ */
+void flash_markErased(uint32_t address, uint32_t len);
+void flash_markWritten(uint32_t address, uint32_t len);
+
+uint32_t getPreceedingWriteBoundary(uint32_t address);
+
+/** flash_fillWriteBlock
+ * Copies the part of [address, address + len) that falls in the write block at
+ * block_adr into block, padding the rest with zeros.
+ */
+void flash_fillWriteBlock(uint8_t *block, uint32_t block_adr, uint32_t address,
+                          const uint8_t *data, uint32_t len);
\ No newline at end of file
@@ -24,17 +24,37 @@ bool fmt_initGpioOutPin(uint8_t pinId, outputMode_t mode)
   return true;
 }
 
-bool fmt_readPin(uint8_t pinId)
+bool fmt_getPin(uint8_t pinId, fmt_pin_t *pin)
 {
   ASSERT_PIN_ID_VALID;
   portPin_t portPin = availableGpios[pinId];
-  return (port_readPort((void *)portPin.port) & (1UL << portPin.pin)) != 0;
+  *pin = port_getPin((void *)portPin.port, portPin.pin);
+  return true;
+}
+
+bool fmt_readPin(uint8_t pinId)
+{
+  fmt_pin_t pin;
+  return fmt_getPin(pinId, &pin) && fmt_pinRead(pin);
 }
 
 bool fmt_setPin(uint8_t pinId, outLevel_t level)
 {
-  ASSERT_PIN_ID_VALID;
-  portPin_t portPin = availableGpios[pinId];
-  port_setPin((void*)portPin.port, portPin.pin, level);
+  fmt_pin_t pin;
+  if (!fmt_getPin(pinId, &pin))
+    return false;
+
+  switch (level)
+  {
+  case OUTPUT_LOW:
+    fmt_pinLow(pin);
+    break;
+  case OUTPUT_HIGH:
+    fmt_pinHigh(pin);
+    break;
+  case OUTPUT_TOGGLE:
+    fmt_pinToggle(pin);
+    break;
+  }
   return true;
 }
\ No newline at end of file
@@ -18,9 +18,14 @@
  * The gpioTest.c will complain if step 3 above is not done.  It's a reminder
  * to perform on-target tests for new circuit paths before merging. 
  * 
+ * Fast access:
+ * fmt_readPin() and fmt_setPin() look the pinId up on every call.  Where that
+ * matters (ISRs, timing probes), resolve the pin once with fmt_getPin() at init
+ * and use the fmt_pin* functions, each a single register access.
  */
 
 #pragma once
+#include <pin_port.h> // fmt_pin_t
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -47,4 +52,16 @@ bool fmt_initGpioOutPin(uint8_t pinId, outputMode_t mode);
 
 bool fmt_readPin(uint8_t pinId);
 
-bool fmt_setPin(uint8_t pinId, outLevel_t level);
\ No newline at end of file
+bool fmt_setPin(uint8_t pinId, outLevel_t level);
+
+/** fmt_getPin
+ * Resolves pinId to a handle for the inline fmt_pin* functions below.
+ * @returns false if pinId isn't in AVAILABLE_GPIOs.
+ * @note Doesn't init the pin; call fmt_initGpioInPin/OutPin() as usual.
+ */
+bool fmt_getPin(uint8_t pinId, fmt_pin_t *pin);
+
+static inline void fmt_pinHigh(fmt_pin_t pin) { port_pinHigh(pin); }
+static inline void fmt_pinLow(fmt_pin_t pin) { port_pinLow(pin); }
+static inline void fmt_pinToggle(fmt_pin_t pin) { port_pinToggle(pin); }
+static inline bool fmt_pinRead(fmt_pin_t pin) { return port_pinRead(pin); }
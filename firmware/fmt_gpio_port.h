@@ -19,6 +19,4 @@ void port_initSpiPins(void);
 #elif defined(FMT_USES_UART)
 void port_initUartPins(void);
 #endif
-
-uint32_t port_readPort(void *const port);
-void port_setPin(void *const port, uint_fast8_t pin, outLevel_t level);
\ No newline at end of file
+void port_initWaveOutPin(void); // Only needed (and defined) with FMT_USES_WAVE_OUT
\ No newline at end of file
@@ -1,5 +1,21 @@
+#include <stddef.h> // offsetof()
 #include <stdint.h>
 #include "fmt_hardfault.h"
+#include "fmt_comms.h"
+#include "fmt_log.h"   // fmt_getRecentLogs()
+#include "fmt_sizes.h" // CRASH_STACK_WORDS, CRASH_LOG_COUNT
+#include <fault_port.h>
+
+#define CRASH_MAGIC 0xC4A5E0FFU
+#define FRAME_PC 6U
+#define FRAME_LR 5U
+#define FRAME_XPSR 7U
+#define FRAME_WORDS 8U
+#define EXC_RETURN_PSP (1U << 2) // The frame was stacked on PSP.
+
+_Static_assert(CRASH_STACK_WORDS >= FRAME_WORDS &&
+                   CRASH_STACK_WORDS % FRAME_WORDS == 0,
+               "CRASH_STACK_WORDS must be a multiple of CrashStack.words");
 
 typedef struct
 {
@@ -21,28 +37,155 @@ typedef struct
   uint8_t bfarvalid : 1; 
 } busFault_t;
 
-void HardFault_Handler(void)
+typedef union
 {
-  while (1)
-    ;
-}
+  uint32_t word;
+  struct
+  {
+    uint8_t memManage; // MMFSR
+    busFault_t busFault; // BFSR
+    uint16_t usageFault; // UFSR
+  };
+} cfsr_t;
+#define MMFSR_MSTKERR (1U << 4)
+
+/** Lives in .noinit: survives the reset, garbage at power-on.  check guards
+ * against mistaking power-on garbage for a record. */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t faultType;
+  uint32_t cfsr;
+  uint32_t hfsr;
+  uint32_t mmfar;
+  uint32_t bfar;
+  uint32_t sp;
+  uint32_t excReturn;
+  uint32_t stackWords;
+  uint32_t stack[CRASH_STACK_WORDS];
+  uint32_t logCount;
+  logRecord_t logs[CRASH_LOG_COUNT];
+  uint32_t check;
+} crashRecord_t;
+
+static crashRecord_t crashRecord __attribute__((section(".noinit")));
+
+// fmt_captureFault() runs on this, not on the stack that faulted.  Global so
+// the handlers' asm can name it.
+uint64_t fmt_faultStack[PORT_FAULT_STACK_BYTES / sizeof(uint64_t)]
+    __attribute__((section(".noinit"), used));
+
+static uint32_t computeCheck(const crashRecord_t *record);
+
+PORT_FAULT_HANDLER(HardFault_Handler, fmt_captureFault, 1, fmt_faultStack)
+PORT_FAULT_HANDLER(MemManage_Handler, fmt_captureFault, 2, fmt_faultStack)
+PORT_FAULT_HANDLER(BusFault_Handler, fmt_captureFault, 3, fmt_faultStack)
+PORT_FAULT_HANDLER(UsageFault_Handler, fmt_captureFault, 4, fmt_faultStack)
+_Static_assert(FaultType_FAULT_HARD == 1 && FaultType_FAULT_MEM_MANAGE == 2 &&
+                   FaultType_FAULT_BUS == 3 && FaultType_FAULT_USAGE == 4,
+               "Fault handler literals must match FaultType");
 
-void MemManage_Handler(void)
+void fmt_captureFault(const uint32_t *frame, uint32_t excReturn,
+                      uint32_t faultType)
 {
-  while (1)
-    ;
+  /* The handlers switch to fmt_faultStack, which is small.  So the record is
+  written field by field: a compound literal of it could put a temporary of
+  several hundred bytes on the stack. */
+  const cfsr_t cfsr = {.word = PORT_CFSR};
+  crashRecord.magic = CRASH_MAGIC;
+  crashRecord.faultType = faultType;
+  crashRecord.cfsr = cfsr.word;
+  crashRecord.hfsr = PORT_HFSR;
+  crashRecord.mmfar = PORT_MMFAR;
+  crashRecord.bfar = PORT_BFAR;
+  crashRecord.sp = (uint32_t)(uintptr_t)frame;
+  crashRecord.excReturn = excReturn;
+  crashRecord.stackWords = 0;
+
+  /* If stacking faulted, sp may not point at readable RAM, and a fault here
+  would lock up instead of resetting.  Also stop at the top of the stack: for
+  the main stack, the initial MSP.  Where a PSP stack ends isn't known, so only
+  the frame stacked on it is saved. */
+  bool stackingFailed =
+      cfsr.busFault.stk || (cfsr.memManage & MMFSR_MSTKERR) ||
+      ((uintptr_t)frame & 3U);
+  if (!stackingFailed)
+  {
+    uintptr_t stackTop = (excReturn & EXC_RETURN_PSP)
+                             ? (uintptr_t)(frame + FRAME_WORDS)
+                             : port_getStackTop();
+    uint32_t words = 0;
+    while (words < CRASH_STACK_WORDS &&
+           (uintptr_t)(frame + words) < stackTop)
+    {
+      crashRecord.stack[words] = frame[words];
+      words++;
+    }
+    crashRecord.stackWords = words;
+  }
+
+  crashRecord.logCount = fmt_getRecentLogs(crashRecord.logs, CRASH_LOG_COUNT);
+  crashRecord.check = computeCheck(&crashRecord);
+
+  port_resetSystem();
 }
 
-void BusFault_Handler(void)
+bool fmt_sendCrashReport(void)
 {
-  busFault_t busFault = *(busFault_t*)0xE000ED29;
-  (void)busFault;
-  while (1)
-    ;
+  if (crashRecord.magic != CRASH_MAGIC ||
+      crashRecord.check != computeCheck(&crashRecord))
+    return false;
+
+  const uint32_t *stack = crashRecord.stack;
+  bool haveFrame = crashRecord.stackWords >= FRAME_WORDS;
+  fmt_sendMsg((Top){
+      .which_sub = Top_CrashReport_tag,
+      .sub = {.CrashReport = {
+                  .faultType = (FaultType)crashRecord.faultType,
+                  .pc = haveFrame ? stack[FRAME_PC] : 0,
+                  .lr = haveFrame ? stack[FRAME_LR] : 0,
+                  .xpsr = haveFrame ? stack[FRAME_XPSR] : 0,
+                  .cfsr = crashRecord.cfsr,
+                  .hfsr = crashRecord.hfsr,
+                  .mmfar = crashRecord.mmfar,
+                  .bfar = crashRecord.bfar,
+                  .sp = crashRecord.sp,
+              }}});
+
+  for (uint32_t offset = 0; offset < crashRecord.stackWords;
+       offset += FRAME_WORDS)
+  {
+    CrashStack msg = {.offset = offset};
+    for (; msg.words_count < FRAME_WORDS &&
+           offset + msg.words_count < crashRecord.stackWords;
+         msg.words_count++)
+      msg.words[msg.words_count] = stack[offset + msg.words_count];
+    fmt_sendMsg((Top){
+        .which_sub = Top_CrashStack_tag,
+        .sub = {.CrashStack = msg}});
+  }
+
+  for (uint32_t i = 0; i < crashRecord.logCount && i < CRASH_LOG_COUNT; i++)
+  {
+    Top msg = {.which_sub = crashRecord.logs[i].which_sub};
+    if (msg.which_sub == Top_Log_tag)
+      msg.sub.Log = crashRecord.logs[i].msg.Log;
+    else
+      msg.sub.LogFmt = crashRecord.logs[i].msg.LogFmt;
+    fmt_sendMsg(msg);
+  }
+
+  crashRecord.magic = 0;
+  return true;
 }
 
-void UsageFault_Handler(void)
+/* PRIVATE (static) functions */
+
+static uint32_t computeCheck(const crashRecord_t *record)
 {
-  while (1)
-    ;
-}
\ No newline at end of file
+  const uint32_t *words = (const uint32_t *)record;
+  uint32_t check = ~CRASH_MAGIC;
+  for (uint32_t i = 0; i < offsetof(crashRecord_t, check) / sizeof(uint32_t); i++)
+    check = (check << 5 | check >> 27) ^ words[i];
+  return check;
+}
@@ -1,4 +1,29 @@
+#ifndef fmt_hardfault_H
+#define fmt_hardfault_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Fault handlers
+ * Each saves a crash record (exception frame, fault status registers, a slice
+ * of the stack and the last CRASH_LOG_COUNT logs) to .noinit RAM, which the
+ * startup code doesn't clear, then resets the MCU.
+ */
 void HardFault_Handler(void);
 void MemManage_Handler(void);
 void BusFault_Handler(void);
-void UsageFault_Handler(void);
\ No newline at end of file
+void UsageFault_Handler(void);
+
+/** fmt_sendCrashReport
+ * If the last reset was caused by a fault, sends CrashReport, CrashStack and
+ * the saved logs, then clears the record.  Call once, after fmt_initComms().
+ * Returns true if a crash was reported.
+ */
+bool fmt_sendCrashReport(void);
+
+/** Used by the fault handlers: saves the crash record.  Doesn't return on
+ * target. */
+void fmt_captureFault(const uint32_t *frame, uint32_t excReturn,
+                      uint32_t faultType);
+
+#endif // fmt_hardfault_H
@@ -1,37 +1,384 @@
-
 #include "fmt_log.h"
 #include "fmt_sizes.h"
 #include "fmt_comms.h"
 
+_Static_assert(sizeof(((LogFmt *)0)->args) / sizeof(uint32_t) == FMT_LOG_MAX_ARGS,
+               "FMT_LOG_MAX_ARGS must match LogFmt.args max_count");
+_Static_assert((LOG_RING_LENGTH & (LOG_RING_LENGTH - 1)) == 0,
+               "LOG_RING_LENGTH must be a power of 2");
+_Static_assert((LOG_SITE_TABLE_LENGTH & (LOG_SITE_TABLE_LENGTH - 1)) == 0,
+               "LOG_SITE_TABLE_LENGTH must be a power of 2");
+
+#define SITE_PROBE_LIMIT 4U
+#define REPEAT_PREFIX "repeated: "
+#define NO_LAST_LOG (FMT_LOG_MAX_ARGS + 1U) // lastWordCount of a new site.
+
+/** Log ring
+ * Multi-producer, single-consumer.  A producer claims an index by CAS on
+ * ringHead, fills the slot, then publishes it by writing committed = index + 1.
+ * fmt_drainLog() (the only consumer) sends slots in index order and stops at
+ * the first one not yet published, e.g. when its producer was preempted.
+ * Indices are free-running; slot = index % LOG_RING_LENGTH.
+ */
+typedef struct
+{
+  volatile uint32_t committed;
+  logRecord_t record;
+} logSlot_t;
+
+static logSlot_t logRing[LOG_RING_LENGTH];
+static uint32_t ringHead = 0; // next index to claim.
+static uint32_t ringTail = 0; // next index to send.
+
 static logLevel_t activeLogLevel = LOG_VERBOSE;
+// Shared by Log and LogFmt so the UI sees one ordered stream.
+static uint32_t logCount = 0;
+static uint32_t dropCounts[LOG_SILENT] = {0};
+
+/** Call sites
+ * A small open-addressed table hashed on the site's msg pointer keeps, per
+ * site, the words of its last log sent and a token bucket for rate limiting.
+ * A log identical to the site's last, or over its rate, is suppressed and
+ * counted, and the count sent as one "repeated: <msg>" Log before the site's
+ * next log that isn't, once the site has been quiet for a second, or at least
+ * once a second while it keeps being suppressed.
+ * Tokens are in units of 1/drainFreqHz log, so each fmt_drainLog() call (tick)
+ * adds ratePerSec units.  The table is updated without locks: a site logging
+ * from two ISR priorities at once may be miscounted, which only makes its
+ * limit approximate.  Repeat counts are taken with an atomic exchange so each
+ * suppressed log is reported once.
+ */
+typedef struct
+{
+  const char *site; // NULL if unused.
+  bool isFmt;
+  logLevel_t level;
+  uint32_t tokens;
+  uint32_t lastTick;   // of its last log, sent or suppressed.
+  uint32_t reportTick; // of its last log or repeat count sent.
+  uint32_t suppressed;
+  uint32_t lastWordCount; // NO_LAST_LOG until a log is sent.
+  uint32_t lastWords[FMT_LOG_MAX_ARGS];
+} logSite_t;
+
+static logSite_t logSites[LOG_SITE_TABLE_LENGTH];
+static uint32_t logTicks = 0;
+static uint32_t ratePerTick = 0; // 0: rate limiting disabled.
+static uint32_t unitsPerLog = 1;
+static uint32_t burstUnits = 0;
+
+static bool passSiteFilter(const char *msg, logLevel_t level, bool isFmt,
+                           uint32_t wordCount, const uint32_t words[]);
+static uint32_t textHash(const char *text);
+static logSite_t *findSite(const char *msg);
+static void queueRepeats(logSite_t *site);
+static logSlot_t *claimSlot(logLevel_t level);
+static void publishSlot(logSlot_t *slot);
 
 bool fmt_sendLog(logLevel_t level, const char *msg, float number)
 {
-  static uint32_t logCount = 0;
-  logCount++;
-  bool success = true;
+  if (level < activeLogLevel)
+  {
+    __atomic_add_fetch(&logCount, 1, __ATOMIC_RELAXED);
+    return false;
+  }
 
-  if (level >= activeLogLevel) 
+  // The text is hashed too, in case msg is a buffer that's rewritten.
+  union { float f; uint32_t word; } value = {.f = number};
+  const uint32_t words[] = {value.word, textHash(msg)};
+  if (!passSiteFilter(msg, level, false, 2, words))
+    return false;
+
+  logSlot_t *slot = claimSlot(level);
+  if (slot == NULL)
+    return false;
+
+  slot->record.which_sub = Top_Log_tag;
+  slot->record.msg.Log = (Log){
+      .count = __atomic_add_fetch(&logCount, 1, __ATOMIC_RELAXED),
+      .value = number};
+  if (msg != NULL)
   {
-    Log logMsg = {.count = logCount, .value = number};
+    strncpy(slot->record.msg.Log.text, msg, MAX_LOG_TEXT_SIZE);
+  }
+  publishSlot(slot);
+  return true;
+}
+
+bool fmt_sendLogFmt(logLevel_t level, const char *format, uint32_t argCount,
+                    const uint32_t args[])
+{
+  if (level < activeLogLevel)
+  {
+    __atomic_add_fetch(&logCount, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  if (argCount > FMT_LOG_MAX_ARGS)
+    argCount = FMT_LOG_MAX_ARGS;
+  if (!passSiteFilter(format, level, true, argCount, args))
+    return false;
+
+  logSlot_t *slot = claimSlot(level);
+  if (slot == NULL)
+    return false;
+
+  slot->record.which_sub = Top_LogFmt_tag;
+  LogFmt *logMsg = &slot->record.msg.LogFmt;
+  *logMsg = (LogFmt){
+      .count = __atomic_add_fetch(&logCount, 1, __ATOMIC_RELAXED),
+      .id = (uint16_t)(uintptr_t)format,
+      .level = level,
+      .args_count = argCount,
+  };
+  for (uint32_t i = 0; i < logMsg->args_count; i++)
+    logMsg->args[i] = args[i];
 
-    if (msg != NULL)
+  publishSlot(slot);
+  return true;
+}
+
+void fmt_setLogLevel(logLevel_t level)
+{
+  activeLogLevel = level;
+}
+
+void fmt_setLogRateLimit(uint32_t ratePerSec, uint32_t burst,
+                         uint32_t drainFreqHz)
+{
+  memset(logSites, 0, sizeof(logSites));
+  unitsPerLog = drainFreqHz ? drainFreqHz : 1;
+  burstUnits = (burst ? burst : 1) * unitsPerLog;
+  ratePerTick = ratePerSec;
+}
+
+void fmt_drainLog(void)
+{
+  static LogDropTlm reportedDrops = {0};
+
+  uint32_t now = __atomic_add_fetch(&logTicks, 1, __ATOMIC_RELAXED);
+  // Report storms that have ended: sites quiet for a second.  Their next log
+  // is then sent in full, even if it's the same as the last.  Storms still
+  // going are reported once a second so they stay visible.
+  for (uint32_t i = 0; i < LOG_SITE_TABLE_LENGTH; i++)
+  {
+    logSite_t *site = &logSites[i];
+    if (site->site == NULL)
+      continue;
+    if (site->lastWordCount != NO_LAST_LOG &&
+        now - site->lastTick >= unitsPerLog)
     {
-      strncpy(logMsg.text, msg, MAX_LOG_TEXT_SIZE);
+      queueRepeats(site);
+      site->lastWordCount = NO_LAST_LOG;
     }
+    else if (now - site->reportTick >= unitsPerLog)
+      queueRepeats(site);
+  }
+
+  uint32_t space = fmt_getSendSpace();
+  const LogDropTlm drops = {
+      .verbose = __atomic_load_n(&dropCounts[LOG_VERBOSE], __ATOMIC_RELAXED),
+      .info = __atomic_load_n(&dropCounts[LOG_INFO], __ATOMIC_RELAXED),
+      .warn = __atomic_load_n(&dropCounts[LOG_WARN], __ATOMIC_RELAXED),
+      .error = __atomic_load_n(&dropCounts[LOG_ERROR], __ATOMIC_RELAXED),
+  };
+  if (space > LOG_SEND_RESERVE &&
+      memcmp(&drops, &reportedDrops, sizeof(LogDropTlm)) != 0)
+  {
+    reportedDrops = drops;
+    fmt_sendMsg((Top){
+        .which_sub = Top_LogDropTlm_tag,
+        .sub = {.LogDropTlm = drops}});
+    space--;
+  }
+
+  for (; space > LOG_SEND_RESERVE; space--)
+  {
+    uint32_t tail = ringTail;
+    logSlot_t *slot = &logRing[tail % LOG_RING_LENGTH];
+    if (__atomic_load_n(&slot->committed, __ATOMIC_ACQUIRE) != tail + 1)
+      break; // empty, or next log not yet published.
+
+    Top message = {.which_sub = slot->record.which_sub};
+    if (message.which_sub == Top_Log_tag)
+      message.sub.Log = slot->record.msg.Log;
+    else
+      message.sub.LogFmt = slot->record.msg.LogFmt;
+
+    // Release the slot to producers before sending.
+    __atomic_store_n(&ringTail, tail + 1, __ATOMIC_RELEASE);
+    fmt_sendMsg(message);
+  }
+}
+
+uint32_t fmt_getRecentLogs(logRecord_t dest[], uint32_t maxCount)
+{
+  uint32_t head = __atomic_load_n(&ringHead, __ATOMIC_ACQUIRE);
+  if (maxCount > LOG_RING_LENGTH)
+    maxCount = LOG_RING_LENGTH;
+  if (maxCount > head)
+    maxCount = head; // Fewer logs than that ever claimed.
+
+  uint32_t count = 0;
+  for (uint32_t index = head - maxCount; index != head; index++)
+  {
+    const logSlot_t *slot = &logRing[index % LOG_RING_LENGTH];
+    // Skip slots never used, or claimed but not yet published.
+    if (__atomic_load_n(&slot->committed, __ATOMIC_ACQUIRE) == index + 1)
+      dest[count++] = slot->record;
+  }
+  return count;
+}
+
+/* PRIVATE (static) functions */
+
+/** passSiteFilter
+ * @returns false if the log is suppressed: the same words as the site's last
+ * log, or over its rate limit.  words[] are the log's value or args.
+ */
+static bool passSiteFilter(const char *msg, logLevel_t level, bool isFmt,
+                           uint32_t wordCount, const uint32_t words[])
+{
+  if (msg == NULL)
+    return true;
 
-    fmt_sendMsg((const Top){
-        .which_sub = Top_Log_tag,
-        .sub = {.Log = logMsg}});
+  logSite_t *site = findSite(msg);
+  uint32_t now = __atomic_load_n(&logTicks, __ATOMIC_RELAXED);
+  if (site->site != msg)
+  {
+    queueRepeats(site); // before the evicted site's count is lost.
+    *site = (logSite_t){
+        .isFmt = isFmt,
+        .level = level,
+        .tokens = burstUnits,
+        .lastTick = now,
+        .reportTick = now,
+        .lastWordCount = NO_LAST_LOG};
+    site->site = msg;
+  }
+
+  uint32_t tokens = site->tokens;
+  if (ratePerTick)
+  {
+    // Cap elapsed ticks first so the multiply can't overflow.
+    uint32_t elapsed = now - site->lastTick;
+    uint32_t ticksToFill = burstUnits / ratePerTick + 1;
+    if (elapsed > ticksToFill)
+      elapsed = ticksToFill;
+    tokens += elapsed * ratePerTick;
+    if (tokens > burstUnits)
+      tokens = burstUnits;
+  }
+  site->lastTick = now;
+
+  uint32_t wordsSize = wordCount * sizeof(uint32_t);
+  bool repeated = wordCount == site->lastWordCount &&
+                  memcmp(words, site->lastWords, wordsSize) == 0;
+  if (repeated || (ratePerTick && tokens < unitsPerLog))
+  {
+    site->tokens = tokens;
+    __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  site->tokens = ratePerTick ? tokens - unitsPerLog : tokens;
+  queueRepeats(site);
+  site->reportTick = now;
+  site->lastWordCount = wordCount;
+  memcpy(site->lastWords, words, wordsSize);
+  return true;
+}
+
+/** FNV-1a of the text as Log carries it: up to MAX_LOG_TEXT_SIZE chars. */
+static uint32_t textHash(const char *text)
+{
+  uint32_t hash = 2166136261U;
+  for (uint32_t i = 0; text && i < MAX_LOG_TEXT_SIZE && text[i]; i++)
+    hash = (hash ^ (uint8_t)text[i]) * 16777619U;
+  return hash;
+}
+
+/** Returns msg's entry, else an unused entry, else msg's home entry to evict. */
+static logSite_t *findSite(const char *msg)
+{
+  uint32_t hash = (uint32_t)((uintptr_t)msg >> 2) * 2654435761U;
+  uint32_t home = hash >> (32 - __builtin_ctz(LOG_SITE_TABLE_LENGTH));
+  logSite_t *unused = NULL;
+  for (uint32_t probe = 0; probe < SITE_PROBE_LIMIT; probe++)
+  {
+    logSite_t *site = &logSites[(home + probe) % LOG_SITE_TABLE_LENGTH];
+    if (site->site == msg)
+      return site;
+    if (site->site == NULL && unused == NULL)
+      unused = site;
+  }
+  return unused ? unused : &logSites[home];
+}
+
+/** Queues a Log "repeated: <msg>" with value = the site's suppressed count. */
+static void queueRepeats(logSite_t *site)
+{
+  uint32_t repeats = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+  if (repeats == 0)
+    return;
+
+  logSlot_t *slot = claimSlot(site->level);
+  if (slot == NULL)
+  {
+    __atomic_add_fetch(&site->suppressed, repeats, __ATOMIC_RELAXED);
+    return;
+  }
+  site->reportTick = __atomic_load_n(&logTicks, __ATOMIC_RELAXED);
+
+  slot->record.which_sub = Top_Log_tag;
+  Log *logMsg = &slot->record.msg.Log;
+  *logMsg = (Log){
+      .count = __atomic_add_fetch(&logCount, 1, __ATOMIC_RELAXED),
+      .value = (float)repeats,
+      .text = REPEAT_PREFIX};
+
+  char *text = logMsg->text + sizeof(REPEAT_PREFIX) - 1;
+  const char *textEnd = logMsg->text + sizeof(logMsg->text) - 1;
+  if (site->isFmt)
+  {
+    // The format string isn't loaded; send its ID like LogFmt does.
+    const char hexDigits[] = "0123456789abcdef";
+    uint16_t id = (uint16_t)(uintptr_t)site->site;
+    const char idPrefix[] = "FMT_LOG id 0x";
+    for (const char *c = idPrefix; *c && text < textEnd; c++)
+      *text++ = *c;
+    for (int shift = 12; shift >= 0 && text < textEnd; shift -= 4)
+      *text++ = hexDigits[(id >> shift) & 0xF];
   }
   else
   {
-    success = false;
+    for (const char *c = site->site; *c && text < textEnd; c++)
+      *text++ = *c;
   }
-  return success;
+  *text = '\0';
+  publishSlot(slot);
 }
 
-void fmt_setLogLevel(logLevel_t level)
+static logSlot_t *claimSlot(logLevel_t level)
 {
-  activeLogLevel = level;
-}
\ No newline at end of file
+  uint32_t head = __atomic_load_n(&ringHead, __ATOMIC_RELAXED);
+  do
+  {
+    if (head - __atomic_load_n(&ringTail, __ATOMIC_ACQUIRE) >= LOG_RING_LENGTH)
+    {
+      if (level < LOG_SILENT)
+        __atomic_add_fetch(&dropCounts[level], 1, __ATOMIC_RELAXED);
+      return NULL;
+    }
+  } while (!__atomic_compare_exchange_n(&ringHead, &head, head + 1, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+  logSlot_t *slot = &logRing[head % LOG_RING_LENGTH];
+  slot->committed = head; // != head + 1 until published.
+  return slot;
+}
+
+static void publishSlot(logSlot_t *slot)
+{
+  uint32_t index = slot->committed;
+  __atomic_store_n(&slot->committed, index + 1, __ATOMIC_RELEASE);
+}
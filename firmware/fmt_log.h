@@ -8,6 +8,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <messages.pb.h>
 
 typedef enum _logLevel {
   LOG_VERBOSE,
@@ -17,6 +19,116 @@ typedef enum _logLevel {
   LOG_SILENT,
 } logLevel_t;
 
+/** fmt_sendLog
+ * Queues a log in the log ring, to be sent by fmt_drainLog().  Lock-free and
+ * safe from any ISR priority.  Returns false if the level is below the active
+ * level, or the ring is full (counted per level, reported in LogDropTlm).
+ * Also false if the log is suppressed: the same text and number as the last
+ * one from this msg pointer (its call site), or over the site's rate limit.
+ * Suppressed logs are counted and sent as one "repeated: <msg>" Log, at
+ * least once a second while they continue.
+ */
 bool fmt_sendLog(logLevel_t level, const char msg[], float number);
 
-void fmt_setLogLevel(logLevel_t level);
\ No newline at end of file
+void fmt_setLogLevel(logLevel_t level);
+
+/** A queued Log or LogFmt. */
+typedef struct
+{
+  pb_size_t which_sub; // Top_Log_tag or Top_LogFmt_tag
+  union
+  {
+    Log Log;
+    LogFmt LogFmt;
+  } msg;
+} logRecord_t;
+
+/** fmt_getRecentLogs
+ * Copies up to maxCount of the most recent logs, sent or not, oldest first.
+ * Lock-free; used by the fault handlers to save the logs leading to a crash.
+ * Returns the number copied.
+ */
+uint32_t fmt_getRecentLogs(logRecord_t dest[], uint32_t maxCount);
+
+/** fmt_setLogRateLimit
+ * Limits each call site (keyed on the msg or format pointer) to ratePerSec
+ * logs per second, allowing bursts of up to burst.  Logs over the limit are
+ * counted and later sent as one "repeated: <msg>" Log whose value is the count.
+ * Time is measured in fmt_drainLog() calls, made at drainFreqHz.
+ * ratePerSec = 0 (the default) disables rate limiting.
+ * Consecutive identical logs of a site are collapsed the same way with or
+ * without a limit, until the site is quiet for a second: a single drain tick
+ * until drainFreqHz is given here.
+ */
+void fmt_setLogRateLimit(uint32_t ratePerSec, uint32_t burst,
+                         uint32_t drainFreqHz);
+
+/** fmt_drainLog
+ * Moves queued logs into the send queue, leaving LOG_SEND_RESERVE slots free
+ * for telemetry, and sends LogDropTlm when the drop counts change.
+ * Call from a single context, after that context's telemetry sends.
+ */
+void fmt_drainLog(void);
+
+/** Deferred-format logging
+ * FMT_LOG(LOG_WARN, "rx overrun %u at %f", count, seconds) sends a LogFmt:
+ * a 16-bit string ID plus up to FMT_LOG_MAX_ARGS raw 32-bit argument words,
+ * instead of text.  The format string is placed in .fmt_log_strings, which the
+ * linker script keeps in the ELF but never loads into flash, and the string's
+ * address in that section is its ID.  The web-ui Log widget reads the strings
+ * back out of the ELF and formats the line.
+ *
+ * Arguments are converted to words by type: floats and doubles are sent as
+ * float bits (use %f/%g/%e), anything else, pointers included, is cast to
+ * uint32_t (%d %u %x %c %p).
+ * %s can't be supported: strings aren't available to the host.
+ */
+#define FMT_LOG_MAX_ARGS 4
+
+#define FMT_LOG(level, format, ...)                                          \
+  do                                                                         \
+  {                                                                          \
+    static const char fmtLogString[]                                         \
+        __attribute__((section(".fmt_log_strings"))) = format;               \
+    const uint32_t fmtLogArgs[FMT_LOG_MAX_ARGS + 1] = {                      \
+        FMT_LOG_WORDS(__VA_ARGS__) 0U};                                      \
+    fmt_sendLogFmt(level, fmtLogString, FMT_LOG_NARGS(__VA_ARGS__),          \
+                   fmtLogArgs);                                              \
+  } while (0)
+
+/** Used by FMT_LOG().  format is never dereferenced: only its address (ID) is
+ * sent, so it may point into a section that isn't loaded. */
+bool fmt_sendLogFmt(logLevel_t level, const char *format, uint32_t argCount,
+                    const uint32_t args[]);
+
+static inline uint32_t fmt_logFloatWord(double value)
+{
+  union { float f; uint32_t word; } bits = {.f = (float)value};
+  return bits.word;
+}
+static inline uint32_t fmt_logIntWord(uint32_t value)
+{
+  return value;
+}
+// The argument is cast for the default case too, so pointers (%p) convert
+// without an int-conversion diagnostic.
+#define FMT_LOG_WORD(x) _Generic((x),                       \
+    float: fmt_logFloatWord,                                \
+    double: fmt_logFloatWord,                               \
+    default: fmt_logIntWord)(_Generic((x),                  \
+    float: (x),                                             \
+    double: (x),                                            \
+    default: (uint32_t)(uintptr_t)(x))),
+
+// Argument counting and per-argument expansion, for 0 to FMT_LOG_MAX_ARGS.
+#define FMT_LOG_NARGS(...) FMT_LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define FMT_LOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define FMT_LOG_WORDS(...)                                  \
+  FMT_LOG_WORDS_(0, ##__VA_ARGS__, FMT_LOG_W4, FMT_LOG_W3, \
+                 FMT_LOG_W2, FMT_LOG_W1, FMT_LOG_W0)(__VA_ARGS__)
+#define FMT_LOG_WORDS_(_0, _1, _2, _3, _4, w, ...) w
+#define FMT_LOG_W0(...)
+#define FMT_LOG_W1(a) FMT_LOG_WORD(a)
+#define FMT_LOG_W2(a, b) FMT_LOG_WORD(a) FMT_LOG_WORD(b)
+#define FMT_LOG_W3(a, b, c) FMT_LOG_W2(a, b) FMT_LOG_WORD(c)
+#define FMT_LOG_W4(a, b, c, d) FMT_LOG_W2(a, b) FMT_LOG_W2(c, d)
\ No newline at end of file
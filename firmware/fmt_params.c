@@ -0,0 +1,404 @@
+#include <fmt_params.h> // in build binary dir
+#include "fmt_comms.h"  // fmt_sendMsg
+#include "fmt_flash.h"
+#include "fmt_sizes.h"  // MAX_MESSAGE_SIZE_BYTES
+#include <string.h>
+
+/** Store layout
+ * Each sector is a log of blocks, one write block (page or row) each, so no
+ * block is ever programmed twice between erases.  A block holds a batch of
+ * entries and a sequence number that increases across sectors, so replaying
+ * blocks in sequence order leaves the latest value of each parameter.
+ * A sector is only erased for reuse once the sector after it holds a snapshot
+ * of every parameter, flagged BLOCK_SNAPSHOT_END on its last block.
+ */
+#define BLOCK_SIZE 256 // A write block on all ports.
+#define BLOCKS_PER_SECTOR (FMT_PARAMS_SECTOR_SIZE / BLOCK_SIZE)
+#define BLOCK_MAGIC 0x314D5250 // "PRM1"
+#define BLOCK_SNAPSHOT_END 0x1
+#define ID_WORDS ((FMT_PARAMS_ID_MAX + 31) / 32)
+
+typedef struct
+{
+  uint16_t id;
+  uint16_t reserved;
+  uint32_t value;
+} paramEntry_t;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t sequence;
+  uint16_t count; // entries used.
+  uint16_t flags;
+  uint32_t check; // ~sum of the block's other words; catches torn writes.
+} blockHeader_t;
+
+#define ENTRIES_PER_BLOCK                                                      \
+  ((BLOCK_SIZE - sizeof(blockHeader_t)) / sizeof(paramEntry_t))
+
+typedef struct
+{
+  blockHeader_t header;
+  paramEntry_t entries[ENTRIES_PER_BLOCK];
+} paramBlock_t;
+
+_Static_assert(sizeof(paramBlock_t) == BLOCK_SIZE, "block must fill a page");
+_Static_assert(FMT_PARAMS_ID_MAX <= ENTRIES_PER_BLOCK * (BLOCKS_PER_SECTOR - 1),
+               "a snapshot must leave room in its sector");
+
+/* Value count comes from PARAM_VALUES_MAX_COUNT in firmentConfig.cmake via the
+nanopb max_count of ParamValues.values. */
+#define VALUES_PER_MSG (sizeof(((ParamValues *)0)->values) / sizeof(uint32_t))
+// Top adds a 2B tag (field 23) and 1B length around ParamValues.
+#if ParamValues_size + 3U > MAX_MESSAGE_SIZE_BYTES
+#error "ParamValues too big for a packet. Reduce PARAM_VALUES_MAX_COUNT."
+#endif
+
+static uint32_t values[FMT_PARAMS_ID_MAX];
+static uint32_t present[ID_WORDS]; // bit per id ever set.
+static uint32_t dirty[ID_WORDS];   // bit per id not yet appended.
+static uint32_t activeSector;
+static uint32_t nextBlock; // of activeSector; may not be erased.
+static uint32_t nextSequence;
+static bool snapshotDone; // activeSector holds every parameter.
+static bool erasing;      // the sector after activeSector.
+static paramBlock_t block;
+
+// Static function prototypes.
+static uint32_t blockAddress(uint32_t sector, uint32_t blockIndex);
+static bool readBlock(uint32_t sector, uint32_t blockIndex);
+static uint32_t blockCheck(void);
+static void replaySector(uint32_t sector);
+static bool appendDirty(void);
+static void startCompaction(void);
+static void finishCompaction(void);
+static bool testBit(const uint32_t *bits, uint32_t id);
+static void setBit(uint32_t *bits, uint32_t id);
+static bool anyBit(const uint32_t *bits);
+static const fmt_paramInfo_t *findParam(uint32_t id);
+static uint32_t currentValue(uint32_t id);
+static bool inRange(const fmt_paramInfo_t *param, uint32_t value);
+
+void fmt_params_init(void)
+{
+  uint32_t firstSequence[FMT_PARAMS_SECTOR_COUNT];
+  bool replayed[FMT_PARAMS_SECTOR_COUNT];
+
+  memset(present, 0, sizeof(present));
+  memset(dirty, 0, sizeof(dirty));
+  activeSector = 0;
+  nextBlock = 0;
+  nextSequence = 1;
+  snapshotDone = true;
+  erasing = false;
+
+  // Sectors are filled in turn, so each one's blocks are newer than those of
+  // the sectors before it.  Skip those without valid blocks.
+  uint32_t sectorsUsed = 0;
+  for (uint32_t s = 0; s < FMT_PARAMS_SECTOR_COUNT; s++)
+  {
+    replayed[s] = true;
+    for (uint32_t b = 0; b < BLOCKS_PER_SECTOR; b++)
+    {
+      if (readBlock(s, b))
+      {
+        firstSequence[s] = block.header.sequence;
+        replayed[s] = false;
+        sectorsUsed++;
+        break;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < sectorsUsed; i++)
+  {
+    uint32_t oldest = FMT_PARAMS_SECTOR_COUNT;
+    for (uint32_t s = 0; s < FMT_PARAMS_SECTOR_COUNT; s++)
+    {
+      if (!replayed[s] && (oldest == FMT_PARAMS_SECTOR_COUNT ||
+                           firstSequence[s] < firstSequence[oldest]))
+        oldest = s;
+    }
+    replayed[oldest] = true;
+    replaySector(oldest); // The newest is left active.
+  }
+
+  // An interrupted snapshot is redone before any other sector is erased.
+  if (!snapshotDone && sectorsUsed > 1)
+    memcpy(dirty, present, sizeof(dirty));
+  else
+    snapshotDone = true;
+}
+
+bool fmt_params_get(uint32_t id, uint32_t *value)
+{
+  if (id >= FMT_PARAMS_ID_MAX || !testBit(present, id))
+    return false;
+  *value = values[id];
+  return true;
+}
+
+bool fmt_params_set(uint32_t id, uint32_t value)
+{
+  if (id >= FMT_PARAMS_ID_MAX)
+    return false;
+  if (!testBit(present, id) || values[id] != value)
+  {
+    values[id] = value;
+    setBit(present, id);
+    setBit(dirty, id);
+  }
+  return true;
+}
+
+void fmt_params_handle(void)
+{
+  if (erasing)
+  {
+    int status = fmt_flash_pollErase();
+    if (status > 0)
+      return;
+    erasing = false;
+    if (status == 0)
+      finishCompaction();
+    return; // On failure, the next call tries again.
+  }
+
+  if (anyBit(dirty) && !appendDirty())
+    startCompaction();
+}
+
+/** handleTouchParam
+ * Ids not in the parameter table aren't answered.  A SET out of the table's
+ * range is ignored, as by ParamValues, and answered with the current value.
+ */
+void handleTouchParam(TouchParam msg)
+{
+  uint32_t id = msg.which_param;
+  uint32_t value = 0;
+  const fmt_paramInfo_t *param = findParam(id);
+  if (param == NULL)
+    return;
+
+  // Every param field is 32 bits.
+  if (msg.operation == ParamOperation_SET)
+  {
+    memcpy(&value, &msg.param, sizeof(value));
+    if (inRange(param, value))
+      fmt_params_set(id, value);
+  }
+  value = currentValue(id);
+
+  TouchParam reply = {
+      .operation = ParamOperation_CURRENT_VAL,
+      .which_param = id};
+  memcpy(&reply.param, &value, sizeof(value));
+  fmt_sendMsg((const Top){
+      .which_sub = Top_TouchParam_tag,
+      .sub = {.TouchParam = reply}});
+}
+
+void handleParamValues(ParamValues msg)
+{
+  ParamValues reply = {.operation = ParamOperation_CURRENT_VAL,
+                       .tableHash = fmt_paramTableHash,
+                       .firstIndex = msg.firstIndex};
+
+  if (msg.tableHash == fmt_paramTableHash && msg.firstIndex < fmt_paramCount)
+  {
+    uint32_t count = fmt_paramCount - msg.firstIndex;
+    if (count > VALUES_PER_MSG)
+      count = VALUES_PER_MSG;
+    if (msg.operation == ParamOperation_SET && msg.values_count < count)
+      count = msg.values_count;
+
+    const fmt_paramInfo_t *param = &fmt_paramTable[msg.firstIndex];
+    for (uint32_t i = 0; i < count; i++, param++)
+    {
+      if (msg.operation == ParamOperation_SET && inRange(param, msg.values[i]))
+        fmt_params_set(param->id, msg.values[i]);
+      reply.values[i] = currentValue(param->id);
+    }
+    reply.values_count = count;
+  }
+
+  fmt_sendMsg((const Top){
+      .which_sub = Top_ParamValues_tag,
+      .sub = {.ParamValues = reply}});
+}
+
+static uint32_t blockAddress(uint32_t sector, uint32_t blockIndex)
+{
+  return FMT_PARAMS_ADDRESS + sector * FMT_PARAMS_SECTOR_SIZE +
+         blockIndex * BLOCK_SIZE;
+}
+
+/** Reads a block into block.  @returns false unless it's valid. */
+static bool readBlock(uint32_t sector, uint32_t blockIndex)
+{
+  if (fmt_flash_read(blockAddress(sector, blockIndex), (uint8_t *)&block,
+                     sizeof(block)) < 0)
+    return false;
+  return block.header.magic == BLOCK_MAGIC &&
+         block.header.count <= ENTRIES_PER_BLOCK &&
+         block.header.check == blockCheck();
+}
+
+static uint32_t blockCheck(void)
+{
+  const uint32_t *words = (const uint32_t *)&block;
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < sizeof(block) / sizeof(uint32_t); i++)
+    sum += words[i];
+  return ~(sum - block.header.check);
+}
+
+/** Applies the sector's valid blocks and makes it the active sector. */
+static void replaySector(uint32_t sector)
+{
+  activeSector = sector;
+  nextBlock = 0;
+  snapshotDone = false;
+  for (uint32_t b = 0; b < BLOCKS_PER_SECTOR; b++)
+  {
+    if (!readBlock(sector, b))
+      continue; // Erased, or torn by a reset.
+
+    for (uint32_t i = 0; i < block.header.count; i++)
+    {
+      uint32_t id = block.entries[i].id;
+      if (id < FMT_PARAMS_ID_MAX)
+      {
+        values[id] = block.entries[i].value;
+        setBit(present, id);
+      }
+    }
+    if (block.header.flags & BLOCK_SNAPSHOT_END)
+      snapshotDone = true;
+    nextBlock = b + 1;
+    nextSequence = block.header.sequence + 1;
+  }
+}
+
+/** appendDirty
+ * Writes up to a block of dirty parameters to the next erased block.
+ * @returns false if the active sector is full.
+ */
+static bool appendDirty(void)
+{
+  while (nextBlock < BLOCKS_PER_SECTOR &&
+         !flash_isErased(blockAddress(activeSector, nextBlock), BLOCK_SIZE))
+    nextBlock++; // A block torn by a reset.
+  if (nextBlock >= BLOCKS_PER_SECTOR)
+    return false;
+
+  uint32_t written[ID_WORDS] = {0};
+  memset(&block, 0xFF, sizeof(block)); // Unused entries stay erased.
+  block.header = (blockHeader_t){.magic = BLOCK_MAGIC,
+                                 .sequence = nextSequence,
+                                 .count = 0};
+  for (uint32_t id = 0; id < FMT_PARAMS_ID_MAX; id++)
+  {
+    if (block.header.count == ENTRIES_PER_BLOCK)
+      break;
+    if (testBit(dirty, id))
+    {
+      block.entries[block.header.count++] =
+          (paramEntry_t){.id = id, .value = values[id]};
+      setBit(written, id);
+    }
+  }
+
+  bool lastOfSnapshot = !snapshotDone;
+  for (uint32_t i = 0; i < ID_WORDS; i++)
+    lastOfSnapshot &= (dirty[i] & ~written[i]) == 0;
+  if (lastOfSnapshot)
+    block.header.flags = BLOCK_SNAPSHOT_END;
+  block.header.check = blockCheck();
+
+  int status = fmt_flash_write(blockAddress(activeSector, nextBlock),
+                               (const uint8_t *)&block, sizeof(block));
+  nextBlock++;
+  nextSequence++;
+  if (status == 0)
+  {
+    for (uint32_t i = 0; i < ID_WORDS; i++)
+      dirty[i] &= ~written[i];
+    snapshotDone |= lastOfSnapshot;
+  }
+  return true;
+}
+
+/** Erases the next sector, unless that would lose what's not in this one. */
+static void startCompaction(void)
+{
+  if (!snapshotDone)
+    return; // Changes wait in RAM.
+  uint32_t next = (activeSector + 1) % FMT_PARAMS_SECTOR_COUNT;
+  if (fmt_flash_startErase(blockAddress(next, 0), FMT_PARAMS_SECTOR_SIZE) == 0)
+    erasing = true;
+}
+
+/** Moves to the erased sector and queues a snapshot of every parameter. */
+static void finishCompaction(void)
+{
+  activeSector = (activeSector + 1) % FMT_PARAMS_SECTOR_COUNT;
+  nextBlock = 0;
+  snapshotDone = false;
+  memcpy(dirty, present, sizeof(dirty));
+}
+
+static bool testBit(const uint32_t *bits, uint32_t id)
+{
+  return bits[id / 32] & (1U << (id % 32));
+}
+
+static void setBit(uint32_t *bits, uint32_t id)
+{
+  bits[id / 32] |= 1U << (id % 32);
+}
+
+static bool anyBit(const uint32_t *bits)
+{
+  for (uint32_t i = 0; i < ID_WORDS; i++)
+  {
+    if (bits[i])
+      return true;
+  }
+  return false;
+}
+
+static const fmt_paramInfo_t *findParam(uint32_t id)
+{
+  for (uint32_t i = 0; i < fmt_paramCount; i++)
+  {
+    if (fmt_paramTable[i].id == id)
+      return &fmt_paramTable[i];
+  }
+  return NULL;
+}
+
+/** The stored value, else the table's default, else 0. */
+static uint32_t currentValue(uint32_t id)
+{
+  uint32_t value;
+  if (fmt_params_get(id, &value))
+    return value;
+  const fmt_paramInfo_t *param = findParam(id);
+  return param ? param->initial.u : 0;
+}
+
+static bool inRange(const fmt_paramInfo_t *param, uint32_t value)
+{
+  fmt_paramValue_t v = {.u = value};
+  switch (param->type)
+  {
+  case FMT_PARAM_FLOAT:
+    return v.f >= param->min.f && v.f <= param->max.f; // false for NaN.
+  case FMT_PARAM_INT:
+    return v.i >= param->min.i && v.i <= param->max.i;
+  default:
+    return v.u >= param->min.u && v.u <= param->max.u;
+  }
+}
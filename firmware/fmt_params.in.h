@@ -0,0 +1,93 @@
+/**
+ * fmt_params.h -- Generated file.  See fmt_params.in.h
+ * Persistent parameters, in a log-structured key/value store in flash.
+ *
+ * Parameters are 32-bit values identified by an id below FMT_PARAMS_ID_MAX.
+ * Reads come from a RAM table built at boot by fmt_params_init().  Sets update
+ * the table and are appended to the store by fmt_params_handle(), many per
+ * write block, so a change never costs an erase.  When the sector being
+ * appended to is full, the next sector is erased in the background and the
+ * whole table written to it, so sectors wear evenly in turn.
+ */
+#pragma once
+
+#include "messages.pb.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Source: project-level partitions.cmake
+#define FMT_PARAMS_ADDRESS @PARAMS_STORE_ADDRESS@
+#define FMT_PARAMS_SECTOR_SIZE @PARAMS_SECTOR_SIZE@
+#define FMT_PARAMS_SECTOR_COUNT @PARAMS_SECTOR_COUNT@
+
+#define FMT_PARAMS_ID_MAX 64
+
+typedef enum
+{
+  FMT_PARAM_FLOAT,
+  FMT_PARAM_INT,
+  FMT_PARAM_UINT,
+  FMT_PARAM_BOOL,
+} fmt_paramType_t;
+
+typedef union
+{
+  float f;
+  int32_t i;
+  uint32_t u; // also bool.
+} fmt_paramValue_t;
+
+/** A parameter of the project's Params message.  Parameters never set read as
+ * initial through ParamValues and TouchParam. */
+typedef struct
+{
+  const char *name;
+  uint16_t id;
+  uint8_t type; // fmt_paramType_t
+  fmt_paramValue_t min;
+  fmt_paramValue_t max;
+  fmt_paramValue_t initial;
+} fmt_paramInfo_t;
+
+/* Generated into fmt_params.pb.c by gen-firment.py, in id order.  ParamValues
+ * addresses parameters by their index in this table. */
+extern const fmt_paramInfo_t fmt_paramTable[];
+extern const uint32_t fmt_paramCount;
+extern const uint32_t fmt_paramTableHash;
+
+/** fmt_params_init
+ * Builds the RAM table from the store.  Parameters never set read as absent.
+ */
+void fmt_params_init(void);
+
+/** fmt_params_get
+ * @returns false if id is out of range or was never set.
+ */
+bool fmt_params_get(uint32_t id, uint32_t *value);
+
+/** fmt_params_set
+ * Takes effect for fmt_params_get() at once, and in flash after
+ * fmt_params_handle() appends it.
+ * @returns false if id is out of range.
+ */
+bool fmt_params_set(uint32_t id, uint32_t value);
+
+/** fmt_params_handle
+ * Appends changed parameters to the store and advances compaction.  Call
+ * periodically from the context that calls fmt_handleRx().
+ */
+void fmt_params_handle(void);
+
+/** handleTouchParam
+ * The param oneof's field number is the parameter id; its value is stored as
+ * its 32 bits.  SET stores it.  SET and GET are answered with CURRENT_VAL.
+ */
+#define USE_TouchParam
+void handleTouchParam(TouchParam msg);
+
+/** handleParamValues
+ * Bulk GET and SET by table index.  Sets outside the table's range are ignored.
+ * Every request is answered with CURRENT_VAL; see firment_msg.proto.
+ */
+#define USE_ParamValues
+void handleParamValues(ParamValues msg);
@@ -0,0 +1,68 @@
+#include "fmt_periodic_port.h"
+#include "fmt_comms.h" // fmt_sendMsg
+#include "fmt_sizes.h" // MAX_MESSAGE_SIZE_BYTES
+
+// Top's tag for PeriodicTlm is over 15, so takes 2B, plus 1B length.
+#if PeriodicTlm_size + 3U > MAX_MESSAGE_SIZE_BYTES
+#error "PeriodicTlm too big for a packet."
+#endif
+
+static uint32_t toNs(const periodicTimer_t *timer, uint32_t counts);
+
+bool fmt_periodic_getStats(uint8_t timerId, fmt_periodicStats_t *stats)
+{
+  const periodicTimer_t *timer = port_getPeriodicTimer(timerId);
+  if (!timer || !timer->callback)
+    return false;
+
+  *stats = (fmt_periodicStats_t){
+      .periodNs = toNs(timer, timer->divide.period),
+      .ticks = timer->ticks,
+      .overruns = timer->overruns};
+  if (timer->ticks)
+  {
+    stats->minLatencyNs = toNs(timer, timer->minLatency);
+    stats->maxLatencyNs = toNs(timer, timer->maxLatency);
+  }
+  return true;
+}
+
+void fmt_periodic_resetStats(uint8_t timerId)
+{
+  periodicTimer_t *timer = port_getPeriodicTimer(timerId);
+  if (!timer)
+    return;
+  timer->ticks = 0;
+  timer->overruns = 0;
+  timer->minLatency = UINT32_MAX;
+  timer->maxLatency = 0;
+}
+
+bool fmt_periodic_sendTlm(uint8_t timerId)
+{
+  fmt_periodicStats_t stats;
+  if (!fmt_periodic_getStats(timerId, &stats))
+    return false;
+
+  bool sent = fmt_sendMsg((const Top){
+      .which_sub = Top_PeriodicTlm_tag,
+      .sub = {
+          .PeriodicTlm = {
+              .timerId = timerId,
+              .periodNs = stats.periodNs,
+              .ticks = stats.ticks,
+              .overruns = stats.overruns,
+              .minLatencyNs = stats.minLatencyNs,
+              .maxLatencyNs = stats.maxLatencyNs}}});
+  if (sent)
+    fmt_periodic_resetStats(timerId);
+  return sent;
+}
+
+static uint32_t toNs(const periodicTimer_t *timer, uint32_t counts)
+{
+  if (!timer->clockHz)
+    return 0;
+  return (uint64_t)counts * timer->divide.prescaler * 1000000000U /
+         timer->clockHz;
+}
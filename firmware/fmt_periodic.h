@@ -1,6 +1,11 @@
 /**
  * @file fmt_periodic.h
  * @brief Calls a provided function at a fixed interval from a HW-timer ISR.
+ *
+ * The port picks the timer's prescaler and period for intervalUs, down to
+ * FMT_PERIODIC_INTERVAL_MIN_US.  Each tick, the ISR measures its entry latency
+ * (time from the timer's update event to the ISR reading the counter) in timer
+ * clocks, and counts an overrun if the next tick came while the callback ran.
  */
 
 #ifndef fmt_periodic_h
@@ -9,9 +14,36 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define FMT_PERIODIC_INTERVAL_MIN_US 10U // 100kHz
+
 typedef void(*callback_t)(void);
 
+typedef struct
+{
+  uint32_t periodNs;     // As the timer achieves intervalUs.
+  uint32_t ticks;
+  uint32_t overruns;     // Ticks that came while the callback still ran.
+  uint32_t minLatencyNs; // From each tick to its ISR's entry.
+  uint32_t maxLatencyNs; // Less minLatencyNs: the jitter.
+} fmt_periodicStats_t;
+
+/** fmt_initPeriodic
+ * @returns false if there's no such timer, or intervalUs is out of its range.
+ */
 bool fmt_initPeriodic(
-  uint8_t timerId, uint32_t intervalUs, uint32_t priority, callback_t callback); 
+  uint8_t timerId, uint32_t intervalUs, uint32_t priority, callback_t callback);
+
+/** fmt_periodic_getStats
+ * Since init, or the last reset.  May be torn if the timer's ISR preempts.
+ * @returns false if the timer isn't initialized.
+ */
+bool fmt_periodic_getStats(uint8_t timerId, fmt_periodicStats_t *stats);
+void fmt_periodic_resetStats(uint8_t timerId);
+
+/** fmt_periodic_sendTlm
+ * Sends PeriodicTlm with the timer's stats, then resets them.
+ * @returns false if the timer isn't initialized or the send queue was full.
+ */
+bool fmt_periodic_sendTlm(uint8_t timerId);
 
-#endif // fmt_periodic_h
\ No newline at end of file
+#endif // fmt_periodic_h
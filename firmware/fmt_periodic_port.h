@@ -0,0 +1,58 @@
+#ifndef fmt_periodic_port_H
+#define fmt_periodic_port_H
+
+#include "fmt_periodic.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** A timer's clock divided down to an interval: prescaler * period clocks. */
+typedef struct
+{
+  uint32_t prescaler; // >= 1
+  uint32_t period;    // Counts per interval, >= 1.
+} timerDivide_t;
+
+/** A periodic timer's state, kept by the port for each timer it drives. */
+typedef struct
+{
+  callback_t callback; // NULL until initialized.
+  uint32_t clockHz;    // Before the prescaler.
+  timerDivide_t divide;
+  uint32_t ticks;
+  uint32_t overruns;
+  uint32_t minLatency; // Counts, after the prescaler.
+  uint32_t maxLatency;
+} periodicTimer_t;
+
+/** fmt_periodic_divide
+ * The least prescaler, a power of 2 if pow2Prescaler, that fits intervalUs in
+ * periodMax counts, for the finest period.  In port/common/periodic_common.c.
+ * @returns false if intervalUs is under FMT_PERIODIC_INTERVAL_MIN_US, or would
+ * need a prescaler over prescalerMax.
+ */
+bool fmt_periodic_divide(uint32_t clockHz, uint32_t intervalUs,
+                         uint32_t periodMax, uint32_t prescalerMax,
+                         bool pow2Prescaler, timerDivide_t *divide);
+
+/** port_getPeriodicTimer
+ * @returns the timer's state, or NULL if there's no such timer.
+ */
+periodicTimer_t *port_getPeriodicTimer(uint8_t timerId);
+
+/** fmt_periodic_tick
+ * For the port's timer ISRs: records a tick whose ISR read the timer's counter
+ * at latency counts past the update event, then runs the callback.  The ISR
+ * clears the update flag before, and checks it again after, to count overruns.
+ */
+static inline void fmt_periodic_tick(periodicTimer_t *timer, uint32_t latency)
+{
+  if (latency < timer->minLatency)
+    timer->minLatency = latency;
+  if (latency > timer->maxLatency)
+    timer->maxLatency = latency;
+  timer->ticks++;
+  if (timer->callback)
+    timer->callback();
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "fmt_profile.h"
+#include "fmt_comms.h" // fmt_sendMsg
+#include "fmt_sizes.h" // MAX_MESSAGE_SIZE_BYTES
+#include <string.h>
+
+// Top's tag for ProfileTlm is over 15, so takes 2B, plus 1B length.
+#if ProfileTlm_size + 3U > MAX_MESSAGE_SIZE_BYTES
+#error "ProfileTlm too big for a packet."
+#endif
+
+#define NAME_SIZE_MAX (sizeof(((ProfileTlm *)0)->name) - 1U)
+#define SHARE_FULL 255U
+
+_Static_assert(sizeof(((ProfileTlm *)0)->histogram.bytes) == FMT_PROFILE_BINS,
+               "ProfileTlm.histogram must hold a byte per bin");
+
+typedef struct
+{
+  const char *name;
+  uint64_t totalCycles;
+  fmt_profileStats_t stats;
+} site_t;
+
+static site_t sites[FMT_PROFILE_SITE_MAX] = {
+    [FMT_PROFILE_SPI_ISR] = {.name = "spiIsr"},
+    [FMT_PROFILE_UART_ISR] = {.name = "uartIsr"},
+    [FMT_PROFILE_GHOST_PROBE] = {.name = "ghostProbe"},
+    [FMT_PROFILE_WAVEFORM] = {.name = "waveform"},
+};
+static uint32_t siteCount = FMT_PROFILE_FIRMENT_SITES;
+static uint32_t nextToSend = 0;
+
+// Static function prototypes.
+static uint32_t binOf(uint32_t cycles);
+static void clearSite(site_t *site);
+
+int32_t fmt_profile_addSite(const char name[])
+{
+  if (siteCount >= FMT_PROFILE_SITE_MAX || !name)
+    return -1;
+  int32_t id = siteCount++;
+  sites[id].name = name;
+  clearSite(&sites[id]);
+  return id;
+}
+
+void fmt_profile_record(int32_t site, uint32_t cycles)
+{
+  if (site < 0 || (uint32_t)site >= siteCount)
+    return;
+  site_t *s = &sites[site];
+  fmt_profileStats_t *stats = &s->stats;
+
+  if (stats->count == 0 || cycles < stats->minCycles)
+    stats->minCycles = cycles;
+  if (cycles > stats->maxCycles)
+    stats->maxCycles = cycles;
+  stats->count++;
+  s->totalCycles += cycles;
+  stats->bins[binOf(cycles)]++;
+}
+
+/** Stats are written by the site, so may be torn if it preempts. */
+bool fmt_profile_getStats(int32_t site, fmt_profileStats_t *stats)
+{
+  if (site < 0 || (uint32_t)site >= siteCount)
+    return false;
+  *stats = sites[site].stats;
+  if (stats->count)
+    stats->meanCycles = sites[site].totalCycles / stats->count;
+  return true;
+}
+
+bool fmt_profile_send(void)
+{
+  for (uint32_t tried = 0; tried < siteCount; tried++)
+  {
+    uint32_t id = nextToSend;
+    fmt_profileStats_t stats;
+    fmt_profile_getStats(id, &stats);
+    if (stats.count == 0)
+    {
+      nextToSend = (id + 1) % siteCount;
+      continue;
+    }
+
+    ProfileTlm tlm = {
+        .count = stats.count,
+        .minCycles = stats.minCycles,
+        .maxCycles = stats.maxCycles,
+        .meanCycles = stats.meanCycles,
+        .histogram = {.size = FMT_PROFILE_BINS},
+        .cyclesPerUs = port_getCyclesPerUs()};
+    strncpy(tlm.name, sites[id].name, NAME_SIZE_MAX);
+    for (uint32_t bin = 0; bin < FMT_PROFILE_BINS; bin++)
+    {
+      // Rounded up, so rare but present run times aren't lost.
+      uint64_t scaled = (uint64_t)stats.bins[bin] * SHARE_FULL;
+      tlm.histogram.bytes[bin] = (scaled + stats.count - 1) / stats.count;
+    }
+
+    if (!fmt_sendMsg((const Top){
+            .which_sub = Top_ProfileTlm_tag,
+            .sub = {.ProfileTlm = tlm}}))
+      return false; // Retried, with the runs since, on the next call.
+    clearSite(&sites[id]);
+    nextToSend = (id + 1) % siteCount;
+    return true;
+  }
+  return false;
+}
+
+void fmt_profile_reset(void)
+{
+  siteCount = FMT_PROFILE_FIRMENT_SITES;
+  nextToSend = 0;
+  for (uint32_t id = 0; id < siteCount; id++)
+    clearSite(&sites[id]);
+}
+
+/** Bin 0 is [0, 2^BIN0_BITS); bin i, [2^(BIN0_BITS+i-1), 2^(BIN0_BITS+i)). */
+static uint32_t binOf(uint32_t cycles)
+{
+  uint32_t over = cycles >> FMT_PROFILE_BIN0_BITS;
+  if (over == 0)
+    return 0;
+  uint32_t bin = 32U - __builtin_clz(over);
+  return bin < FMT_PROFILE_BINS ? bin : FMT_PROFILE_BINS - 1U;
+}
+
+static void clearSite(site_t *site)
+{
+  site->stats = (fmt_profileStats_t){0};
+  site->totalCycles = 0;
+}
@@ -0,0 +1,114 @@
+/** Cycle-accurate profiling of ISRs and other hot paths.
+ *
+ * A profiled site brackets its code with fmt_profile_begin() and
+ * fmt_profile_end(), which read the core's cycle counter (cycles_port.h).  Each
+ * site keeps the count, min, max and mean of its run times in RAM, and a
+ * histogram of them in FMT_PROFILE_BINS power-of-2 bins.  fmt_profile_send()
+ * reports them as ProfileTlm.
+ *
+ * Firment profiles its own hot paths (fmt_profileSite_t) and fmt_sched tasks
+ * that have a name.  Projects may add sites of their own.  Unless the project
+ * sets ENABLE_PROFILE, all of this compiles to nothing.
+ *
+ * The cycle counter is stopped at reset unless a debugger starts it, and every
+ * run then records 0 cycles.  fmt_initSys() starts it; a project that doesn't
+ * call fmt_initSys() must call fmt_profile_init() before any site runs.
+ */
+#pragma once
+
+#include <cycles_port.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FMT_PROFILE_SITE_MAX 16U
+#define FMT_PROFILE_BINS 8U
+// Bin 0 holds runs of under 2^FMT_PROFILE_BIN0_BITS cycles.  Each bin after it
+// holds runs twice as long as the one before, and the last, all longer runs.
+#define FMT_PROFILE_BIN0_BITS 7U
+
+typedef enum
+{
+  FMT_PROFILE_SPI_ISR,
+  FMT_PROFILE_UART_ISR,
+  FMT_PROFILE_GHOST_PROBE,
+  FMT_PROFILE_WAVEFORM,
+  FMT_PROFILE_FIRMENT_SITES, // Sites added by fmt_profile_addSite() follow.
+} fmt_profileSite_t;
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint32_t meanCycles;
+  uint32_t bins[FMT_PROFILE_BINS];
+} fmt_profileStats_t;
+
+/** fmt_profile_init
+ * Starts the cycle counter.  Harmless if it's running already.
+ */
+static inline void fmt_profile_init(void)
+{
+#ifdef FMT_ENABLE_PROFILE
+  port_initCycleCounter();
+#endif
+}
+
+#ifdef FMT_ENABLE_PROFILE
+
+/** fmt_profile_addSite
+ * name is sent in ProfileTlm, truncated to fit, so must outlive the site.
+ * @returns the site's id, or -1 if there's no room.
+ */
+int32_t fmt_profile_addSite(const char name[]);
+
+/** fmt_profile_record
+ * Adds a run of the site.  Lock-free, for use from any one context per site.
+ */
+void fmt_profile_record(int32_t site, uint32_t cycles);
+
+/** fmt_profile_getStats
+ * The site's runs since it was last sent.
+ * @returns false if there's no such site.
+ */
+bool fmt_profile_getStats(int32_t site, fmt_profileStats_t *stats);
+
+/** fmt_profile_send
+ * Sends ProfileTlm for the next site, in turn, that has run since it was last
+ * sent, then clears its stats.  Does nothing if no site has run.
+ * @returns true if a site was sent.
+ */
+bool fmt_profile_send(void);
+
+/** fmt_profile_reset
+ * Removes the sites added by fmt_profile_addSite() and clears every site.
+ */
+void fmt_profile_reset(void);
+
+#else
+
+static inline int32_t fmt_profile_addSite(const char name[]) { return -1; }
+static inline void fmt_profile_record(int32_t site, uint32_t cycles) {}
+
+#endif
+
+/** Brackets a profiled site: eg.
+ *   uint32_t begin = fmt_profile_begin();
+ *   ...
+ *   fmt_profile_end(FMT_PROFILE_SPI_ISR, begin);
+ */
+static inline uint32_t fmt_profile_begin(void)
+{
+#ifdef FMT_ENABLE_PROFILE
+  return port_getCycles();
+#else
+  return 0;
+#endif
+}
+
+static inline void fmt_profile_end(int32_t site, uint32_t begin)
+{
+#ifdef FMT_ENABLE_PROFILE
+  fmt_profile_record(site, port_getCycles() - begin);
+#endif
+}
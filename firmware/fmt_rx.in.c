@@ -5,8 +5,13 @@
 #include <fmt_update.h>
 #include <fmt_rx.h>
 #include <fmt_comms.h>       // fmt_getMsg()
-#include <fmt_log.h>       // fmt_sendLog()
 #include <ghostProbe.h>    // handleRunScanCtl()
+#ifdef FMT_ENABLE_WAVEFORM
+#include <fmt_waveform.h>  // handleWaveTable()
+#endif
+#ifdef FMT_ENABLE_PARAMS
+#include <fmt_params.h>    // handleTouchParam()
+#endif
 #include <message_handlers.h> // all project-specific handlers
 
 void fmt_handleRx(void)
@@ -25,11 +30,8 @@ void fmt_handleRx(void)
     default:
     }
   }
-  else
-  { // failed to decode.
-    // TODO: figure out why this causes messages to overflow send buffer.
-    // fmt_sendLog(LOG_ERROR, "decode error", 0.0F);
-  }
+  // fmt_getMsg() is also false when there's nothing to read, so decode errors
+  // can't be logged here: they're counted in FirmentErrorTlm.decodeFail.
 }
 
 // Stub handler so consuming project can opt out of building ghostProbe.c
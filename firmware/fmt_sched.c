@@ -0,0 +1,221 @@
+#include "fmt_sched.h"
+#include "fmt_profile.h"
+#include <cycles_port.h>
+#include <string.h>
+
+#define NO_TASK 0U // Links are task id + 1, so zeroed links are empty.
+#define SLOT_MASK (FMT_SCHED_WHEEL_SLOTS - 1U)
+// Auto phases are chosen among the first few ticks of the period only.
+#define PHASE_CANDIDATES_MAX (FMT_SCHED_WHEEL_SLOTS * 8U)
+
+_Static_assert((FMT_SCHED_WHEEL_SLOTS & SLOT_MASK) == 0,
+               "wheel slots must be a power of 2");
+_Static_assert(FMT_SCHED_TASK_MAX < UINT8_MAX, "links must fit a uint8_t");
+
+typedef struct
+{
+  fmt_taskCfg_t cfg;
+  uint32_t nextDue; // tick
+  uint32_t deadlineCycles;
+  uint64_t totalCycles;
+  fmt_taskStats_t stats;
+  int32_t profileSite;
+  uint8_t next; // link to the next task in its wheel slot, by priority.
+} task_t;
+
+static task_t tasks[FMT_SCHED_TASK_MAX];
+static uint32_t taskCount = 0;
+static uint8_t wheel[FMT_SCHED_WHEEL_SLOTS]; // link to each slot's first.
+static uint32_t tickCount = 0;
+static uint32_t cyclesPerTick = 0;
+static fmt_schedStats_t schedStats;
+
+// Static function prototypes.
+static void insertTask(uint8_t taskLink);
+static uint32_t leastSharedPhase(uint32_t period);
+static uint32_t gcd(uint32_t a, uint32_t b);
+static void setDeadline(task_t *task);
+static void recordRun(task_t *task, uint32_t tickStart, uint32_t runStart);
+
+int32_t fmt_sched_addTask(const fmt_taskCfg_t *cfg)
+{
+  if (taskCount >= FMT_SCHED_TASK_MAX || !cfg->run || cfg->periodTicks == 0)
+    return -1;
+  if (cfg->phaseTicks != FMT_SCHED_PHASE_AUTO &&
+      cfg->phaseTicks >= cfg->periodTicks)
+    return -1;
+
+  uint8_t id = taskCount++;
+  task_t *task = &tasks[id];
+  *task = (task_t){.cfg = *cfg};
+  if (cfg->phaseTicks == FMT_SCHED_PHASE_AUTO)
+    task->cfg.phaseTicks = leastSharedPhase(cfg->periodTicks);
+  task->nextDue = tickCount + task->cfg.phaseTicks;
+  task->profileSite = cfg->name ? fmt_profile_addSite(cfg->name) : -1;
+  setDeadline(task);
+  insertTask(id + 1);
+  return id;
+}
+
+bool fmt_sched_start(uint8_t timerId, uint32_t tickUs, uint32_t priority)
+{
+  port_initCycleCounter();
+  cyclesPerTick = tickUs * port_getCyclesPerUs();
+  for (uint32_t id = 0; id < taskCount; id++)
+    setDeadline(&tasks[id]);
+  return fmt_initPeriodic(timerId, tickUs, priority, fmt_sched_tick);
+}
+
+void fmt_sched_tick(void)
+{
+  uint32_t tickStart = port_getCycles();
+  uint32_t now = tickCount;
+
+  // Take the tasks due now out of the slot, keeping their priority order.
+  // Those left are due on a later turn of the wheel.
+  uint8_t due = NO_TASK;
+  uint8_t *dueTail = &due;
+  uint8_t *link = &wheel[now & SLOT_MASK];
+  while (*link != NO_TASK)
+  {
+    task_t *task = &tasks[*link - 1];
+    if (task->nextDue == now)
+    {
+      *dueTail = *link;
+      dueTail = &task->next;
+      *link = task->next;
+    }
+    else
+      link = &task->next;
+  }
+  *dueTail = NO_TASK;
+
+  for (uint8_t taskLink = due, nextLink; taskLink != NO_TASK;
+       taskLink = nextLink)
+  {
+    task_t *task = &tasks[taskLink - 1];
+    nextLink = task->next;
+    uint32_t runStart = port_getCycles();
+    task->cfg.run();
+    recordRun(task, tickStart, runStart);
+    task->nextDue = now + task->cfg.periodTicks;
+    insertTask(taskLink);
+  }
+  tickCount = now + 1;
+
+  uint32_t tickCycles = port_getCycles() - tickStart;
+  schedStats.ticks++;
+  if (tickCycles > schedStats.maxTickCycles)
+    schedStats.maxTickCycles = tickCycles;
+  if (cyclesPerTick && tickCycles > cyclesPerTick)
+    schedStats.overruns++;
+}
+
+/** Stats are written by fmt_sched_tick(), so may be torn if it preempts. */
+bool fmt_sched_getTaskStats(int32_t taskId, fmt_taskStats_t *stats)
+{
+  if (taskId < 0 || (uint32_t)taskId >= taskCount)
+    return false;
+  task_t *task = &tasks[taskId];
+  *stats = task->stats;
+  if (stats->runs)
+    stats->meanCycles = task->totalCycles / stats->runs;
+  return true;
+}
+
+void fmt_sched_getStats(fmt_schedStats_t *stats)
+{
+  *stats = schedStats;
+}
+
+void fmt_sched_resetStats(void)
+{
+  for (uint32_t id = 0; id < taskCount; id++)
+  {
+    tasks[id].stats = (fmt_taskStats_t){0};
+    tasks[id].totalCycles = 0;
+  }
+  schedStats = (fmt_schedStats_t){0};
+}
+
+void fmt_sched_reset(void)
+{
+  taskCount = 0;
+  tickCount = 0;
+  memset(wheel, NO_TASK, sizeof(wheel));
+  schedStats = (fmt_schedStats_t){0};
+}
+
+/** Adds the task to the slot it's next due in, after tasks of its priority. */
+static void insertTask(uint8_t taskLink)
+{
+  task_t *task = &tasks[taskLink - 1];
+  uint8_t *link = &wheel[task->nextDue & SLOT_MASK];
+  while (*link != NO_TASK &&
+         tasks[*link - 1].cfg.priority <= task->cfg.priority)
+    link = &tasks[*link - 1].next;
+  task->next = *link;
+  *link = taskLink;
+}
+
+/** The phase that the fewest tasks already added ever run on. */
+static uint32_t leastSharedPhase(uint32_t period)
+{
+  uint32_t bestPhase = 0;
+  uint32_t bestShared = UINT32_MAX;
+  uint32_t candidates =
+      period < PHASE_CANDIDATES_MAX ? period : PHASE_CANDIDATES_MAX;
+
+  for (uint32_t phase = 0; phase < candidates; phase++)
+  {
+    // Two tasks ever run on the same tick iff their phases are congruent
+    // modulo the gcd of their periods.
+    uint32_t shared = 0;
+    for (uint32_t id = 0; id < taskCount; id++)
+    {
+      uint32_t g = gcd(period, tasks[id].cfg.periodTicks);
+      if (phase % g == tasks[id].cfg.phaseTicks % g)
+        shared++;
+    }
+    if (shared < bestShared)
+    {
+      bestShared = shared;
+      bestPhase = phase;
+    }
+  }
+  return bestPhase;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+  while (b)
+  {
+    uint32_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+static void setDeadline(task_t *task)
+{
+  task->deadlineCycles = task->cfg.deadlineUs
+                             ? task->cfg.deadlineUs * port_getCyclesPerUs()
+                             : cyclesPerTick;
+}
+
+static void recordRun(task_t *task, uint32_t tickStart, uint32_t runStart)
+{
+  uint32_t end = port_getCycles();
+  uint32_t cycles = end - runStart;
+  fmt_taskStats_t *stats = &task->stats;
+
+  stats->runs++;
+  stats->lastCycles = cycles;
+  if (cycles > stats->maxCycles)
+    stats->maxCycles = cycles;
+  task->totalCycles += cycles;
+  fmt_profile_record(task->profileSite, cycles);
+  if (task->deadlineCycles && end - tickStart > task->deadlineCycles)
+    stats->deadlineMisses++;
+}
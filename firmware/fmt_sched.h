@@ -0,0 +1,74 @@
+/** Runs many periodic tasks from one fmt_initPeriodic() timer.
+ *
+ * Each tick of the timer runs the tasks due on it, to completion, in priority
+ * order.  Tasks are kept on a time wheel of FMT_SCHED_WHEEL_SLOTS slots, so a
+ * tick only visits the tasks in its slot rather than all of them.  Giving tasks
+ * of the same period different phases spreads them over the ticks; by default
+ * fmt_sched_addTask() picks the phase shared with the fewest other tasks.
+ *
+ * Task run times are measured with the core's cycle counter (cycles_port.h).
+ * A task that finishes later than deadlineUs after its tick started is counted
+ * as a deadline miss.
+ */
+#pragma once
+
+#include "fmt_periodic.h" // callback_t
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FMT_SCHED_TASK_MAX 16U
+#define FMT_SCHED_WHEEL_SLOTS 32U // Power of 2.
+#define FMT_SCHED_PHASE_AUTO UINT32_MAX
+
+typedef struct
+{
+  callback_t run;
+  uint32_t periodTicks;
+  uint32_t phaseTicks;  // Tick of first run, < periodTicks, or PHASE_AUTO.
+  uint32_t deadlineUs;  // From the start of the tick.  0: one tick.
+  uint8_t priority;     // Of tasks due on the same tick, lesser runs first.
+  const char *name;     // If set, run times are profiled (fmt_profile.h).
+} fmt_taskCfg_t;
+
+typedef struct
+{
+  uint32_t runs;
+  uint32_t deadlineMisses;
+  uint32_t lastCycles;
+  uint32_t maxCycles;
+  uint32_t meanCycles;
+} fmt_taskStats_t;
+
+typedef struct
+{
+  uint32_t ticks;
+  uint32_t overruns;    // Ticks that ran past the start of the next tick.
+  uint32_t maxTickCycles;
+} fmt_schedStats_t;
+
+/** fmt_sched_addTask
+ * Call before fmt_sched_start().
+ * @returns the task's id, or -1 if the task table is full or cfg is invalid.
+ */
+int32_t fmt_sched_addTask(const fmt_taskCfg_t *cfg);
+
+/** fmt_sched_start
+ * Starts the tick timer.  Tasks due on tick 0 run on its first interrupt.
+ */
+bool fmt_sched_start(uint8_t timerId, uint32_t tickUs, uint32_t priority);
+
+/** fmt_sched_tick
+ * The timer callback.  Call it directly to drive the scheduler some other way,
+ * eg. from an RTOS task, once per tickUs.
+ */
+void fmt_sched_tick(void);
+
+bool fmt_sched_getTaskStats(int32_t taskId, fmt_taskStats_t *stats);
+void fmt_sched_getStats(fmt_schedStats_t *stats);
+void fmt_sched_resetStats(void);
+
+/** fmt_sched_reset
+ * Removes every task and restarts the tick count.  The timer, if started,
+ * keeps calling fmt_sched_tick().
+ */
+void fmt_sched_reset(void);
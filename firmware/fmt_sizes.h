@@ -17,6 +17,12 @@
 #define SEND_QUEUE_LENGTH 10U
 #define RX_QUEUE_LENGTH 9U
 #define MAX_SENDER_PRIORITY 16U
+#define LOG_RING_LENGTH 16U // Must be a power of 2.
+// Send queue slots fmt_drainLog() leaves free for telemetry.
+#define LOG_SEND_RESERVE (SEND_QUEUE_LENGTH / 2U)
+#define LOG_SITE_TABLE_LENGTH 16U // Rate-limited call sites. Power of 2.
+#define CRASH_STACK_WORDS 16U // Saved from the faulting sp.  Multiple of 8.
+#define CRASH_LOG_COUNT 4U    // Most recent logs saved at a fault.
 
 /** Get the position of the CRC in bytes from the first element of the packet.
  * CRC position must be 16-bit aligned (even number) for hardware CRC engines.
@@ -4,6 +4,7 @@
 // Dependencies owned by Firment
 #include "fmt_assert.h"
 #include "fmt_ioc.h" // fmt_initIoc
+#include "fmt_profile.h"
 #include "fmt_sizes.h"
 #include <fmt_spi_port.h> // port_initSpiModule()  port_getSpiEventIRQn()
 #include <core_port.h>    // NVIC_...()
@@ -161,6 +162,7 @@ void subClearToSendISR(void)
  */
 static void spiEventHandlerISR(uint32_t event)
 {
+  uint32_t begin = fmt_profile_begin();
   switch (event)
   {
   case ARM_SPI_EVENT_TRANSFER_COMPLETE:
@@ -190,4 +192,5 @@ static void spiEventHandlerISR(uint32_t event)
     spiErrCount.modeFault++;
     break;
   }
+  fmt_profile_end(FMT_PROFILE_SPI_ISR, begin);
 }
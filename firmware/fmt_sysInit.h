@@ -5,7 +5,7 @@
  * An MCU-specific function (to be implemented in port/<fam>/fmt_sysInit_port)
  * that does things like configure clocks, init HAL's etc.  Essentially anything
  * that the specific architecture requires that isn't initialized in module 
- * driver code.
+ * driver code.  Also starts the cycle counter fmt_profile.h reads.
  */
 void fmt_initSys(void);
 
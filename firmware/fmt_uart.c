@@ -24,6 +24,7 @@
 
 // Dependencies in Firment
 #include "fmt_assert.h"
+#include "fmt_profile.h"
 #include "fmt_uart_frame.h" // this replaces fmt_sizes.h
 #include <fmt_uart_port.h> // port_initUart() port_getUartEventIRQn()
 #include <core_port.h>
@@ -106,6 +107,7 @@ void uart_startTxChain(void)
  */
 void uartEventHandlerISR(uint32_t event)
 {
+  uint32_t begin = fmt_profile_begin();
   bool eventHandled = false;
 
   if ((event & ARM_USART_EVENT_RECEIVE_COMPLETE) || rxErrors(event))
@@ -133,6 +135,7 @@ void uartEventHandlerISR(uint32_t event)
   // If this function was called for an unhandled reason, let's learn about it.
   if (!eventHandled)
     uartErrCount.unhandledArmEvent++;
+  fmt_profile_end(FMT_PROFILE_UART_ISR, begin);
 }
 
 static inline bool rxErrors(uint32_t event)
@@ -0,0 +1,61 @@
+#include "fmt_unpack.h"
+#include "fmt_flash.h"
+#include <stddef.h>
+
+#define OFFSET_SIGN_BIT ((int32_t)1 << 21)
+
+static int32_t readBaseOffset(const uint8_t *in, uint8_t control)
+{
+  int32_t offset =
+      ((int32_t)(control & 0x3F) << 16) | ((int32_t)in[1] << 8) | in[0];
+  return (offset ^ OFFSET_SIGN_BIT) - OFFSET_SIGN_BIT; // sign-extend.
+}
+
+int32_t fmt_unpack(const uint8_t *in, uint32_t inLen, uint8_t *out,
+                   uint32_t outLen, const unpackBase_t *base)
+{
+  uint32_t inPos = 0;
+  uint32_t outPos = 0;
+
+  while (inPos < inLen)
+  {
+    uint8_t control = in[inPos++];
+    if (control < 0x80)
+    {
+      uint32_t runLen = control + 1U;
+      if (runLen > inLen - inPos || runLen > outLen - outPos)
+        return -1;
+      for (uint32_t i = 0; i < runLen; i++)
+        out[outPos++] = in[inPos++];
+    }
+    else if (control < 0xC0)
+    {
+      if (inPos == inLen)
+        return -1;
+      uint32_t distance = in[inPos++] + 1U;
+      uint32_t matchLen = (control & 0x3FU) + UNPACK_MATCH_MIN;
+      if (distance > outPos || matchLen > outLen - outPos)
+        return -1;
+      // Byte by byte: the source may overlap what this match writes.
+      for (uint32_t i = 0; i < matchLen; i++, outPos++)
+        out[outPos] = out[outPos - distance];
+    }
+    else
+    {
+      if (base == NULL || inLen - inPos < 3)
+        return -1;
+      int32_t start = (int32_t)(base->offset + outPos) +
+                      readBaseOffset(&in[inPos], control);
+      uint32_t copyLen = in[inPos + 2] + 1U;
+      inPos += 3;
+      if (start < 0 || copyLen > base->size ||
+          (uint32_t)start > base->size - copyLen || copyLen > outLen - outPos)
+        return -1;
+      if (fmt_flash_read(base->address + (uint32_t)start, &out[outPos],
+                         copyLen) < 0)
+        return -1;
+      outPos += copyLen;
+    }
+  }
+  return (int32_t)outPos;
+}
@@ -0,0 +1,41 @@
+#ifndef fmt_unpack_H
+#define fmt_unpack_H
+
+#include <stdint.h>
+
+/** Packed page format
+ * A byte-aligned LZ77 scheme simple enough to decode without any RAM beyond
+ * the output, whose window is the output itself and, for delta updates, a base
+ * image in flash.  A stream is a series of tokens, each starting with a control
+ * byte c:
+ *  - c < 0x80: a literal run.  The next (c + 1) bytes are copied to the output.
+ *  - 0x80 <= c < 0xC0: a match.  The byte after c is (distance - 1), and
+ *    ((c & 0x3F) + UNPACK_MATCH_MIN) bytes are copied from distance bytes back
+ *    in the output.  A match may overlap the bytes it produces.
+ *  - c >= 0xC0: a base copy.  Next are the low 16 bits of a signed 22-bit
+ *    offset (little-endian; c & 0x3F are its top bits), then (length - 1).
+ *    length bytes are copied from the base image, starting offset bytes from
+ *    the position in the base that corresponds to the current output position.
+ * The packers are packPage() in web-ui/src/pagePack.ts and tools/make-patch.py.
+ */
+#define UNPACK_MATCH_MIN 3
+#define UNPACK_DISTANCE_MAX 256
+
+typedef struct
+{
+  uint32_t address; // of the base image in flash.
+  uint32_t size;    // of the base image.
+  uint32_t offset;  // in the base image that corresponds to out[0].
+} unpackBase_t;
+
+/** fmt_unpack
+ * Decodes a packed stream of inLen bytes into out.
+ * @param base the image base copies read from, or NULL if there is none.
+ * @returns the number of bytes written to out, or -1 if the stream is
+ * malformed, reads outside the base image, or would write more than outLen
+ * bytes.
+ */
+int32_t fmt_unpack(const uint8_t *in, uint32_t inLen, uint8_t *out,
+                   uint32_t outLen, const unpackBase_t *base);
+
+#endif // fmt_unpack_H
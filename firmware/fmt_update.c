@@ -2,43 +2,121 @@
 #include <fmt_update.h> // in build binary dir
 #include "fmt_comms.h"  // fmt_sendMsg
 #include "fmt_flash.h"
+#include "fmt_unpack.h"
+#include <fmt_version.h> // fmt_getBuildId
 #include <stdbool.h>
+#include <string.h>
 
-static void sendPageStatus(uint32_t pageIndex, PageStatusEnum status)
+static void sendPageStatus(uint32_t pageIndex, PageStatusEnum status,
+                           uint32_t missingChunks)
 {
   fmt_sendMsg((const Top){
       .which_sub = Top_PageStatus_tag,
       .sub = {
           .PageStatus = {
               .pageIndex = pageIndex,
-              .status = status}}});
+              .status = status,
+              .missingChunks = missingChunks}}});
 }
 
 #if !FMT_UPDATE_SUPPORTED
 bool handleImageData(ImageData msg)
 {
-  sendPageStatus(msg.pageIndex, PageStatusEnum_WRITE_FAIL);
+  sendPageStatus(msg.pageIndex, PageStatusEnum_WRITE_FAIL, 0);
   return false;
 }
 
+void fmt_handleUpdate(void) {}
+
+void handlePageCrcs(PageCrcs msg)
+{
+  fmt_sendMsg((const Top){
+      .which_sub = Top_PagesPresent_tag,
+      .sub = {.PagesPresent = {.firstPageIndex = msg.firstPageIndex}}});
+}
+
 #else // FW update is supported.
 
 #define CHUNKS_PER_PAGE_MAX (UPDATE_PAGE_SIZE / DATA_MSG_PAYLOAD_SIZE_MAX)
 #define PAGES_COUNT_MAX (FMT_IMAGE_DOWNLOAD_PARTITION_SIZE / UPDATE_PAGE_SIZE)
-#define NO_CHUNKS_PROCESSED ((1 << CHUNKS_PER_PAGE_MAX) - 1)
+#define PAGE_DONE_WORDS ((PAGES_COUNT_MAX + 31) / 32)
+#define PAGES_PER_SECTOR (FMT_FLASH_SECTOR_SIZE / UPDATE_PAGE_SIZE)
+
+/** Page buffer pool
+ * handleImageData() fills a buffer per page in flight (FREE -> FILLING -> FULL)
+ * and fmt_handleUpdate() writes FULL buffers to flash (WRITING) and frees them
+ * once the write completes.  Both must run in the same context.
+ */
+typedef enum
+{
+  PAGE_BUF_FREE,
+  PAGE_BUF_FILLING,
+  PAGE_BUF_FULL,
+  PAGE_BUF_WRITING,
+} pageBufState_t;
+
+typedef struct
+{
+  pageBufState_t state;
+  uint32_t pageIndex;
+  uint32_t chunkCount;
+  uint32_t chunksPending; // bit n set: chunkIndex n not yet received.
+  bool packed;            // data is in fmt_unpack format.
+  bool delta;             // data may copy from the running image.
+  uint32_t dataSize;      // known once the last chunk arrives.
+  uint8_t data[UPDATE_PAGE_SIZE];
+} pageBuf_t;
 
-static uint32_t chunksPending = NO_CHUNKS_PROCESSED;
-static uint32_t activePage = 0;
-static uint8_t pageBuffer[UPDATE_PAGE_SIZE];
+/** Erase-ahead
+ * Sectors of the image are erased in order (NEXT <-> BUSY) before pages in
+ * them are written.  It starts with the image's first chunk, after any
+ * PageCrcs, so sectors holding pages already done are known and kept.
+ */
+typedef enum
+{
+  ERASE_AHEAD_IDLE,
+  ERASE_AHEAD_NEXT, // check the sector at eraseOffset.
+  ERASE_AHEAD_BUSY, // that sector is being erased.
+  ERASE_AHEAD_DONE,
+} eraseAheadState_t;
+
+static pageBuf_t pagePool[UPDATE_WINDOW_PAGES];
+static uint32_t pageCount = 0; // of the image being downloaded.
+static uint32_t imageId = 0;   // ditto; see PageCrcs.imageId.
+static uint32_t pagesWritten = 0;
+static uint32_t pageDone[PAGE_DONE_WORDS]; // bit per page written this image.
+static pageBuf_t *writingBuf = NULL; // one page is written at a time.
+static bool writingCurrentImage;     // else the image changed meanwhile.
+static volatile bool writeFinished;  // set by onPageWritten().
+static volatile int writeStatus;
+static eraseAheadState_t eraseState = ERASE_AHEAD_IDLE;
+static uint32_t eraseOffset = 0; // pages below this offset may be written.
 static callback_t downloadStartCb = NULL;
 static callback_t downloadCompleteCb = NULL;
 
 // Static function prototypes.
-static bool imageDataMsgValid(ImageData *msg);
-static bool allChunksProcessed(void);
-static void prepForNewPage(PageStatusEnum thisPageStatus);
-static void processChunk(ImageData *msg);
-static void processPage(void);
+static bool pageCountValid(uint32_t count);
+static bool chunkIndexValid(ImageData *msg);
+static bool baseBuildIdValid(ImageData *msg);
+static bool imageDataMsgValid(ImageData *msg, pageBuf_t *buf);
+static bool isNewImage(uint32_t msgPageCount, uint32_t msgImageId);
+static void startNewImage(uint32_t newPageCount, uint32_t newImageId);
+static bool isPageDone(uint32_t pageIndex);
+static bool eraseAheadStep(bool *eraseStarted);
+static bool prepareSector(bool *eraseStarted);
+static void reclaimPage(uint32_t pageIndex);
+static pageBuf_t *findPageBuf(uint32_t pageIndex);
+static pageBuf_t *claimPageBuf(ImageData *msg);
+static void failPage(uint32_t pageIndex, pageBuf_t *buf);
+static void requestResend(pageBuf_t *buf);
+static void processChunk(ImageData *msg, pageBuf_t *buf);
+static bool processPage(pageBuf_t *buf);
+static void onPageWritten(int status);
+static bool finishPageWrite(void);
+static void markPageDone(uint32_t pageIndex);
+static void clearPageDone(uint32_t pageIndex);
+static bool flashPageMatches(uint32_t pageIndex, uint32_t crc);
+static uint32_t crc32(uint32_t crc, const uint8_t *data, uint32_t len);
 
 void fmt_setFirstPageReceivedCallback(callback_t onDownloadStart)
 {
@@ -49,111 +127,492 @@ void fmt_setDownloadFinishCallback(callback_t onDownloadComplete)
   downloadCompleteCb = onDownloadComplete;
 }
 
+/** handleImageData
+ * Bad chunks and chunks lost before a page's last chunk are answered with
+ * REQUEST_RESEND listing every chunk still missing, keeping those received.
+ * Repeats of received chunks are ignored, so whole pages may be resent too.
+ * WRITE_FAIL (the page must be resent from scratch) is reserved for malformed
+ * chunk indices, images or pages outside the partition or window, and flash
+ * errors.
+ */
 bool handleImageData(ImageData msg)
 {
-  if (imageDataMsgValid(&msg))
+  if (!chunkIndexValid(&msg) || !baseBuildIdValid(&msg))
+  {
+    failPage(msg.pageIndex, findPageBuf(msg.pageIndex));
+    return false;
+  }
+
+  if (isNewImage(msg.pageCount, msg.imageId))
+    startNewImage(msg.pageCount, msg.imageId);
+  if (eraseState == ERASE_AHEAD_IDLE)
+    eraseState = ERASE_AHEAD_NEXT;
+
+  if (isPageDone(msg.pageIndex))
+  {
+    // Resent after its ack was lost.  Ack again, once per resent page.
+    // Pages done for another image were dropped when this one started.
+    if (msg.chunkIndex == msg.chunkCountInPage - 1)
+      sendPageStatus(msg.pageIndex, PageStatusEnum_WRITE_SUCCESS, 0);
+    return true;
+  }
+
+  pageBuf_t *buf = findPageBuf(msg.pageIndex);
+  if (buf && (buf->state == PAGE_BUF_FULL || buf->state == PAGE_BUF_WRITING))
+    return true; // Repeat of a chunk; the page is waiting to be written.
+
+  if (buf == NULL)
+    buf = claimPageBuf(&msg);
+  if (buf == NULL)
+  {
+    failPage(msg.pageIndex, NULL); // Sender overran the window.
+    return false;
+  }
+
+  if (!imageDataMsgValid(&msg, buf))
+  {
+    requestResend(buf);
+    return false;
+  }
+
+  if (buf->chunksPending & (1U << msg.chunkIndex))
+  {
+    processChunk(&msg, buf);
+    if (buf->chunksPending == 0)
+      buf->state = PAGE_BUF_FULL;
+    else if (msg.chunkIndex == buf->chunkCount - 1)
+      requestResend(buf); // Chunks are sent in order: earlier ones were lost.
+  }
+  return true;
+}
+
+void fmt_handleUpdate(void)
+{
+  fmt_flash_pollWrite();
+  if (writingBuf && !finishPageWrite())
+    return; // Comms carry on while the page programs.
+
+  // At most one sector erase is started per call.  Some ports (XMC4) erase
+  // synchronously, seconds per sector, and comms need a turn between them.
+  bool eraseStarted = false;
+  while (eraseAheadStep(&eraseStarted))
+    ;
+  if (eraseState == ERASE_AHEAD_BUSY)
+    return; // The partition's flash is busy; pages wait in the pool.
+
+  for (uint32_t i = 0; i < UPDATE_WINDOW_PAGES; i++)
   {
-    processChunk(&msg);
-    if (allChunksProcessed())
+    pageBuf_t *buf = &pagePool[i];
+    if (buf->state == PAGE_BUF_FULL &&
+        buf->pageIndex * UPDATE_PAGE_SIZE < eraseOffset)
     {
-      if (downloadStartCb && activePage == 0)
+      if (downloadStartCb && pagesWritten == 0)
         downloadStartCb();
-      processPage();
-      prepForNewPage(PageStatusEnum_WRITE_SUCCESS);
-      if (downloadCompleteCb && activePage == (msg.pageCount - 1))
-        downloadCompleteCb();
+      buf->state = PAGE_BUF_WRITING;
+      writingBuf = buf;
+      writingCurrentImage = true;
+      writeFinished = false;
+      if (!processPage(buf))
+        onPageWritten(-1);
+      // Short writes may already be done.
+      fmt_flash_pollWrite();
+      finishPageWrite();
+      return; // One page write per call bounds the time spent here.
     }
-    return true;
   }
-  else
+}
+
+/** handlePageCrcs
+ * The CRCs are authoritative: a page counts as present only if flash matches
+ * its CRC, even if it was marked done.  So pages done for an abandoned image
+ * are never acked for the next one, even one with the same ID.
+ */
+void handlePageCrcs(PageCrcs msg)
+{
+  if (!pageCountValid(msg.pageCount))
   {
-    prepForNewPage(PageStatusEnum_WRITE_FAIL);
-    return false;
+    // Too big for the partition: nothing is present, and it isn't started.
+    fmt_sendMsg((const Top){
+        .which_sub = Top_PagesPresent_tag,
+        .sub = {.PagesPresent = {.firstPageIndex = msg.firstPageIndex}}});
+    return;
   }
+  if (isNewImage(msg.pageCount, msg.imageId))
+    startNewImage(msg.pageCount, msg.imageId);
+
+  uint32_t present = 0;
+  for (uint32_t i = 0; i < msg.crcs_count; i++)
+  {
+    uint32_t pageIndex = msg.firstPageIndex + i;
+    if (pageIndex >= pageCount)
+      break;
+
+    // Pages in the pool are left for the chunks on their way to complete.
+    if (findPageBuf(pageIndex) == NULL)
+    {
+      bool matches = flashPageMatches(pageIndex, msg.crcs[i]);
+      if (matches && !isPageDone(pageIndex))
+        markPageDone(pageIndex);
+      else if (!matches && isPageDone(pageIndex))
+        clearPageDone(pageIndex);
+    }
+
+    if (isPageDone(pageIndex))
+      present |= 1U << i;
+  }
+
+  fmt_sendMsg((const Top){
+      .which_sub = Top_PagesPresent_tag,
+      .sub = {
+          .PagesPresent = {
+              .firstPageIndex = msg.firstPageIndex,
+              .present = present}}});
+}
+
+/** An image must fit the download partition: erase-ahead and pageDone[] are
+ * bounded by the page count alone. */
+static bool pageCountValid(uint32_t count)
+{
+  return count > 0 && count <= PAGES_COUNT_MAX;
+}
+
+/** Checks what must hold before a chunk can be matched to a page buffer. */
+static bool chunkIndexValid(ImageData *msg)
+{
+  return pageCountValid(msg->pageCount) &&
+         msg->chunkCountInPage > 0 &&
+         msg->chunkCountInPage <= CHUNKS_PER_PAGE_MAX &&
+         msg->chunkIndex < msg->chunkCountInPage &&
+         msg->pageIndex < msg->pageCount;
+}
+
+/** A delta only applies to the build it was made against. */
+static bool baseBuildIdValid(ImageData *msg)
+{
+  return msg->baseBuildId == 0 ||
+         (msg->packed && msg->baseBuildId == fmt_getBuildId());
 }
 
 /** imageDataMsgValid enforces the following policy on ImageData messages:
- * only accept a new page if there are no unprocessed chunks on the active page.
+ * every chunk of a page agrees on the page's chunk count and packing, and all
+ * but the last chunk are full.
  */
-static bool imageDataMsgValid(ImageData *msg)
+static bool imageDataMsgValid(ImageData *msg, pageBuf_t *buf)
 {
-  // TODO: consider adding a policy akin to pageIndex that chunkCountInPage
-  // can't change once one chunk has been received for the active page.
-
   union err_u
   {
     struct errBits_s
     {
-      uint32_t chunkIndexTooBig : 1;
-      uint32_t chunkIndexAlreadyReceived : 1;
+      uint32_t chunkCountChanged : 1;
+      uint32_t packedChanged : 1;
       uint32_t shortChunkThatIsntLast : 1;
       uint32_t payloadSizeTooBig : 1;
-      uint32_t prematureNewPage : 1;
-      uint32_t pageIndexTooBig : 1;
     } b; // b for bits
     uint32_t overall;
   };
 
   union err_u err = {0};
 
-  // (chunkIndexOk && dataSizeOk) implies no buffer overflow.
-  // This chunk must be still pending (no repeats).
-  err.b.chunkIndexTooBig = msg->chunkIndex >= CHUNKS_PER_PAGE_MAX;
-  err.b.chunkIndexAlreadyReceived = !(chunksPending & (1 << msg->chunkIndex));
+  err.b.chunkCountChanged = msg->chunkCountInPage != buf->chunkCount;
+  err.b.packedChanged = msg->packed != buf->packed ||
+                        (msg->baseBuildId != 0) != buf->delta;
 
   bool chunkNotLast = msg->chunkIndex != (msg->chunkCountInPage - 1);
   bool shortChunk = msg->payload.size < DATA_MSG_PAYLOAD_SIZE_MAX;
   err.b.shortChunkThatIsntLast = shortChunk && chunkNotLast;
 
   // Only the last chunk is allowed to be shorter than the max size.
+  // (chunkIndex valid && dataSizeOk) implies no buffer overflow.
   err.b.payloadSizeTooBig = msg->payload.size > DATA_MSG_PAYLOAD_SIZE_MAX;
 
-  // all messages must have the same pageIndex until all chunks are processed.
-  err.b.prematureNewPage =
-      msg->pageIndex != activePage && chunksPending != NO_CHUNKS_PROCESSED;
-  err.b.pageIndexTooBig = msg->pageIndex >= PAGES_COUNT_MAX;
-
   return err.overall == 0;
 }
 
-static bool allChunksProcessed(void)
+static bool isNewImage(uint32_t msgPageCount, uint32_t msgImageId)
 {
-  return !chunksPending;
+  return msgPageCount != pageCount || msgImageId != imageId;
 }
 
-static void prepForNewPage(PageStatusEnum thisPageStatus)
+/** Pages of the previous image still in the pool are dropped. */
+static void startNewImage(uint32_t newPageCount, uint32_t newImageId)
 {
-  chunksPending = NO_CHUNKS_PROCESSED; // signals a page-change is allowed.
-  // should be last; ungates new messages being sent.
-  sendPageStatus(activePage, thisPageStatus);
+  // A page being written keeps its buffer until the write completes.
+  for (uint32_t i = 0; i < UPDATE_WINDOW_PAGES; i++)
+  {
+    if (pagePool[i].state != PAGE_BUF_WRITING)
+      pagePool[i].state = PAGE_BUF_FREE;
+  }
+  writingCurrentImage = false;
+  memset(pageDone, 0, sizeof(pageDone));
+  pageCount = newPageCount;
+  imageId = newImageId;
+  pagesWritten = 0;
+  eraseState = ERASE_AHEAD_IDLE;
+  eraseOffset = 0;
 }
 
-static void processChunk(ImageData *msg)
+static bool isPageDone(uint32_t pageIndex)
 {
-  // Note: pageIndex != activePage only when no chunks have been processed yet.
-  activePage = msg->pageIndex;
+  return pageDone[pageIndex / 32] & (1U << (pageIndex % 32));
+}
 
-  // Each bit in chunksPending tracks the status of a chunk with a given index.
+/** eraseAheadStep
+ * Advances the erase-ahead by a step that doesn't wait on the flash.
+ * @param eraseStarted set once a sector erase was started; no other is then.
+ * @returns true if another step can be taken right away.
+ */
+static bool eraseAheadStep(bool *eraseStarted)
+{
+  switch (eraseState)
+  {
+  case ERASE_AHEAD_NEXT:
+    return !*eraseStarted && prepareSector(eraseStarted);
+  case ERASE_AHEAD_BUSY:
+    if (fmt_flash_pollErase() > 0)
+      return false;
+    // On failure, fmt_flash_write() erases what it finds unerased instead.
+    eraseState = ERASE_AHEAD_NEXT;
+    eraseOffset += FMT_FLASH_SECTOR_SIZE;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/** prepareSector
+ * Starts erasing the sector at eraseOffset unless the image's pages in it are
+ * erased already or done.  Done pages sharing a sector with unerased ones (left
+ * by an interrupted write) are reclaimed first, one per call.
+ */
+static bool prepareSector(bool *eraseStarted)
+{
+  uint32_t firstPage = eraseOffset / UPDATE_PAGE_SIZE;
+  uint32_t endPage = firstPage + PAGES_PER_SECTOR;
+  if (endPage > pageCount)
+    endPage = pageCount;
+  if (firstPage >= endPage)
+  {
+    eraseState = ERASE_AHEAD_DONE;
+    eraseOffset = pageCount * UPDATE_PAGE_SIZE;
+    return false;
+  }
+
+  bool erasedOrDone = true;
+  uint32_t donePage = endPage;
+  for (uint32_t page = firstPage; page < endPage; page++)
+  {
+    if (isPageDone(page))
+      donePage = page;
+    else if (!flash_isErased(
+                 FMT_IMAGE_DOWNLOAD_ADDRESS + page * UPDATE_PAGE_SIZE,
+                 UPDATE_PAGE_SIZE))
+      erasedOrDone = false;
+  }
+
+  if (donePage < endPage && !erasedOrDone)
+  {
+    reclaimPage(donePage);
+    return false; // One PageStatus per call, like page writes.
+  }
+  if (erasedOrDone ||
+      fmt_flash_startErase(FMT_IMAGE_DOWNLOAD_ADDRESS + eraseOffset,
+                           FMT_FLASH_SECTOR_SIZE) < 0)
+  {
+    eraseOffset += FMT_FLASH_SECTOR_SIZE;
+    return true;
+  }
+  eraseState = ERASE_AHEAD_BUSY;
+  *eraseStarted = true;
+  return true;
+}
+
+/** Un-does a page so its sector can be erased, and asks for it again. */
+static void reclaimPage(uint32_t pageIndex)
+{
+  clearPageDone(pageIndex);
+  sendPageStatus(pageIndex, PageStatusEnum_REQUEST_RESEND, UINT32_MAX);
+}
+
+static pageBuf_t *findPageBuf(uint32_t pageIndex)
+{
+  for (uint32_t i = 0; i < UPDATE_WINDOW_PAGES; i++)
+  {
+    if (pagePool[i].state != PAGE_BUF_FREE &&
+        pagePool[i].pageIndex == pageIndex)
+      return &pagePool[i];
+  }
+  return NULL;
+}
+
+/** Returns NULL if all UPDATE_WINDOW_PAGES buffers are in use. */
+static pageBuf_t *claimPageBuf(ImageData *msg)
+{
+  for (uint32_t i = 0; i < UPDATE_WINDOW_PAGES; i++)
+  {
+    pageBuf_t *buf = &pagePool[i];
+    if (buf->state == PAGE_BUF_FREE)
+    {
+      buf->state = PAGE_BUF_FILLING;
+      buf->pageIndex = msg->pageIndex;
+      buf->chunkCount = msg->chunkCountInPage;
+      buf->chunksPending = (1U << msg->chunkCountInPage) - 1;
+      buf->packed = msg->packed;
+      buf->delta = msg->baseBuildId != 0;
+      buf->dataSize = UPDATE_PAGE_SIZE;
+      // The unsent tail of a short last page is written as erased flash.
+      memset(buf->data, 0xFF, UPDATE_PAGE_SIZE);
+      return buf;
+    }
+  }
+  return NULL;
+}
+
+/** Drops the page's partial data (sender must resend it all) and reports. */
+static void failPage(uint32_t pageIndex, pageBuf_t *buf)
+{
+  if (buf && buf->state == PAGE_BUF_FILLING)
+    buf->state = PAGE_BUF_FREE;
+  sendPageStatus(pageIndex, PageStatusEnum_WRITE_FAIL, 0);
+}
+
+static void requestResend(pageBuf_t *buf)
+{
+  sendPageStatus(buf->pageIndex, PageStatusEnum_REQUEST_RESEND,
+                 buf->chunksPending);
+}
+
+static void processChunk(ImageData *msg, pageBuf_t *buf)
+{
   // Signal this chunk has been processed by clearing the bit corresponding to
   // its chunkIndex.
-  chunksPending ^= (1 << msg->chunkIndex);
-
-  // Clear all b with position greater than the count of chunks expected.
-  chunksPending &= ((1 << msg->chunkCountInPage) - 1);
+  buf->chunksPending &= ~(1U << msg->chunkIndex);
+  if (msg->chunkIndex == buf->chunkCount - 1)
+    buf->dataSize =
+        msg->chunkIndex * DATA_MSG_PAYLOAD_SIZE_MAX + msg->payload.size;
 
   memcpy(
-      pageBuffer + msg->chunkIndex * DATA_MSG_PAYLOAD_SIZE_MAX,
+      buf->data + msg->chunkIndex * DATA_MSG_PAYLOAD_SIZE_MAX,
       msg->payload.bytes,
       msg->payload.size);
 }
 
-static void processPage(void)
+/** processPage
+ * Starts writing the page; onPageWritten() runs once it's programmed.
+ * Packed pages are unpacked into a single page of scratch RAM on their way to
+ * flash, which is all unpacking costs since pages are written one at a time.
+ * They must unpack to exactly UPDATE_PAGE_SIZE bytes.  Delta pages also copy
+ * from the running image, read in place.
+ * @returns false if the write couldn't be started.
+ */
+static bool processPage(pageBuf_t *buf)
 {
-
+  static uint8_t unpacked[UPDATE_PAGE_SIZE];
   uint32_t writeAddress =
-      FMT_IMAGE_DOWNLOAD_ADDRESS + (activePage * UPDATE_PAGE_SIZE);
+      FMT_IMAGE_DOWNLOAD_ADDRESS + (buf->pageIndex * UPDATE_PAGE_SIZE);
+  const uint8_t *pageData = buf->data;
+  const unpackBase_t activeImage = {
+      .address = FMT_IMAGE_ACTIVE_ADDRESS,
+      .size = FMT_IMAGE_DOWNLOAD_PARTITION_SIZE,
+      .offset = buf->pageIndex * UPDATE_PAGE_SIZE};
+
+  if (buf->packed)
+  {
+    int32_t unpackedSize =
+        fmt_unpack(buf->data, buf->dataSize, unpacked, UPDATE_PAGE_SIZE,
+                   buf->delta ? &activeImage : NULL);
+    if (unpackedSize != UPDATE_PAGE_SIZE)
+      return false;
+    pageData = unpacked;
+  }
 
-  fmt_flash_write(writeAddress, pageBuffer, UPDATE_PAGE_SIZE);
+  return fmt_flash_writeAsync(writeAddress, pageData, UPDATE_PAGE_SIZE,
+                              onPageWritten) == 0;
+}
+
+/** May run from the flash interrupt. */
+static void onPageWritten(int status)
+{
+  writeStatus = status;
+  writeFinished = true;
+}
+
+/** finishPageWrite
+ * Frees the buffer of the page written and acks it, unless the image changed.
+ * @returns false while the write is still in progress.
+ */
+static bool finishPageWrite(void)
+{
+  if (!writeFinished)
+    return false;
+
+  pageBuf_t *buf = writingBuf;
+  bool success = writeStatus == 0;
+  writingBuf = NULL;
+  writeFinished = false;
+  buf->state = PAGE_BUF_FREE;
+  if (!writingCurrentImage)
+    return true;
+
+  // should be after freeing the buffer; ungates new pages being sent.
+  sendPageStatus(buf->pageIndex,
+                 success ? PageStatusEnum_WRITE_SUCCESS
+                         : PageStatusEnum_WRITE_FAIL,
+                 0);
+  if (success)
+    markPageDone(buf->pageIndex);
+  return true;
+}
+
+static void markPageDone(uint32_t pageIndex)
+{
+  pageDone[pageIndex / 32] |= 1U << (pageIndex % 32);
+  pagesWritten++;
+  if (downloadCompleteCb && pagesWritten == pageCount)
+    downloadCompleteCb();
+}
+
+static void clearPageDone(uint32_t pageIndex)
+{
+  pageDone[pageIndex / 32] &= ~(1U << (pageIndex % 32));
+  pagesWritten--;
+}
+
+/** flashPageMatches
+ * Whether a page of the download partition holds data with the given CRC-32.
+ * Read in blocks to keep the stack small.
+ */
+static bool flashPageMatches(uint32_t pageIndex, uint32_t crc)
+{
+  uint8_t block[DATA_MSG_PAYLOAD_SIZE_MAX];
+  uint32_t address =
+      FMT_IMAGE_DOWNLOAD_ADDRESS + (pageIndex * UPDATE_PAGE_SIZE);
+  uint32_t pageCrc = 0xFFFFFFFF;
+
+  for (uint32_t offset = 0; offset < UPDATE_PAGE_SIZE; offset += sizeof(block))
+  {
+    uint32_t len = UPDATE_PAGE_SIZE - offset;
+    if (len > sizeof(block))
+      len = sizeof(block);
+    if (fmt_flash_read(address + offset, block, len) < 0)
+      return false;
+    pageCrc = crc32(pageCrc, block, len);
+  }
+  return ~pageCrc == crc;
+}
+
+/** crc32
+ * Bitwise CRC-32 (IEEE 802.3, reflected).  Start with crc = 0xFFFFFFFF and
+ * invert the result.  The CRC engine of fmt_crc.h is left to fmt_comms.
+ */
+static uint32_t crc32(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return crc;
 }
 
 #endif // FMT_UPDATE_SUPPORTED
@@ -3,6 +3,7 @@
  * Provides address where new images should be written (so BL will see them).
  *   This comes from CMake, as it is shared understanding with the bootloader.
  */
+#pragma once
 
 #include "messages.pb.h"
 #include <stdint.h>
@@ -11,10 +12,15 @@
 #define FMT_UPDATE_SUPPORTED @UPDATE_SUPPORTED@
 #define FMT_IMAGE_DOWNLOAD_ADDRESS @PARTITION_UPDATE_ADDRESS@
 #define FMT_IMAGE_DOWNLOAD_PARTITION_SIZE @PARTITION_SIZE@
+// The running image: the base of delta updates.  Same size as the download.
+#define FMT_IMAGE_ACTIVE_ADDRESS @PARTITION_ACTIVE_ADDRESS_CACHED@
+// Erase-block size, which the download partition is aligned to.
+#define FMT_FLASH_SECTOR_SIZE @SECTOR_SIZE@
 
 // Source: firment_msg_config.json  "data-msg-payload-size-max"
 #define DATA_MSG_PAYLOAD_SIZE_MAX @DATA_MSG_PAYLOAD_SIZE_MAX@
 #define UPDATE_PAGE_SIZE @UPDATE_PAGE_SIZE@
+#define UPDATE_WINDOW_PAGES @UPDATE_WINDOW_PAGES@
 
 typedef void (*callback_t)(void);
 
@@ -32,3 +38,23 @@ void fmt_setDownloadFinishCallback(callback_t onDownloadComplete);
 
 #define USE_ImageData
 bool handleImageData(ImageData msg);
+
+/** handlePageCrcs
+ * Compares the CRCs of an image's pages with those already in the download
+ * partition and answers with PagesPresent.  Matching pages count as written,
+ * so a download interrupted by a disconnect or reboot can resume.  An image is
+ * known by its page count and imageId: a change to either starts a new one.
+ */
+#define USE_PageCrcs
+void handlePageCrcs(PageCrcs msg);
+
+/** fmt_handleUpdate
+ * Writes one page that handleImageData() has completed, if any, to the download
+ * partition and acks it with PageStatus once it's programmed, which a later
+ * call may find.  Up to UPDATE_WINDOW_PAGES pages can be buffered, so chunks of
+ * the following pages keep arriving meanwhile.
+ * Once an image's first chunk arrives, the sectors it will occupy are erased
+ * ahead of the writes, in the background where the flash allows it.
+ * Call periodically from the context that calls fmt_handleRx().
+ */
+void fmt_handleUpdate(void);
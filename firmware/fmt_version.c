@@ -9,6 +9,11 @@ void fmt_setBuildIdGetter(uint32_t (*getter)(void))
   buildIdGetter = getter;
 }
 
+uint32_t fmt_getBuildId(void)
+{
+  return buildIdGetter ? buildIdGetter() : 0;
+}
+
 bool fmt_sendVersion(void)
 {
   static uint32_t callCount = 0;
@@ -29,8 +34,7 @@ bool fmt_sendVersion(void)
           },
       },
   };
-  if (buildIdGetter)
-    msg.sub.Version.buildId = buildIdGetter();
+  msg.sub.Version.buildId = fmt_getBuildId();
 
   return fmt_sendMsg(msg);
 }
\ No newline at end of file
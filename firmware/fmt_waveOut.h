@@ -0,0 +1,40 @@
+/**
+ * @file fmt_waveOut.h
+ * @brief Streams samples to a timer's compare register by DMA, one sample per
+ * timer period (PWM output, or a DAC/RC filter fed from the PWM pin).
+ *
+ * The DMA runs circularly over a buffer of 2 * blockLen samples.  Each time
+ * one half has been sent, fill() is called from the DMA ISR to regenerate that
+ * half while the other half plays.  The CPU is interrupted once per block
+ * instead of once per sample, which is what makes ~100kHz output rates cheap.
+ *
+ * Typical use with fmt_waveform.h:
+ *   static void fillA(int16_t *block, uint32_t len) {
+ *     wave_fillBlock(0, block, len);
+ *   }
+ *   wave_initAll(1e6F / intervalUs);
+ *   fmt_initWaveOut(intervalUs, priority, buffer, BLOCK_LEN, fillA);
+ * with the wave's offset, amplitude and limits in compare ticks, between 0
+ * and fmt_getWaveOutFullScale().
+ *
+ * Resources (timer, channel, pin, DMA channel) come from timer_pcbDetails.h,
+ * which must define FMT_USES_WAVE_OUT.
+ */
+
+#ifndef fmt_waveOut_h
+#define fmt_waveOut_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void (*blockCallback_t)(int16_t *block, uint32_t len);
+
+/** Start output.  buffer must hold 2 * blockLen samples and outlive the
+ * output.  Both halves are filled before the timer starts. */
+bool fmt_initWaveOut(uint32_t intervalUs, uint32_t priority,
+                     int16_t *buffer, uint32_t blockLen, blockCallback_t fill);
+
+/** Compare ticks per sample period: a sample of this value is 100% duty. */
+uint32_t fmt_getWaveOutFullScale(void);
+
+#endif // fmt_waveOut_h
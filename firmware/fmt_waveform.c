@@ -1,17 +1,49 @@
 #include "fmt_waveform.h"
 #include <fmt_waveform_cfg.h>
+#include <fmt_log.h>
+#include <fmt_profile.h>
 #include <math.h>
 
 #define TWO_PI 6.283185307F
-#define PI 3.141592654F
+
+#ifndef WAVE_SINE_LUT_BITS
+#define WAVE_SINE_LUT_BITS 8
+#endif
+#if WAVE_SINE_LUT_BITS < 2 || WAVE_SINE_LUT_BITS > 12
+#error WAVE_SINE_LUT_BITS must be between 2 and 12
+#endif
+
+#define SINE_LUT_LEN (1U << WAVE_SINE_LUT_BITS)
+// Low phase bits below the LUT index, used to interpolate between entries.
+#define FRAC_BITS (32U - WAVE_SINE_LUT_BITS)
+#define FRAC_MASK ((1UL << FRAC_BITS) - 1U)
+#define FRAC_SCALE (1.0F / (float)(1UL << FRAC_BITS))
+
+#ifndef WAVE_TABLE_MAX_LEN
+#define WAVE_TABLE_MAX_LEN 256
+#endif
+
+#define PHASE_HALF 0x80000000UL
+#define PHASE_PER_CYCLE 4294967296.0F
+#define PHASE_PER_RAD (PHASE_PER_CYCLE / TWO_PI)
 
 static wave_t *waves[MAX_NUM_WAVES];
 static uint32_t numWaves = 0;
-static float updatePeriodSec = 0;
+static float phasePerHz = 0;
+
+// One extra entry so interpolation at the last index needn't wrap.
+static float sineLut[SINE_LUT_LEN + 1];
+
+static int16_t uploadedTable[WAVE_TABLE_MAX_LEN];
+static uint32_t uploadedLen = 0;
+static uint32_t nextChunk = 0;
 
 void wave_initAll(float updateFrequencyHz)
 {
-  updatePeriodSec = 1.0F / updateFrequencyHz;
+  phasePerHz = PHASE_PER_CYCLE / updateFrequencyHz;
+
+  for (uint32_t i = 0; i <= SINE_LUT_LEN; i++)
+    sineLut[i] = sinf(TWO_PI * (float)i / (float)SINE_LUT_LEN);
 }
 
 bool wave_add(wave_t *wave)
@@ -29,7 +61,9 @@ bool wave_add(wave_t *wave)
 void wave_setFrequency(uint32_t waveId, float frequencyHz)
 {
   if (waveId < numWaves)
-    waves[waveId]->deltaPhasePerUpdate = updatePeriodSec * TWO_PI * frequencyHz;
+    // via int64 so negative frequencies wrap to a backwards-running phase.
+    waves[waveId]->deltaPhasePerUpdate =
+        (uint32_t)(int64_t)(phasePerHz * frequencyHz);
 }
 void wave_setShape(uint32_t waveId, waveShape_t shape)
 {
@@ -55,23 +89,122 @@ void wave_setLimits(uint32_t waveId, float min, float max)
   }
 }
 
-void wave_setPhase(wave_t *wave, float phaseRad)
+bool wave_setTable(uint32_t waveId, const int16_t *table, uint32_t len)
+{
+  if (waveId >= numWaves || (len && !table))
+    return false;
+  waves[waveId]->table = table;
+  waves[waveId]->tableLen = len;
+  return true;
+}
+
+bool wave_setHarmonics(
+    uint32_t waveId, const waveHarmonic_t *harmonics, uint32_t count)
 {
-  // limits the phase to [0-2*pi] so that phase resolution isn't lost and LUT
-  // module doesn't burn CPU cycles enforcing in-bounds access.
+  if (waveId >= numWaves || (count && !harmonics))
+    return false;
+  waves[waveId]->harmonics = harmonics;
+  waves[waveId]->numHarmonics = count;
+  return true;
+}
 
-  // First, let's try the CPU-inexpensive way that will work for most cases.
-  if (phaseRad > TWO_PI)
+void handleWaveTable(WaveTable msg)
+{
+  if (msg.chunkIndex == 0)
+  {
+    uploadedLen = 0;
+    nextChunk = 0;
+  }
+  uint32_t count = msg.payload.size / 2U;
+  if (msg.chunkIndex != nextChunk || (msg.payload.size % 2U) ||
+      uploadedLen + count > WAVE_TABLE_MAX_LEN)
   {
-    phaseRad -= TWO_PI;
+    fmt_sendLog(LOG_WARN, "wave table: rejected chunk ", msg.chunkIndex);
+    nextChunk = UINT32_MAX; // Ignore the rest, until a new chunk 0.
+    return;
   }
-  // Just subtracting 2Pi wasn't enough.  Do something more robust.
-  if (phaseRad < 0.0F || phaseRad > TWO_PI)
+
+  const uint8_t *bytes = msg.payload.bytes;
+  for (uint32_t i = 0; i < count; i++)
+    uploadedTable[uploadedLen + i] =
+        (int16_t)(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+  uploadedLen += count;
+  nextChunk++;
+
+  if (nextChunk == msg.chunkCount)
   {
-    // neg. example: floor(-7/(2pi)) = -2.  -7 - (-2 * 2pi) ~ 5.57. (in range)
-    phaseRad -= floorf(phaseRad / TWO_PI) * TWO_PI;
+    if (wave_setTable(msg.waveId, uploadedTable, uploadedLen))
+      fmt_sendLog(LOG_INFO, "wave table: samples loaded ", uploadedLen);
+    else
+      fmt_sendLog(LOG_WARN, "wave table: bad waveId ", msg.waveId);
   }
-  wave->phase = phaseRad;
+}
+
+void wave_setPhase(wave_t *wave, float phaseRad)
+{
+  // Wrap to one period first so the conversion to phase counts can't overflow.
+  phaseRad -= floorf(phaseRad / TWO_PI) * TWO_PI;
+  wave->phase = (uint32_t)(int64_t)(phaseRad * PHASE_PER_RAD);
+}
+
+static inline float sineFromPhase(uint32_t phase)
+{
+  uint32_t index = phase >> FRAC_BITS;
+  float frac = (float)(phase & FRAC_MASK) * FRAC_SCALE;
+  float lower = sineLut[index];
+  return lower + (sineLut[index + 1] - lower) * frac;
+}
+
+// -1 at phase 0, rising to +1 at the end of the period.
+static inline float sawtoothFromPhase(uint32_t phase)
+{
+  return (float)(int32_t)(phase - PHASE_HALF) * (1.0F / PHASE_HALF);
+}
+
+static inline float squareFromPhase(uint32_t phase)
+{
+  return phase > PHASE_HALF ? 1.0F : -1.0F;
+}
+
+// Position in the table is phase * len / 2^32; its low word is the fraction.
+static inline float tableFromPhase(
+    const int16_t *table, uint32_t len, uint32_t phase)
+{
+  uint64_t position = (uint64_t)phase * len;
+  uint32_t index = (uint32_t)(position >> 32);
+  uint32_t next = (index + 1U == len) ? 0 : index + 1U;
+  float frac = (float)(uint32_t)position * (1.0F / PHASE_PER_CYCLE);
+  float lower = table[index];
+  return (lower + ((float)table[next] - lower) * frac) * (1.0F / 32768.0F);
+}
+
+// Integer multiplication of the phase wraps each tone to its own period.
+static inline float harmonicsFromPhase(
+    const waveHarmonic_t *harmonics, uint32_t count, uint32_t phase)
+{
+  float sum = 0.0F;
+  for (uint32_t i = 0; i < count; i++)
+    sum += harmonics[i].amplitude *
+           sineFromPhase(phase * harmonics[i].multiple + harmonics[i].phase);
+  return sum;
+}
+
+static inline float clampToLimits(const wave_t *wave, float value)
+{
+  if (value > wave->max)
+    value = wave->max;
+  if (value < wave->min)
+    value = wave->min;
+  return value;
+}
+
+static inline int16_t toSample(float value)
+{
+  if (value >= 32767.0F)
+    return INT16_MAX;
+  if (value <= -32768.0F)
+    return INT16_MIN;
+  return (int16_t)(value >= 0.0F ? value + 0.5F : value - 0.5F);
 }
 
 float wave_getValue(wave_t *wave)
@@ -80,38 +213,103 @@ float wave_getValue(wave_t *wave)
   switch (wave->shape)
   {
   case WAVE_SHAPE_SAWTOOTH:
-    acPart = wave->amplitude * (wave->phase - PI) / PI;
+    acPart = wave->amplitude * sawtoothFromPhase(wave->phase);
     break;
   case WAVE_SHAPE_SQUARE:
-    acPart = wave->amplitude * (wave->phase > PI ? 1.0F : -1.0F);
+    acPart = wave->amplitude * squareFromPhase(wave->phase);
     break;
   case WAVE_SHAPE_SINE:
-    acPart = wave->amplitude * sinf(wave->phase);
+    acPart = wave->amplitude * sineFromPhase(wave->phase);
+    break;
+  case WAVE_SHAPE_ARBITRARY:
+    if (wave->tableLen)
+      acPart = wave->amplitude *
+               tableFromPhase(wave->table, wave->tableLen, wave->phase);
+    break;
+  case WAVE_SHAPE_HARMONICS:
+    acPart = wave->amplitude *
+             harmonicsFromPhase(wave->harmonics, wave->numHarmonics, wave->phase);
     break;
   case WAVE_SHAPE_DC:
   default:
     // Leave acPart == 0.
     break;
   }
-  float value = wave->offset + acPart;
+  return clampToLimits(wave, wave->offset + acPart);
+}
 
-  // clamp value to range
-  if (value > wave->max)
-    value = wave->max;
-  if (value < wave->min)
-    value = wave->min;
+/* The shape switch is hoisted out of the sample loop so each loop body is
+ * straight-line code with locals in registers. */
+#define FILL_LOOP(acExpr)                                   \
+  for (uint32_t i = 0; i < n; i++)                          \
+  {                                                         \
+    float value = offset + amplitude * (acExpr);            \
+    buf[i] = toSample(clampToLimits(wave, value));          \
+    phase += delta;                                         \
+  }
 
-  return value;
+uint32_t wave_fillBlock(uint32_t waveId, int16_t *buf, uint32_t n)
+{
+  if (waveId >= numWaves)
+    return 0;
+
+  wave_t *wave = waves[waveId];
+  uint32_t phase = wave->phase;
+  const uint32_t delta = wave->deltaPhasePerUpdate;
+  const float offset = wave->offset;
+  const float amplitude = wave->amplitude;
+
+  switch (wave->shape)
+  {
+  case WAVE_SHAPE_SAWTOOTH:
+    FILL_LOOP(sawtoothFromPhase(phase))
+    break;
+  case WAVE_SHAPE_SQUARE:
+    FILL_LOOP(squareFromPhase(phase))
+    break;
+  case WAVE_SHAPE_SINE:
+    FILL_LOOP(sineFromPhase(phase))
+    break;
+  case WAVE_SHAPE_ARBITRARY:
+  {
+    const int16_t *table = wave->table;
+    const uint32_t len = wave->tableLen;
+    if (len)
+    {
+      FILL_LOOP(tableFromPhase(table, len, phase))
+    }
+    else
+    {
+      FILL_LOOP(0.0F)
+    }
+    break;
+  }
+  case WAVE_SHAPE_HARMONICS:
+  {
+    const waveHarmonic_t *harmonics = wave->harmonics;
+    const uint32_t count = wave->numHarmonics;
+    FILL_LOOP(harmonicsFromPhase(harmonics, count, phase))
+    break;
+  }
+  case WAVE_SHAPE_DC:
+  default:
+    FILL_LOOP(0.0F)
+    break;
+  }
+  wave->phase = phase;
+  return n;
 }
 
 void wave_updateAll(void)
 {
+  uint32_t begin = fmt_profile_begin();
   // Iterate through intialized waves.
   // Just updates the phase.  The calculation of the value is left to get().
-  // Calculate the phase change for this update period
+  // Unsigned overflow wraps the phase to the next period for free.
   for (int waveId = 0; waveId < numWaves; waveId++)
   {
     wave_t *wave = waves[waveId];
-    wave_setPhase(wave, wave->phase + wave->deltaPhasePerUpdate);
+    wave->phase += wave->deltaPhasePerUpdate;
   }
+  fmt_profile_end(FMT_PROFILE_WAVEFORM, begin);
 }
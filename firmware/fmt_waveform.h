@@ -3,6 +3,9 @@
  * Requires a periodic calling function. 
  */
 
+#pragma once
+#include <messages.pb.h> // WaveTable
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -11,15 +14,29 @@ typedef enum {
   WAVE_SHAPE_SQUARE,
   WAVE_SHAPE_SINE,
   WAVE_SHAPE_SAWTOOTH,
+  WAVE_SHAPE_ARBITRARY, // plays wave_t.table
+  WAVE_SHAPE_HARMONICS, // sums the tones in wave_t.harmonics
 } waveShape_t;
 
 typedef struct {
-  float phase;
+  uint32_t multiple; // of the wave's frequency; 1 is the fundamental.
+  float amplitude;   // relative to the wave's amplitude.
+  uint32_t phase;    // offset, in the same units as wave_t.phase.
+} waveHarmonic_t;
+
+/** Phase is a 32-bit fraction of a period: 0 to 2^32 maps to [0, 2*pi).
+ * The accumulator wraps naturally, so phase never loses resolution. */
+typedef struct {
+  uint32_t phase;
   float offset;
   float amplitude;
   float max, min;
-  float deltaPhasePerUpdate;
+  uint32_t deltaPhasePerUpdate;
   waveShape_t shape;
+  const int16_t *table; // One period of Q15 samples, any length.
+  uint32_t tableLen;
+  const waveHarmonic_t *harmonics;
+  uint32_t numHarmonics;
 } wave_t;
 
 
@@ -35,8 +52,34 @@ float wave_getValue(wave_t *wave);
 /** A periodic that should be called at updateFrequencyHz */
 void wave_updateAll(void);
 
+/** Generates the next n samples of a wave into buf, one update period apart,
+ * and advances the wave's phase past them.  Samples are the wave's value
+ * rounded to int16, so set offset, amplitude and limits in output counts
+ * (e.g. DAC codes or timer compare ticks).
+ * A wave filled this way should not also be advanced by wave_updateAll().
+ * @return number of samples written: n, or 0 if waveId is invalid. */
+uint32_t wave_fillBlock(uint32_t waveId, int16_t *buf, uint32_t n);
+
 void wave_setFrequency(uint32_t waveId, float frequencyHz);
 void wave_setShape(uint32_t waveId, waveShape_t shape);
 void wave_setOffset(uint32_t waveId, float dcOffset);
 void wave_setAmplitude(uint32_t waveId, float amplitude);
 void wave_setLimits(uint32_t waveId, float min, float max);
+
+/** Attach the sample table played by WAVE_SHAPE_ARBITRARY.  The table holds
+ * one period in Q15 (32767 ~ +1.0 * amplitude) and must outlive its use.
+ * Playback steps through it by fractional positions, interpolating linearly. */
+bool wave_setTable(uint32_t waveId, const int16_t *table, uint32_t len);
+
+/** Attach the tones summed by WAVE_SHAPE_HARMONICS.  Each costs one sine LUT
+ * lookup per sample.  The array must outlive its use. */
+bool wave_setHarmonics(
+    uint32_t waveId, const waveHarmonic_t *harmonics, uint32_t count);
+
+/** Called by generated fmt_rx.pb.c (see fmt_rx.in.c).
+ * Collects an uploaded table (little-endian Q15 samples, chunks in order) and
+ * attaches it to msg.waveId once the last chunk arrives.  There is one upload
+ * buffer of WAVE_TABLE_MAX_LEN samples: waves playing it will glitch while a
+ * new table is uploaded. */
+#define USE_WaveTable
+void handleWaveTable(WaveTable msg);
@@ -1 +1,6 @@
-#define MAX_NUM_WAVES 8
\ No newline at end of file
+#define MAX_NUM_WAVES 8
+// The sine LUT has 2^WAVE_SINE_LUT_BITS entries (+1 for interpolation).
+#define WAVE_SINE_LUT_BITS 8
+
+// Samples in the buffer that receives WaveTable uploads.
+#define WAVE_TABLE_MAX_LEN 256
@@ -1,19 +1,82 @@
 #include "ghostProbe.h"
 #include "fmt_comms.h"
+#include "fmt_log.h"
+#include "fmt_profile.h"
+#include "fmt_sizes.h"
 
-// NUM_PROBES must match number of probe_x fields in RunScanCtl.
-// See firment_msg.in.proto.
-#define NUM_PROBES 5
+/* Probe counts come from PROBE_MAX_COUNT and PROBE_SIGNAL_MAX_COUNT in
+firmentConfig.cmake via the nanopb max_count of the repeated fields. */
+#define MAX_PROBES \
+  (sizeof(((RunScanCtl *)0)->probes) / sizeof(TestPointId))
+#define SIGNALS_PER_MSG \
+  (sizeof(((ProbeSignals *)0)->probeSignals) / sizeof(ProbeSignal))
+
+// Top adds a 1B tag and 1B length around each sub-message.
+#define TOP_OVERHEAD_BYTES 2U
+#if RunScanCtl_size + TOP_OVERHEAD_BYTES > MAX_MESSAGE_SIZE_BYTES
+#error "RunScanCtl too big for a packet. Reduce PROBE_MAX_COUNT."
+#endif
+#if ProbeSignals_size + TOP_OVERHEAD_BYTES > MAX_MESSAGE_SIZE_BYTES
+#error "ProbeSignals too big for a packet. Reduce PROBE_SIGNAL_MAX_COUNT."
+#endif
+#if RunAddrScan_size + TOP_OVERHEAD_BYTES > MAX_MESSAGE_SIZE_BYTES
+#error "RunAddrScan too big for a packet. Reduce ADDR_PROBE_MAX_COUNT."
+#endif
+
+/* The window of RAM that address probes may read.  Defined by the project's
+linker script; weak so projects (and host tests) that don't define them get an
+empty window, which rejects every address. */
+extern const uint8_t __fmt_probe_ram_start[] __attribute__((weak));
+extern const uint8_t __fmt_probe_ram_end[] __attribute__((weak));
 
 static testPoint_t testPoints[_TestPointId_ARRAYSIZE];
 
-static TestPointId activeTestPoints[NUM_PROBES];
+/** An active probe is a test point resolved (once, at scan start) to the
+ * function that reads and converts it, so sampling needs no type dispatch. */
+typedef struct _activeProbe {
+  converter_t read;
+  volatile void *src;
+  TestPointId id;
+} activeProbe_t;
+
+static activeProbe_t activeProbes[MAX_PROBES];
 static volatile bool running = false;
 static uint32_t numActiveProbes = 0;
 static uint32_t scanFreqDivider = 0;
 static uint32_t periodicFreqHz = 0;
 
-static ProbeSignal readTestPoint(TestPointId testPoint);
+static float readFloat(volatile void *src) { return *(volatile float *)src; }
+static float readInt8(volatile void *src) { return *(volatile int8_t *)src; }
+static float readInt16(volatile void *src) { return *(volatile int16_t *)src; }
+static float readInt32(volatile void *src) { return *(volatile int32_t *)src; }
+static float readUint8(volatile void *src) { return *(volatile uint8_t *)src; }
+static float readUint16(volatile void *src) { return *(volatile uint16_t *)src; }
+static float readUint32(volatile void *src) { return *(volatile uint32_t *)src; }
+
+static const converter_t readers[] = {
+    [SRC_TYPE_FLOAT] = readFloat,
+    [SRC_TYPE_INT8] = readInt8,
+    [SRC_TYPE_INT16] = readInt16,
+    [SRC_TYPE_INT32] = readInt32,
+    [SRC_TYPE_UINT8] = readUint8,
+    [SRC_TYPE_UINT16] = readUint16,
+    [SRC_TYPE_UINT32] = readUint32,
+};
+#define NUM_READERS (sizeof(readers) / sizeof(converter_t))
+
+static const uint8_t srcTypeSize[] = {
+    [SRC_TYPE_FLOAT] = sizeof(float),
+    [SRC_TYPE_INT8] = sizeof(int8_t),
+    [SRC_TYPE_INT16] = sizeof(int16_t),
+    [SRC_TYPE_INT32] = sizeof(int32_t),
+    [SRC_TYPE_UINT8] = sizeof(uint8_t),
+    [SRC_TYPE_UINT16] = sizeof(uint16_t),
+    [SRC_TYPE_UINT32] = sizeof(uint32_t),
+};
+
+static void startScan(SampleFreq freq);
+static bool resolveProbe(TestPointId id, activeProbe_t *probe);
+static bool addressProbeable(uint32_t address, srcType_t type);
 
 void gp_init(uint32_t periodicCallFrequencyHz)
 {
@@ -22,7 +85,7 @@ void gp_init(uint32_t periodicCallFrequencyHz)
 
 bool gp_initTestPoint(TestPointId id, volatile void *src, srcType_t type, converter_t converterFn)
 {
-  if (id < _TestPointId_ARRAYSIZE)
+  if (id < _TestPointId_ARRAYSIZE && type < NUM_READERS)
   {
     testPoints[id] = (const testPoint_t){.src = src, .type = type, .converter = converterFn};
     return true;
@@ -37,79 +100,134 @@ void handleRunScanCtl(RunScanCtl scanCtl)
 
   if (scanCtl.freq > SampleFreq_SCAN_DISABLED)
   {
-    /* Integer division.  If scanFreqDivider set to 0, periodic will send signals
-    on ever call, same as if scanFreqDivider == 1. */
-    scanFreqDivider = periodicFreqHz / scanCtl.freq;
-
     numActiveProbes = 0;
-    TestPointId *ids = &(scanCtl.probe_0);
-    for (unsigned i = 0; i < NUM_PROBES; i++)
+    for (unsigned i = 0; i < scanCtl.probes_count; i++)
     {
-      TestPointId thisId = ids[i];
-      if (thisId != TestPointId_DISCONNECTED)
+      if (resolveProbe(scanCtl.probes[i], &activeProbes[numActiveProbes]))
       {
-        activeTestPoints[numActiveProbes] = thisId;
         numActiveProbes++;
       }
     }
-    running = true;
+    startScan(scanCtl.freq);
+  }
+}
+
+void handleRunAddrScan(RunAddrScan scanCtl)
+{
+  // Stop running first so we don't race gp_periodic().
+  running = false;
+
+  if (scanCtl.freq > SampleFreq_SCAN_DISABLED)
+  {
+    uint32_t count = scanCtl.addresses_count;
+    if (count != scanCtl.types_count)
+    {
+      fmt_sendLog(LOG_WARN, "addr scan: types count mismatch ", count);
+      return;
+    }
+
+    /* All or nothing: the UI matches signals to symbols by position, so
+    silently dropping one address would mislabel every trace after it. */
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (!addressProbeable(scanCtl.addresses[i], (srcType_t)scanCtl.types[i]))
+      {
+        fmt_sendLog(LOG_WARN, "addr scan: rejected index ", i);
+        return;
+      }
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+      activeProbes[i] = (activeProbe_t){
+          .read = readers[scanCtl.types[i]],
+          .src = (volatile void *)(uintptr_t)scanCtl.addresses[i],
+          .id = TestPointId_DISCONNECTED,
+      };
+    }
+    numActiveProbes = count;
+    startScan(scanCtl.freq);
   }
 }
 
 void gp_periodic(void)
 {
+  uint32_t begin = fmt_profile_begin();
   static uint_fast32_t callCount = 0;
   if (running && (++callCount >= scanFreqDivider))
   {
     callCount = 0;
-    ProbeSignals signals = {.probeSignals_count = numActiveProbes};
-    for (unsigned i = 0; i < numActiveProbes; i++)
+
+    // Signals of one sample are split across as many messages as needed.
+    uint32_t first = 0;
+    do
     {
-      signals.probeSignals[i] = readTestPoint(activeTestPoints[i]);
-    }
-    fmt_sendMsg((const Top){
-        .which_sub = Top_ProbeSignals_tag,
-        .sub = {
-            .ProbeSignals = signals}});
+      uint32_t count = numActiveProbes - first;
+      if (count > SIGNALS_PER_MSG)
+        count = SIGNALS_PER_MSG;
+
+      ProbeSignals signals = {
+          .probeSignals_count = count,
+          .remaining = numActiveProbes - first - count,
+          .first = first};
+      const activeProbe_t *probe = &activeProbes[first];
+      for (unsigned i = 0; i < count; i++, probe++)
+      {
+        signals.probeSignals[i].id = probe->id;
+        signals.probeSignals[i].value = probe->read(probe->src);
+      }
+      fmt_sendMsg((const Top){
+          .which_sub = Top_ProbeSignals_tag,
+          .sub = {
+              .ProbeSignals = signals}});
+      first += count;
+    } while (first < numActiveProbes);
   }
+  fmt_profile_end(FMT_PROFILE_GHOST_PROBE, begin);
 }
 
-static ProbeSignal readTestPoint(TestPointId id)
+static void startScan(SampleFreq freq)
 {
-  ProbeSignal signal;
-  signal.id = id;
-  testPoint_t pad = testPoints[id];
+  /* Integer division.  If scanFreqDivider set to 0, periodic will send signals
+  on ever call, same as if scanFreqDivider == 1. */
+  scanFreqDivider = periodicFreqHz / freq;
+  running = true;
+}
 
-  if (pad.converter)
-  {
-    signal.value = pad.converter(pad.src);
-  }
-  else
-  {
-    switch (pad.type)
-    {
-    case SRC_TYPE_FLOAT:
-      signal.value = *(float *)pad.src;
-      break;
-    case SRC_TYPE_INT8:
-      signal.value = *(int8_t *)pad.src;
-      break;
-    case SRC_TYPE_INT16:
-      signal.value = *(int16_t *)pad.src;
-      break;
-    case SRC_TYPE_INT32:
-      signal.value = *(int32_t *)pad.src;
-      break;
-    case SRC_TYPE_UINT8:
-      signal.value = *(uint8_t *)pad.src;
-      break;
-    case SRC_TYPE_UINT16:
-      signal.value = *(uint16_t *)pad.src;
-      break;
-    case SRC_TYPE_UINT32:
-      signal.value = *(uint32_t *)pad.src;
-      break;
-    }
-  }
-  return signal;
-}
\ No newline at end of file
+/** Looks up the test point and picks its reader: the custom converter if one
+ * was registered, otherwise the plain load-and-convert for its srcType.
+ * @returns false for disconnected, out-of-range, or unregistered test points.
+ */
+static bool resolveProbe(TestPointId id, activeProbe_t *probe)
+{
+  if (id == TestPointId_DISCONNECTED || id >= _TestPointId_ARRAYSIZE)
+    return false;
+
+  const testPoint_t *pad = &testPoints[id];
+  if (pad->src == NULL)
+    return false;
+
+  *probe = (activeProbe_t){
+      .read = pad->converter ? pad->converter : readers[pad->type],
+      .src = pad->src,
+      .id = id,
+  };
+  return true;
+}
+
+/** An address is probeable if the whole (naturally aligned) value lies within
+ * the linker-provided RAM window.
+ */
+static bool addressProbeable(uint32_t address, srcType_t type)
+{
+  if (type >= NUM_READERS)
+    return false;
+
+  uint32_t size = srcTypeSize[type];
+  uint32_t start = (uint32_t)(uintptr_t)__fmt_probe_ram_start;
+  uint32_t end = (uint32_t)(uintptr_t)__fmt_probe_ram_end;
+
+  bool aligned = (address % size) == 0;
+  bool inWindow = address >= start && address < end && (end - address) >= size;
+  return aligned && inWindow;
+}
@@ -10,6 +10,7 @@
  * The analogy is to a PCB with physical probe pads.  There can be many pads,
  * that you switch your probes between at run-time.
  */
+// Values match ProbeSrcType in firment_msg.in.proto (used by RunAddrScan).
 typedef enum _srcType {
   SRC_TYPE_FLOAT,
   SRC_TYPE_INT8,
@@ -20,6 +21,8 @@ typedef enum _srcType {
   SRC_TYPE_UINT32,
 } srcType_t;
 
+/** Reads a test point's source and returns it as a float.  A converter given
+ * to gp_initTestPoint() replaces the built-in reader for the srcType_t. */
 typedef float (*converter_t)(volatile void *rawValue);
 
 typedef struct _testPoint {
@@ -41,6 +44,14 @@ bool gp_initTestPoint(TestPointId id, volatile void *src, srcType_t type, conver
 #define USE_RunScanCtl
 void handleRunScanCtl(RunScanCtl scanCtl);
 
+/** Like handleRunScanCtl(), but probes raw RAM addresses rather than test
+ * points.  Each address must lie in the window the project's linker script
+ * defines with __fmt_probe_ram_start and __fmt_probe_ram_end.  If any address
+ * is rejected, a warning is logged and no scan runs.
+ */
+#define USE_RunAddrScan
+void handleRunAddrScan(RunAddrScan scanCtl);
+
 void gp_periodic(void);
 
 #endif // ghostProbe_H
\ No newline at end of file
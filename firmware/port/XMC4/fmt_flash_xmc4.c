@@ -37,16 +37,31 @@ const uint32_t sector_base[FLASH_SECTOR_COUNT + 1] = {
     FLASH_TOP
 };
 
+/** The write in progress, a page per fmt_flash_pollWrite() that finds the
+ * flash idle. */
+static struct {
+  bool active;
+  uint32_t page_adr;
+  uint32_t address;
+  const uint8_t *data;
+  uint32_t len;
+  fmt_flash_callback_t cb;
+} asyncWrite;
+
 static int getSectorContainingAddress(uint32_t address);
 static int flash_erase(uint32_t start_address, uint32_t len);
+static void startAsyncPage(void);
 
 
 int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len)
 {
   uint8_t page_buffer[WRITE_BLOCK_SIZE] __attribute__((aligned(4)));
 
+  while (fmt_flash_pollWrite() > 0)
+    ;
   if (!flash_isErased(address, len))
     flash_erase(address, len);
+  flash_markWritten(address, len);
   
   /* Find the closest page-aligned address preceeding first address to write*/
   uint32_t page_adr = getPreceedingWriteBoundary(address);
@@ -86,6 +101,66 @@ int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len)
   return 0;
 }
 
+int fmt_flash_writeAsync(uint32_t address, const uint8_t *data, uint32_t len,
+                         fmt_flash_callback_t cb)
+{
+  if (asyncWrite.active || len == 0)
+    return -1;
+
+  if (!flash_isErased(address, len))
+    flash_erase(address, len);
+  flash_markWritten(address, len);
+
+  asyncWrite.active = true;
+  asyncWrite.page_adr = getPreceedingWriteBoundary(address);
+  asyncWrite.address = address;
+  asyncWrite.data = data;
+  asyncWrite.len = len;
+  asyncWrite.cb = cb;
+  startAsyncPage();
+  return 0;
+}
+
+int fmt_flash_pollWrite(void)
+{
+  if (!asyncWrite.active)
+    return 0;
+  if (XMC_FLASH_IsBusy())
+    return 1;
+
+  asyncWrite.page_adr += WRITE_BLOCK_SIZE;
+  if (asyncWrite.page_adr < asyncWrite.address + asyncWrite.len) {
+    startAsyncPage();
+    return 1;
+  }
+  asyncWrite.active = false;
+  if (asyncWrite.cb)
+    asyncWrite.cb(0);
+  return 0;
+}
+
+/** Like XMC_FLASH_ProgramPage(), without waiting for the page to program. */
+static void startAsyncPage(void)
+{
+  static uint32_t page_buffer[WRITE_BLOCK_SIZE / 4];
+
+  flash_fillWriteBlock((uint8_t *)page_buffer, asyncWrite.page_adr,
+                       asyncWrite.address, asyncWrite.data, asyncWrite.len);
+  XMC_FLASH_EnterPageMode();
+  XMC_FLASH_LoadPage(page_buffer);
+  XMC_FLASH_WritePage((uint32_t *)asyncWrite.page_adr);
+}
+
+int fmt_flash_startErase(uint32_t address, uint32_t len)
+{
+  return flash_erase(address, len);
+}
+
+int fmt_flash_pollErase(void)
+{
+  return 0;
+}
+
 static int flash_erase(uint32_t start_address, uint32_t len)
 {
   if (len == 0) {
@@ -104,6 +179,8 @@ static int flash_erase(uint32_t start_address, uint32_t len)
   {
     XMC_FLASH_EraseSector((uint32_t*)sector_base[sector]);
   }
+  flash_markErased(sector_base[start_sector],
+                   sector_base[end_sector + 1] - sector_base[start_sector]);
   return 0;
 }
 
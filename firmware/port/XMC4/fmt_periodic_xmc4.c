@@ -1,5 +1,4 @@
-
-#include <fmt_periodic.h>
+#include <fmt_periodic_port.h>
 #include <timer_pcbDetails.h>
 #include "core_cm4.h" // NVIC
 #include <xmc_ccu4.h> // timer
@@ -9,28 +8,45 @@
 #else
 #error "XMC4 mcu not supported."
 #endif
+#define TIMER_COUNT (sizeof(timerConfigs) / sizeof(timerResource_t))
+#define PERIOD_MAX 0x10000U     // PR is 16 bits.
+#define PRESCALER_MAX 0x8000U   // 2^15, the greatest PSIV.
+
 const timerResource_t timerConfigs[] = AVAILABLE_TIMERS;
 
-static bool storeCallback(IRQn_Type irqNumber, callback_t callback);
+typedef struct
+{
+  periodicTimer_t state;
+  XMC_CCU4_SLICE_t *slice;
+} ccuTimer_t;
+
+static ccuTimer_t timers[TIMER_COUNT];
+
+static bool storeTimer(IRQn_Type irqNumber, ccuTimer_t *timer);
 
 /** Configure a CCU4 Timer to drive an ISR at a fixed period.
  * Consumes a CCU4 timer timer.slice.  (There are 4 timer.slices per timer.module).
  * The Timer's clock runs at the sys clock frequency. (144MHz for XMC4700).
  * To determine the ISR call frequency: f_sys / prescale / periodTick
  * Example: 144MHz / 1024 prescale / 10000 period = 14.0625 Hz.
+ * The prescaler is the least power of 2 that fits intervalUs in the 16-bit
+ * period, so intervals up to 455us (at 144MHz) count every sys clock.
  */
 
 bool fmt_initPeriodic(
     uint8_t timerId, uint32_t intervalUs, uint32_t priority, callback_t callback)
 {
-  if (timerId >= sizeof(timerConfigs) / sizeof(timerResource_t))
+  if (timerId >= TIMER_COUNT)
     return false;
 
   timerResource_t timer = timerConfigs[timerId];
 
-  // Currently only supports exact frequencies up to 1kHz.
-  XMC_CCU4_SLICE_PRESCALER_t prescaler = XMC_CCU4_SLICE_PRESCALER_128;
-  uint16_t periodTick = (unsigned long long)(SYS_FREQ / 128U) * intervalUs / 1000000U;
+  timerDivide_t divide;
+  if (!fmt_periodic_divide(SYS_FREQ, intervalUs, PERIOD_MAX, PRESCALER_MAX,
+                           true, &divide))
+    return false;
+  XMC_CCU4_SLICE_PRESCALER_t prescaler =
+      (XMC_CCU4_SLICE_PRESCALER_t)__builtin_ctz(divide.prescaler);
 
   XMC_CCU4_SLICE_COMPARE_CONFIG_t compareCfg = {
       .timer_mode = XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA,
@@ -40,15 +56,24 @@ bool fmt_initPeriodic(
 
   };
 
-  // Store the supplied callback, associating to the correct IRQ handler.
-  if (!storeCallback(timer.irqNumber, callback))
+  timers[timerId] = (ccuTimer_t){
+      .state = {
+          .callback = callback,
+          .clockHz = SYS_FREQ,
+          .divide = divide,
+          .minLatency = UINT32_MAX},
+      .slice = timer.slice};
+
+  // Associate the timer's state with the correct IRQ handler.
+  if (!storeTimer(timer.irqNumber, &timers[timerId]))
     return false;
 
   XMC_CCU4_Init(timer.module, XMC_CCU4_SLICE_MCMS_ACTION_TRANSFER_PR_CR);
   // XMC_CCU4_SetModuleClock(timer.module, XMC_CCU4_CLOCK_SCU); // SCU is default.
   XMC_CCU4_SLICE_CompareInit(timer.slice, &compareCfg);
   XMC_CCU4_SLICE_SetPrescaler(timer.slice, prescaler);
-  XMC_CCU4_SLICE_SetTimerPeriodMatch(timer.slice, periodTick);
+  // Edge-aligned, the timer counts 0 to PR, so a period of PR + 1.
+  XMC_CCU4_SLICE_SetTimerPeriodMatch(timer.slice, divide.period - 1U);
 
   // Trigger CCU40_0_IRQHandler() on Period match event.
   XMC_CCU4_SLICE_EnableEvent(timer.slice, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
@@ -65,401 +90,187 @@ bool fmt_initPeriodic(
   return true;
 }
 
-#if 1
-#if PERIODIC_USES_CCU40_0
-callback_t CCU40_0_callback = NULL;
-void CCU40_0_IRQHandler(void);
-void CCU40_0_IRQHandler(void)
+periodicTimer_t *port_getPeriodicTimer(uint8_t timerId)
 {
-  if (CCU40_0_callback)
-    CCU40_0_callback();
+  return timerId < TIMER_COUNT ? &timers[timerId].state : NULL;
 }
+
+/* The timer restarts from 0 on period match, so reading it first thing is the
+ISR's entry latency.  The period match event is cleared before the callback, so
+if it's set again after, the next tick came while the callback ran. */
+#define CCU_IRQ_HANDLER(name)                                                  \
+  static ccuTimer_t *name##_timer = NULL;                                      \
+  void name##_IRQHandler(void);                                                \
+  void name##_IRQHandler(void)                                                 \
+  {                                                                            \
+    ccuTimer_t *timer = name##_timer;                                          \
+    if (!timer)                                                                \
+      return;                                                                  \
+    uint32_t latency = XMC_CCU4_SLICE_GetTimerValue(timer->slice);             \
+    XMC_CCU4_SLICE_ClearEvent(timer->slice,                                    \
+                              XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);             \
+    fmt_periodic_tick(&timer->state, latency);                                 \
+    if (XMC_CCU4_SLICE_GetEvent(timer->slice,                                  \
+                                XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH))           \
+      timer->state.overruns++;                                                 \
+  }
+
+#if PERIODIC_USES_CCU40_0
+CCU_IRQ_HANDLER(CCU40_0)
 #endif
 #if PERIODIC_USES_CCU40_1
-callback_t CCU40_1_callback = NULL;
-void CCU40_1_IRQHandler(void);
-void CCU40_1_IRQHandler(void)
-{
-  if (CCU40_1_callback)
-    CCU40_1_callback();
-}
+CCU_IRQ_HANDLER(CCU40_1)
 #endif
 #if PERIODIC_USES_CCU40_2
-callback_t CCU40_2_callback = NULL;
-void CCU40_2_IRQHandler(void);
-void CCU40_2_IRQHandler(void)
-{
-  if (CCU40_2_callback)
-    CCU40_2_callback();
-}
+CCU_IRQ_HANDLER(CCU40_2)
 #endif
 #if PERIODIC_USES_CCU40_3
-callback_t CCU40_3_callback = NULL;
-void CCU40_3_IRQHandler(void);
-void CCU40_3_IRQHandler(void)
-{
-  if (CCU40_3_callback)
-    CCU40_3_callback();
-}
+CCU_IRQ_HANDLER(CCU40_3)
 #endif
 #if PERIODIC_USES_CCU41_0
-callback_t CCU41_0_callback = NULL;
-void CCU41_0_IRQHandler(void);
-void CCU41_0_IRQHandler(void)
-{
-  if (CCU41_0_callback)
-    CCU41_0_callback();
-}
+CCU_IRQ_HANDLER(CCU41_0)
 #endif
 #if PERIODIC_USES_CCU41_1
-callback_t CCU41_1_callback = NULL;
-void CCU41_1_IRQHandler(void);
-void CCU41_1_IRQHandler(void)
-{
-  if (CCU41_1_callback)
-    CCU41_1_callback();
-}
+CCU_IRQ_HANDLER(CCU41_1)
 #endif
 #if PERIODIC_USES_CCU41_2
-callback_t CCU41_2_callback = NULL;
-void CCU41_2_IRQHandler(void);
-void CCU41_2_IRQHandler(void)
-{
-  if (CCU41_2_callback)
-    CCU41_2_callback();
-}
+CCU_IRQ_HANDLER(CCU41_2)
 #endif
 #if PERIODIC_USES_CCU41_3
-callback_t CCU41_3_callback = NULL;
-void CCU41_3_IRQHandler(void);
-void CCU41_3_IRQHandler(void)
-{
-  if (CCU41_3_callback)
-    CCU41_3_callback();
-}
+CCU_IRQ_HANDLER(CCU41_3)
 #endif
 #if PERIODIC_USES_CCU42_0
-callback_t CCU42_0_callback = NULL;
-void CCU42_0_IRQHandler(void);
-void CCU42_0_IRQHandler(void)
-{
-  if (CCU42_0_callback)
-    CCU42_0_callback();
-}
+CCU_IRQ_HANDLER(CCU42_0)
 #endif
 #if PERIODIC_USES_CCU42_1
-callback_t CCU42_1_callback = NULL;
-void CCU42_1_IRQHandler(void);
-void CCU42_1_IRQHandler(void)
-{
-  if (CCU42_1_callback)
-    CCU42_1_callback();
-}
+CCU_IRQ_HANDLER(CCU42_1)
 #endif
 #if PERIODIC_USES_CCU42_2
-callback_t CCU42_2_callback = NULL;
-void CCU42_2_IRQHandler(void);
-void CCU42_2_IRQHandler(void)
-{
-  if (CCU42_2_callback)
-    CCU42_2_callback();
-}
+CCU_IRQ_HANDLER(CCU42_2)
 #endif
 #if PERIODIC_USES_CCU42_3
-callback_t CCU42_3_callback = NULL;
-void CCU42_3_IRQHandler(void);
-void CCU42_3_IRQHandler(void)
-{
-  if (CCU42_3_callback)
-    CCU42_3_callback();
-}
+CCU_IRQ_HANDLER(CCU42_3)
 #endif
 #if PERIODIC_USES_CCU43_0
-callback_t CCU43_0_callback = NULL;
-void CCU43_0_IRQHandler(void);
-void CCU43_0_IRQHandler(void)
-{
-  if (CCU43_0_callback)
-    CCU43_0_callback();
-}
+CCU_IRQ_HANDLER(CCU43_0)
 #endif
 #if PERIODIC_USES_CCU43_1
-callback_t CCU43_1_callback = NULL;
-void CCU43_1_IRQHandler(void);
-void CCU43_1_IRQHandler(void)
-{
-  if (CCU43_1_callback)
-    CCU43_1_callback();
-}
+CCU_IRQ_HANDLER(CCU43_1)
 #endif
 #if PERIODIC_USES_CCU43_2
-callback_t CCU43_2_callback = NULL;
-void CCU43_2_IRQHandler(void);
-void CCU43_2_IRQHandler(void)
-{
-  if (CCU43_2_callback)
-    CCU43_2_callback();
-}
+CCU_IRQ_HANDLER(CCU43_2)
 #endif
 #if PERIODIC_USES_CCU43_3
-callback_t CCU43_3_callback = NULL;
-void CCU43_3_IRQHandler(void);
-void CCU43_3_IRQHandler(void)
-{
-  if (CCU43_3_callback)
-    CCU43_3_callback();
-}
+CCU_IRQ_HANDLER(CCU43_3)
 #endif
 #if PERIODIC_USES_CCU80_0
-callback_t CCU80_0_callback = NULL;
-void CCU80_0_IRQHandler(void);
-void CCU80_0_IRQHandler(void)
-{
-  if (CCU80_0_callback)
-    CCU80_0_callback();
-}
+CCU_IRQ_HANDLER(CCU80_0)
 #endif
 #if PERIODIC_USES_CCU80_1
-callback_t CCU80_1_callback = NULL;
-void CCU80_1_IRQHandler(void);
-void CCU80_1_IRQHandler(void)
-{
-  if (CCU80_1_callback)
-    CCU80_1_callback();
-}
+CCU_IRQ_HANDLER(CCU80_1)
 #endif
 #if PERIODIC_USES_CCU80_2
-callback_t CCU80_2_callback = NULL;
-void CCU80_2_IRQHandler(void);
-void CCU80_2_IRQHandler(void)
-{
-  if (CCU80_2_callback)
-    CCU80_2_callback();
-}
+CCU_IRQ_HANDLER(CCU80_2)
 #endif
 #if PERIODIC_USES_CCU80_3
-callback_t CCU80_3_callback = NULL;
-void CCU80_3_IRQHandler(void);
-void CCU80_3_IRQHandler(void)
-{
-  if (CCU80_3_callback)
-    CCU80_3_callback();
-}
+CCU_IRQ_HANDLER(CCU80_3)
 #endif
 #if PERIODIC_USES_CCU81_0
-callback_t CCU81_0_callback = NULL;
-void CCU81_0_IRQHandler(void);
-void CCU81_0_IRQHandler(void)
-{
-  if (CCU81_0_callback)
-    CCU81_0_callback();
-}
+CCU_IRQ_HANDLER(CCU81_0)
 #endif
 #if PERIODIC_USES_CCU81_1
-callback_t CCU81_1_callback = NULL;
-void CCU81_1_IRQHandler(void);
-void CCU81_1_IRQHandler(void)
-{
-  if (CCU81_1_callback)
-    CCU81_1_callback();
-}
+CCU_IRQ_HANDLER(CCU81_1)
 #endif
 #if PERIODIC_USES_CCU81_2
-callback_t CCU81_2_callback = NULL;
-void CCU81_2_IRQHandler(void);
-void CCU81_2_IRQHandler(void)
-{
-  if (CCU81_2_callback)
-    CCU81_2_callback();
-}
+CCU_IRQ_HANDLER(CCU81_2)
 #endif
 #if PERIODIC_USES_CCU81_3
-callback_t CCU81_3_callback = NULL;
-void CCU81_3_IRQHandler(void);
-void CCU81_3_IRQHandler(void)
-{
-  if (CCU81_3_callback)
-    CCU81_3_callback();
-}
-#endif
+CCU_IRQ_HANDLER(CCU81_3)
 #endif
 
-bool storeCallback(IRQn_Type irqNumber, callback_t callback)
+#define STORE_TIMER(name)  \
+  case name##_IRQn:        \
+    name##_timer = timer;  \
+    break;
+
+static bool storeTimer(IRQn_Type irqNumber, ccuTimer_t *timer)
 {
   switch (irqNumber)
   {
 #if PERIODIC_USES_CCU40_0
-  case CCU40_0_IRQn:
-  {
-    CCU40_0_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU40_0)
 #endif
 #if PERIODIC_USES_CCU40_1
-  case CCU40_1_IRQn:
-  {
-    CCU40_1_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU40_1)
 #endif
 #if PERIODIC_USES_CCU40_2
-  case CCU40_2_IRQn:
-  {
-    CCU40_2_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU40_2)
 #endif
 #if PERIODIC_USES_CCU40_3
-  case CCU40_3_IRQn:
-  {
-    CCU40_3_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU40_3)
 #endif
 #if PERIODIC_USES_CCU41_0
-  case CCU41_0_IRQn:
-  {
-    CCU41_0_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU41_0)
 #endif
 #if PERIODIC_USES_CCU41_1
-  case CCU41_1_IRQn:
-  {
-    CCU41_1_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU41_1)
 #endif
 #if PERIODIC_USES_CCU41_2
-  case CCU41_2_IRQn:
-  {
-    CCU41_2_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU41_2)
 #endif
 #if PERIODIC_USES_CCU41_3
-  case CCU41_3_IRQn:
-  {
-    CCU41_3_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU41_3)
 #endif
 #if PERIODIC_USES_CCU42_0
-  case CCU42_0_IRQn:
-  {
-    CCU42_0_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU42_0)
 #endif
 #if PERIODIC_USES_CCU42_1
-  case CCU42_1_IRQn:
-  {
-    CCU42_1_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU42_1)
 #endif
 #if PERIODIC_USES_CCU42_2
-  case CCU42_2_IRQn:
-  {
-    CCU42_2_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU42_2)
 #endif
 #if PERIODIC_USES_CCU42_3
-  case CCU42_3_IRQn:
-  {
-    CCU42_3_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU42_3)
 #endif
 #if PERIODIC_USES_CCU43_0
-  case CCU43_0_IRQn:
-  {
-    CCU43_0_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU43_0)
 #endif
 #if PERIODIC_USES_CCU43_1
-  case CCU43_1_IRQn:
-  {
-    CCU43_1_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU43_1)
 #endif
 #if PERIODIC_USES_CCU43_2
-  case CCU43_2_IRQn:
-  {
-    CCU43_2_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU43_2)
 #endif
 #if PERIODIC_USES_CCU43_3
-  case CCU43_3_IRQn:
-  {
-    CCU43_3_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU43_3)
 #endif
 #if PERIODIC_USES_CCU80_0
-  case CCU80_0_IRQn:
-  {
-    CCU80_0_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU80_0)
 #endif
 #if PERIODIC_USES_CCU80_1
-  case CCU80_1_IRQn:
-  {
-    CCU80_1_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU80_1)
 #endif
 #if PERIODIC_USES_CCU80_2
-  case CCU80_2_IRQn:
-  {
-    CCU80_2_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU80_2)
 #endif
 #if PERIODIC_USES_CCU80_3
-  case CCU80_3_IRQn:
-  {
-    CCU80_3_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU80_3)
 #endif
 #if PERIODIC_USES_CCU81_0
-  case CCU81_0_IRQn:
-  {
-    CCU81_0_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU81_0)
 #endif
 #if PERIODIC_USES_CCU81_1
-  case CCU81_1_IRQn:
-  {
-    CCU81_1_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU81_1)
 #endif
 #if PERIODIC_USES_CCU81_2
-  case CCU81_2_IRQn:
-  {
-    CCU81_2_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU81_2)
 #endif
 #if PERIODIC_USES_CCU81_3
-  case CCU81_3_IRQn:
-  {
-    CCU81_3_callback = callback;
-    break;
-  }
+    STORE_TIMER(CCU81_3)
 #endif
   default:
-  {
     return false;
   }
-  }
   return true;
-}
\ No newline at end of file
+}
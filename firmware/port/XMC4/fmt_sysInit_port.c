@@ -1,6 +1,7 @@
 #include <fmt_sysInit.h>
+#include <cycles_port.h>
 
 void fmt_initSys(void)
 {
-  
+  port_initCycleCounter(); // Stopped at reset unless a debugger started it.
 }
\ No newline at end of file
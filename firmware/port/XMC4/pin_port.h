@@ -0,0 +1,38 @@
+#pragma once
+#include <xmc_gpio.h> // XMC_GPIO_PORT_t
+#include <stdbool.h>
+#include <stdint.h>
+
+/** A resolved pin: its port's registers and its mask.  See fmt_getPin(). */
+typedef struct
+{
+  XMC_GPIO_PORT_t *port;
+  uint32_t mask;
+} fmt_pin_t;
+
+static inline fmt_pin_t port_getPin(void *const port, uint8_t pin)
+{
+  fmt_pin_t handle = {(XMC_GPIO_PORT_t *)port, 1U << pin};
+  return handle;
+}
+
+// OMR: the low half sets pins, the high half resets them, and both toggle.
+static inline void port_pinHigh(fmt_pin_t pin)
+{
+  pin.port->OMR = pin.mask;
+}
+
+static inline void port_pinLow(fmt_pin_t pin)
+{
+  pin.port->OMR = pin.mask << 16;
+}
+
+static inline void port_pinToggle(fmt_pin_t pin)
+{
+  pin.port->OMR = pin.mask | (pin.mask << 16);
+}
+
+static inline bool port_pinRead(fmt_pin_t pin)
+{
+  return (pin.port->IN & pin.mask) != 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+
+/** Cortex-M3/M4/M7 DWT cycle counter, for timing in fmt_sched.c and fmt_profile.h */
+
+#define CYCLES_REG(addr) (*(volatile uint32_t *)(addr))
+#define PORT_DEMCR CYCLES_REG(0xE000EDFC)     // Debug Exception & Monitor Ctl
+#define PORT_DWT_CTRL CYCLES_REG(0xE0001000)  // DWT Control
+#define PORT_DWT_CYCCNT CYCLES_REG(0xE0001004) // DWT Cycle Count
+#define PORT_DEMCR_TRCENA (1UL << 24)
+#define PORT_DWT_CTRL_CYCCNTENA (1UL << 0)
+
+extern uint32_t SystemCoreClock; // CMSIS system_<device>.c
+
+/** Starts the counter.  Harmless if a debugger already has. */
+inline static void port_initCycleCounter(void)
+{
+  PORT_DEMCR |= PORT_DEMCR_TRCENA;
+  PORT_DWT_CTRL |= PORT_DWT_CTRL_CYCCNTENA;
+}
+
+/** Core clock cycles.  Wraps, so only differences (as uint32_t) mean much. */
+inline static uint32_t port_getCycles(void)
+{
+  return PORT_DWT_CYCCNT;
+}
+
+inline static uint32_t port_getCyclesPerUs(void)
+{
+  return SystemCoreClock / 1000000U;
+}
@@ -0,0 +1,58 @@
+#include <stdint.h>
+
+/** Cortex-M3/M4/M7 fault support for fmt_hardfault.c */
+
+#define FAULT_REG(addr) (*(volatile uint32_t *)(addr))
+#define PORT_CFSR FAULT_REG(0xE000ED28)  // Configurable Fault Status
+#define PORT_HFSR FAULT_REG(0xE000ED2C)  // HardFault Status
+#define PORT_MMFAR FAULT_REG(0xE000ED34) // MemManage Fault Address
+#define PORT_BFAR FAULT_REG(0xE000ED38)  // BusFault Address
+#define PORT_VTOR FAULT_REG(0xE000ED08)  // Vector Table Offset
+#define PORT_AIRCR FAULT_REG(0xE000ED0C) // App. Interrupt and Reset Control
+
+/** Size of the stack captureFn runs on: see PORT_FAULT_HANDLER(). */
+#define PORT_FAULT_STACK_BYTES 256
+#define PORT_STRINGIFY_(x) #x
+#define PORT_STRINGIFY(x) PORT_STRINGIFY_(x)
+
+/**
+ * Defines a fault handler that calls captureFn(frame, excReturn, faultType).
+ * frame is the exception frame the core stacked (r0-r3, r12, lr, pc, xpsr),
+ * taken from MSP or PSP according to EXC_RETURN bit 2.  Naked so that no
+ * prologue moves the stack pointer first.  faultType must be a literal.
+ * MSP is then moved to the top of faultStack, a global PORT_FAULT_STACK_BYTES
+ * array aligned to 8: after a main stack overflow, a push on MSP would lock up
+ * instead of running captureFn.  captureFn must not return.
+ */
+#define PORT_FAULT_HANDLER(handlerName, captureFn, faultType, faultStack)    \
+  __attribute__((naked)) void handlerName(void)                              \
+  {                                                                          \
+    __asm volatile(                                                          \
+        "  tst lr, #4            \n"                                         \
+        "  ite eq                \n"                                         \
+        "  mrseq r0, msp         \n"                                         \
+        "  mrsne r0, psp         \n"                                         \
+        "  mov r1, lr            \n"                                         \
+        "  movw r3, #:lower16:" #faultStack "+"                              \
+        PORT_STRINGIFY(PORT_FAULT_STACK_BYTES) "\n"                          \
+        "  movt r3, #:upper16:" #faultStack "+"                              \
+        PORT_STRINGIFY(PORT_FAULT_STACK_BYTES) "\n"                          \
+        "  msr msp, r3           \n"                                         \
+        "  movs r2, #" #faultType "\n"                                       \
+        "  b " #captureFn "      \n");                                       \
+  }
+
+/** Initial MSP from the vector table: the top of the main stack. */
+inline static uintptr_t port_getStackTop(void)
+{
+  return *(const uint32_t *)PORT_VTOR;
+}
+
+inline static void port_resetSystem(void)
+{
+  __asm volatile("dsb" ::: "memory");
+  PORT_AIRCR = (0x05FAUL << 16) | (1UL << 2); // VECTKEY | SYSRESETREQ
+  __asm volatile("dsb" ::: "memory");
+  while (1)
+    ;
+}
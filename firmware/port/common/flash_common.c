@@ -2,11 +2,103 @@
 #include <fmt_flash_port.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+
+#ifndef FLASH_POINTER
+// Program memory is memory-mapped on all supported MCUs.
+#define FLASH_POINTER(address) ((const uint8_t *)(uintptr_t)(address))
+#endif
+
+int fmt_flash_read(uint32_t address, uint8_t *data, uint32_t len)
+{
+  memcpy(data, FLASH_POINTER(address), len);
+  return 0;
+}
+
+/** Erased map
+ * Ranges known to read as erased, so sequential writes into a freshly erased
+ * sector don't scan it again.  An erase records the whole sector; a write moves
+ * the start of its range (the watermark) past the write blocks written.
+ * Ranges a scan finds erased aren't recorded: ports scan rows they have already
+ * marked written, just before programming them.
+ * This only holds while all erases and writes go through fmt_flash.
+ */
+#define ERASED_MAP_SIZE 4
+
+typedef struct
+{
+  uint32_t from; // [from, to) reads erased.
+  uint32_t to;
+} erasedRange_t;
+
+static erasedRange_t erasedMap[ERASED_MAP_SIZE];
+static uint32_t nextMapEntry = 0;
+
+static bool wordsErased(const uint32_t *ptr, const uint32_t *end);
 
 bool flash_isErased(uint32_t address, uint32_t len)
 {
-  const uint32_t* endAddress = (uint32_t*)(address + len);
-  for (uint32_t* ptr = (uint32_t*)address; ptr < endAddress; ptr++)
+  for (int i = 0; i < ERASED_MAP_SIZE; i++)
+  {
+    if (erasedMap[i].from <= address && address + len <= erasedMap[i].to)
+      return true;
+  }
+
+  const uint8_t *ptr = FLASH_POINTER(address);
+  return wordsErased((const uint32_t *)ptr, (const uint32_t *)(ptr + len));
+}
+
+void flash_markErased(uint32_t address, uint32_t len)
+{
+  uint32_t end = address + len;
+  erasedRange_t *unused = NULL;
+  for (int i = 0; i < ERASED_MAP_SIZE; i++)
+  {
+    erasedRange_t *range = &erasedMap[i];
+    if (range->from == range->to)
+      unused = range;
+    else if (range->from <= end && address <= range->to)
+    {
+      // Overlaps or touches: grow it.
+      if (address < range->from)
+        range->from = address;
+      if (end > range->to)
+        range->to = end;
+      return;
+    }
+  }
+  if (unused == NULL)
+  {
+    unused = &erasedMap[nextMapEntry];
+    nextMapEntry = (nextMapEntry + 1) % ERASED_MAP_SIZE;
+  }
+  *unused = (erasedRange_t){.from = address, .to = end};
+}
+
+void flash_markWritten(uint32_t address, uint32_t len)
+{
+  // Ports program whole write blocks.
+  uint32_t from = getPreceedingWriteBoundary(address);
+  uint32_t to = getPreceedingWriteBoundary(address + len + WRITE_BLOCK_SIZE - 1);
+  for (int i = 0; i < ERASED_MAP_SIZE; i++)
+  {
+    erasedRange_t *range = &erasedMap[i];
+    if (from < range->to && to > range->from)
+      range->from = (to < range->to) ? to : range->to;
+  }
+}
+
+/** Compares four words per iteration, where the flash interface can prefetch.
+ */
+static bool wordsErased(const uint32_t *ptr, const uint32_t *end)
+{
+  for (; end - ptr >= 4; ptr += 4)
+  {
+    if ((ptr[0] ^ ERASED_STATE) | (ptr[1] ^ ERASED_STATE) |
+        (ptr[2] ^ ERASED_STATE) | (ptr[3] ^ ERASED_STATE))
+      return false;
+  }
+  for (; ptr < end; ptr++)
   {
     if (*ptr != ERASED_STATE)
       return false;
@@ -17,4 +109,16 @@ bool flash_isErased(uint32_t address, uint32_t len)
 uint32_t getPreceedingWriteBoundary(uint32_t address)
 {
   return (address / WRITE_BLOCK_SIZE) * WRITE_BLOCK_SIZE;
+}
+
+void flash_fillWriteBlock(uint8_t *block, uint32_t block_adr, uint32_t address,
+                          const uint8_t *data, uint32_t len)
+{
+  uint32_t start = (address > block_adr) ? address : block_adr;
+  uint32_t end = address + len;
+  if (end > block_adr + WRITE_BLOCK_SIZE)
+    end = block_adr + WRITE_BLOCK_SIZE;
+
+  memset(block, 0, WRITE_BLOCK_SIZE);
+  memcpy(block + (start - block_adr), data + (start - address), end - start);
 }
\ No newline at end of file
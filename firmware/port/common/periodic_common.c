@@ -0,0 +1,32 @@
+#include <fmt_periodic_port.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+bool fmt_periodic_divide(uint32_t clockHz, uint32_t intervalUs,
+                         uint32_t periodMax, uint32_t prescalerMax,
+                         bool pow2Prescaler, timerDivide_t *divide)
+{
+  if (intervalUs < FMT_PERIODIC_INTERVAL_MIN_US || periodMax == 0)
+    return false;
+
+  uint64_t clocks = ((uint64_t)clockHz * intervalUs + 500000U) / 1000000U;
+  uint64_t prescaler = (clocks + periodMax - 1) / periodMax;
+  if (prescaler == 0)
+    prescaler = 1;
+  if (pow2Prescaler)
+  {
+    uint64_t pow2 = 1;
+    while (pow2 < prescaler)
+      pow2 <<= 1;
+    prescaler = pow2;
+  }
+  if (prescaler > prescalerMax)
+    return false;
+
+  // Rounded to the nearest count, which stays within periodMax.
+  uint64_t period = (clocks + prescaler / 2) / prescaler;
+  if (period == 0)
+    return false;
+  *divide = (timerDivide_t){.prescaler = prescaler, .period = period};
+  return true;
+}
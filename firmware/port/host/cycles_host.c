@@ -0,0 +1,3 @@
+#include "cycles_port.h"
+
+uint32_t hostCycles = 0;
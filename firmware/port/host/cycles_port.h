@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+/** Host stand-in for the DWT cycle counter.
+ * Time only passes when tests advance hostCycles, eg. from inside the code
+ * being timed. */
+
+#define HOST_CYCLES_PER_US 80U
+
+extern uint32_t hostCycles; // cycles_host.c
+
+inline static void port_initCycleCounter(void) {}
+
+inline static uint32_t port_getCycles(void)
+{
+  return hostCycles;
+}
+
+inline static uint32_t port_getCyclesPerUs(void)
+{
+  return HOST_CYCLES_PER_US;
+}
@@ -0,0 +1,28 @@
+#include <stdint.h>
+
+/** Host stand-ins for fault support in fmt_hardfault.c
+ * Calling a fault handler captures a fake, zeroed exception frame and returns,
+ * so tests can exercise the crash record and report. */
+
+static uint32_t hostFaultRegs[4];
+static uint32_t hostFaultFrame[32];
+#define PORT_CFSR (hostFaultRegs[0])
+#define PORT_HFSR (hostFaultRegs[1])
+#define PORT_MMFAR (hostFaultRegs[2])
+#define PORT_BFAR (hostFaultRegs[3])
+
+#define PORT_FAULT_STACK_BYTES 256
+
+// The host keeps its stack: faultStack isn't switched to.
+#define PORT_FAULT_HANDLER(handlerName, captureFn, faultType, faultStack) \
+  void handlerName(void)                                                  \
+  {                                                                       \
+    captureFn(hostFaultFrame, 0xFFFFFFF9U, faultType);                    \
+  }
+
+inline static uintptr_t port_getStackTop(void)
+{
+  return (uintptr_t)(hostFaultFrame + 32);
+}
+
+inline static void port_resetSystem(void) {}
@@ -1,11 +1,69 @@
 #include <fmt_flash.h>
+#include <fmt_flash_port.h>
+#include <string.h>
+
+/* Flash is modeled as a RAM array that every address maps into, so what tests
+ * write can be read back.  Reads and the erased map are flash_common.c's, so
+ * writes and erases keep the map up to date as a port does. */
+#define MOCK_FLASH_SIZE 0x100000
+static uint8_t mockFlash[MOCK_FLASH_SIZE] __attribute__((aligned(4)));
+
+static uint8_t *mockAddress(uint32_t address, uint32_t len)
+{
+  uint32_t offset = address % MOCK_FLASH_SIZE;
+  return (offset + len <= MOCK_FLASH_SIZE) ? &mockFlash[offset] : NULL;
+}
 
 int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len)
 {
+  uint8_t *dest = mockAddress(address, len);
+  if (dest == NULL)
+    return -1;
+  flash_markWritten(address, len);
+  memcpy(dest, data, len);
+  return 0;
+}
 
+/* Async writes are done at once and completed by the next poll, as a port
+ * that polls would do it. */
+static fmt_flash_callback_t pendingWriteCb = NULL;
+static int pendingWriteStatus;
+
+int fmt_flash_writeAsync(uint32_t address, const uint8_t *data, uint32_t len,
+                         fmt_flash_callback_t cb)
+{
+  if (pendingWriteCb)
+    return -1;
+  pendingWriteStatus = fmt_flash_write(address, data, len);
+  pendingWriteCb = cb;
+  return 0;
 }
 
-int fmt_flash_erase(uint32_t start_address, uint32_t len)
+int fmt_flash_pollWrite(void)
 {
-  
-}
\ No newline at end of file
+  fmt_flash_callback_t cb = pendingWriteCb;
+  pendingWriteCb = NULL;
+  if (cb)
+    cb(pendingWriteStatus);
+  return 0;
+}
+
+const uint8_t *mock_flashPointer(uint32_t address)
+{
+  return &mockFlash[address % MOCK_FLASH_SIZE];
+}
+
+int fmt_flash_startErase(uint32_t start_address, uint32_t len)
+{
+  uint8_t *dest = mockAddress(start_address, len);
+  if (dest == NULL)
+    return -1;
+  memset(dest, 0xFF, len);
+  flash_markErased(start_address, len);
+  return 0;
+}
+
+int fmt_flash_pollErase(void)
+{
+  return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef fmt_flash_port_H
+#define fmt_flash_port_H
+
+#include <stdint.h>
+
+#define ERASED_STATE 0xFFFFFFFF
+#define WRITE_BLOCK_SIZE 256
+
+/** Host flash is a RAM array that every address maps into (fmt_flash_mock.c),
+ * so flash_common.c reads it through this. */
+const uint8_t *mock_flashPointer(uint32_t address);
+#define FLASH_POINTER(address) mock_flashPointer(address)
+
+#endif
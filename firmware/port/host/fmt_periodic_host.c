@@ -0,0 +1,34 @@
+#include <fmt_periodic_port.h>
+#include <stddef.h>
+
+#define HOST_TIMER_COUNT 2U
+#define HOST_TIMER_CLOCK_HZ 80000000U // Like a 16-bit timer on an 80MHz bus.
+#define HOST_TIMER_PERIOD_MAX 0x10000U
+#define HOST_TIMER_PRESCALER_MAX 0x10000U
+
+static periodicTimer_t timers[HOST_TIMER_COUNT];
+
+/** There's no timer on the host.  Tests call the callback themselves, or
+ * fmt_periodic_tick() with port_getPeriodicTimer(). */
+bool fmt_initPeriodic(
+    uint8_t timerId, uint32_t intervalUs, uint32_t priority, callback_t callback)
+{
+  timerDivide_t divide;
+  if (timerId >= HOST_TIMER_COUNT || !callback ||
+      !fmt_periodic_divide(HOST_TIMER_CLOCK_HZ, intervalUs,
+                           HOST_TIMER_PERIOD_MAX, HOST_TIMER_PRESCALER_MAX,
+                           false, &divide))
+    return false;
+
+  timers[timerId] = (periodicTimer_t){
+      .callback = callback,
+      .clockHz = HOST_TIMER_CLOCK_HZ,
+      .divide = divide,
+      .minLatency = UINT32_MAX};
+  return true;
+}
+
+periodicTimer_t *port_getPeriodicTimer(uint8_t timerId)
+{
+  return timerId < HOST_TIMER_COUNT ? &timers[timerId] : NULL;
+}
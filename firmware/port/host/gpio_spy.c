@@ -1,6 +1,10 @@
 #include <fmt_gpio_port.h>
+#include <pin_port.h>
 #include <stdint.h>
 
+uint32_t hostGpioOut[HOST_GPIO_PORTS];
+uint32_t hostGpioIn[HOST_GPIO_PORTS];
+
 void port_initInputPin(void *const port, uint8_t pin, inputMode_t mode)
 {
 
@@ -10,13 +14,3 @@ void port_initOutputPin(void *const port, const uint8_t pin, outputMode_t mode)
 {
 
 }
-
-uint32_t port_readPort(void *const port)
-{
-
-}
-
-void port_setPin(void *const port, uint_fast8_t pin, outLevel_t level)
-{
-
-}
\ No newline at end of file
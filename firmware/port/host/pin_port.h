@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Host stand-in for GPIO port registers.  The port "address" from
+ * gpio_mcuDetails.h indexes them.  Tests set hostGpioIn and check hostGpioOut.
+ */
+#define HOST_GPIO_PORTS 16U
+
+extern uint32_t hostGpioOut[HOST_GPIO_PORTS]; // gpio_spy.c
+extern uint32_t hostGpioIn[HOST_GPIO_PORTS];
+
+/** A resolved pin: its port's registers and its mask.  See fmt_getPin(). */
+typedef struct
+{
+  uintptr_t port;
+  uint32_t mask;
+} fmt_pin_t;
+
+static inline fmt_pin_t port_getPin(void *const port, uint8_t pin)
+{
+  fmt_pin_t handle = {(uintptr_t)port, 1U << pin};
+  return handle;
+}
+
+static inline void port_pinHigh(fmt_pin_t pin)
+{
+  hostGpioOut[pin.port] |= pin.mask;
+}
+
+static inline void port_pinLow(fmt_pin_t pin)
+{
+  hostGpioOut[pin.port] &= ~pin.mask;
+}
+
+static inline void port_pinToggle(fmt_pin_t pin)
+{
+  hostGpioOut[pin.port] ^= pin.mask;
+}
+
+static inline bool port_pinRead(fmt_pin_t pin)
+{
+  return (hostGpioIn[pin.port] & pin.mask) != 0;
+}
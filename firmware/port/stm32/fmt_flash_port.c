@@ -11,8 +11,15 @@
  *
  *
  * Special quirks:
- * - Programming can be accelerated if we know another woubld-word (64-bit) will
- *   will be programmed after this one.  See FLASH_TYPEPROGRAM_FAST in hal_flash
+ * - Page erases started by fmt_flash_startErase() run in the background, one
+ *   page per fmt_flash_pollErase() that finds the last one done.
+ * - A whole row (32 double-words) can be fast-programmed in one go, roughly 2-3x
+ *   faster than double-word programming.  See programRowFast().  Rows it can't
+ *   program are written one double-word at a time.  On the STM32L47x/L48x
+ *   (RM0351) fast programming needs a mass-erased bank, and firment only
+ *   page-erases, so the first PGSERR turns it off until reset.
+ * - fmt_flash_writeAsync() programs a row (or a double-word, when falling back)
+ *   per end-of-operation interrupt, from FLASH_IRQHandler.
  */
 
 #include "fmt_flash_port.h"
@@ -21,6 +28,7 @@
 #include <stdint.h>
 #include <string.h>
 #define HAL_FLASH_ENABLED
+#define HAL_CORTEX_ENABLED // HAL_NVIC_EnableIRQ()
 #include <stm32_hal_dispatch.h>
 
 /**
@@ -30,10 +38,53 @@
  * Using fast-programming, 256 bytes (a row) must be programmed as a sequence.
  */
 #define DOUBLEWORDS_PER_WRITE_BLOCK 32
+#define ROW_PROGRAM_ERRORS                                                     \
+  (FLASH_SR_PROGERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR |    \
+   FLASH_SR_PGSERR | FLASH_SR_MISERR | FLASH_SR_FASTERR)
+
+// Set by the first PGSERR from fast programming: the part wants a mass erase.
+static bool fastProgramUnsupported = false;
+
+/** Pages of one bank still to be erased in the background. */
+static struct
+{
+  bool active;
+  uint32_t start_address; // of the pages, for flash_markErased().
+  uint32_t end_address;
+  unsigned bank;
+  int nextPage;
+  int endPage;
+} eraseJob;
+
+/** The write in progress, advanced by the end-of-operation interrupt. */
+static struct
+{
+  volatile bool active;
+  bool fast;         // The row is being fast-programmed.
+  bool dataCacheOn;  // ...with the data cache bypassed, if it was on.
+  int doubleword;    // Else, the next double-word of the row to check.
+  uint32_t row_adr;
+  uint32_t address;
+  const uint8_t *data;
+  uint32_t len;
+  fmt_flash_callback_t cb;
+  uint64_t row[DOUBLEWORDS_PER_WRITE_BLOCK];
+} asyncWrite;
 
 static unsigned getBankContainingAddress(uint32_t address);
 static int getPageContainingAddress(uint32_t address);
 static int flash_erase(uint32_t start_address, uint32_t len);
+static void flushDataCache(void);
+static uint32_t getPageStart(uint32_t address);
+static bool bypassDataCache(void);
+static void restoreDataCache(bool dataCacheOn);
+static bool programRow(uint32_t row_adr, const uint64_t *row);
+static uint32_t programRowFast(uint32_t row_adr, const uint64_t *row,
+                               bool wait);
+static void programRowByDoubleword(uint32_t row_adr, const uint64_t *row);
+static void startAsyncRow(void);
+static void continueAsyncWrite(uint32_t errors);
+static void finishAsyncWrite(int status);
 
 /**
  * @param address guaranteed to be aligned to the start of a writable block, but
@@ -44,10 +95,13 @@ int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len)
 {
   static uint64_t buffer[DOUBLEWORDS_PER_WRITE_BLOCK]; // 256B
 
+  while (fmt_flash_pollWrite() > 0 || fmt_flash_pollErase() > 0)
+    ;
   HAL_FLASH_Unlock();
 
   if (!flash_isErased(address, len))
     flash_erase(address, len);
+  flash_markWritten(address, len);
 
   /* Find the closest page-aligned address preceeding first address to write*/
   uint32_t page_adr = getPreceedingWriteBoundary(address);
@@ -81,19 +135,14 @@ int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len)
     //                      page_adr  wr_end
     //                      wr_start
     memset(buffer, 0, sizeof(buffer));
-    memcpy(buffer + (page_write_start_adr - page_adr),
+    memcpy((uint8_t *)buffer + (page_write_start_adr - page_adr),
            data + bytes_written,
            page_write_end_adr - page_write_start_adr);
 
-    /* the Data parameter (last) must be a buffer address (32 dbl-words) when
-    using row fast programming, despite the integer type.  This is documented
-    in the comments preceeding this function's definition.*/
-    // HAL_FLASH_Program(FLASH_TYPEPROGRAM_FAST_AND_LAST, page_adr, (uint32_t)buffer);
-
-    // TODO: Get fast row programming working, and replace this loop.
-    for (int i = 0; i < DOUBLEWORDS_PER_WRITE_BLOCK; i++)
+    if (!programRow(page_adr, buffer))
     {
-      HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, page_adr + (8 * i), buffer[i]);
+      HAL_FLASH_Lock();
+      return -1;
     }
 
     // Prepare for next page.
@@ -104,6 +153,302 @@ int fmt_flash_write(uint32_t address, const uint8_t *data, uint32_t len)
   return 0;
 }
 
+int fmt_flash_writeAsync(uint32_t address, const uint8_t *data, uint32_t len,
+                         fmt_flash_callback_t cb)
+{
+  if (asyncWrite.active || len == 0)
+    return -1;
+
+  // Fetching from a bank being programmed would stall or abort the row.
+  uint32_t code_adr = (uint32_t)fmt_flash_writeAsync;
+  if (getBankContainingAddress(address) == getBankContainingAddress(code_adr))
+  {
+    int status = fmt_flash_write(address, data, len);
+    if (cb)
+      cb(status);
+    return 0;
+  }
+
+  while (fmt_flash_pollErase() > 0)
+    ;
+  HAL_FLASH_Unlock();
+  if (!flash_isErased(address, len))
+    flash_erase(address, len);
+  flash_markWritten(address, len);
+
+  asyncWrite.row_adr = getPreceedingWriteBoundary(address);
+  asyncWrite.address = address;
+  asyncWrite.data = data;
+  asyncWrite.len = len;
+  asyncWrite.cb = cb;
+  asyncWrite.active = true;
+
+  FLASH_WaitForLastOperation(FLASH_TIMEOUT_VALUE);
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  SET_BIT(FLASH->CR, FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+  HAL_NVIC_SetPriority(FLASH_IRQn, (1U << __NVIC_PRIO_BITS) - 1, 0);
+  HAL_NVIC_EnableIRQ(FLASH_IRQn);
+  startAsyncRow();
+  return 0;
+}
+
+int fmt_flash_pollWrite(void)
+{
+  return asyncWrite.active ? 1 : 0;
+}
+
+void FLASH_IRQHandler(void);
+void FLASH_IRQHandler(void)
+{
+  uint32_t errors = READ_BIT(FLASH->SR, ROW_PROGRAM_ERRORS);
+  WRITE_REG(FLASH->SR, FLASH_SR_EOP | FLASH_SR_OPERR | errors);
+  CLEAR_BIT(FLASH->CR, FLASH_CR_FSTPG | FLASH_CR_PG);
+  if (asyncWrite.active)
+    continueAsyncWrite(errors);
+}
+
+/** Fast-programs the next row if it is erased, else programs it by
+ * double-word.  Either way, an interrupt follows. */
+static void startAsyncRow(void)
+{
+  flash_fillWriteBlock((uint8_t *)asyncWrite.row, asyncWrite.row_adr,
+                       asyncWrite.address, asyncWrite.data, asyncWrite.len);
+  if (!fastProgramUnsupported &&
+      flash_isErased(asyncWrite.row_adr, WRITE_BLOCK_SIZE))
+  {
+    asyncWrite.fast = true;
+    asyncWrite.dataCacheOn = bypassDataCache();
+    programRowFast(asyncWrite.row_adr, asyncWrite.row, false);
+    return;
+  }
+  asyncWrite.fast = false;
+  asyncWrite.doubleword = 0;
+  continueAsyncWrite(0);
+}
+
+static void continueAsyncWrite(uint32_t errors)
+{
+  const volatile uint64_t *flash = (const volatile uint64_t *)asyncWrite.row_adr;
+  const uint64_t *row = asyncWrite.row;
+
+  if (asyncWrite.fast)
+  {
+    asyncWrite.fast = false;
+    restoreDataCache(asyncWrite.dataCacheOn);
+    if (errors & FLASH_SR_PGSERR)
+      fastProgramUnsupported = true;
+    // Fall back to double-words, skipping those that match.
+    asyncWrite.doubleword = errors ? 0 : DOUBLEWORDS_PER_WRITE_BLOCK;
+  }
+  else if (errors)
+  {
+    finishAsyncWrite(-1);
+    return;
+  }
+
+  int i = asyncWrite.doubleword;
+  while (i < DOUBLEWORDS_PER_WRITE_BLOCK && flash[i] == row[i])
+    i++;
+  if (i < DOUBLEWORDS_PER_WRITE_BLOCK)
+  {
+    // As HAL_FLASH_Program() does it, but ended by the interrupt.
+    volatile uint32_t *dest = (volatile uint32_t *)&flash[i];
+    asyncWrite.doubleword = i + 1;
+    SET_BIT(FLASH->CR, FLASH_CR_PG);
+    dest[0] = (uint32_t)row[i];
+    __ISB();
+    dest[1] = (uint32_t)(row[i] >> 32);
+    return;
+  }
+
+  if (memcmp((const void *)asyncWrite.row_adr, row, WRITE_BLOCK_SIZE) != 0)
+  {
+    finishAsyncWrite(-1);
+    return;
+  }
+  asyncWrite.row_adr += WRITE_BLOCK_SIZE;
+  if (asyncWrite.row_adr < asyncWrite.address + asyncWrite.len)
+    startAsyncRow();
+  else
+    finishAsyncWrite(0);
+}
+
+static void finishAsyncWrite(int status)
+{
+  CLEAR_BIT(FLASH->CR, FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+  HAL_FLASH_Lock();
+  asyncWrite.active = false;
+  if (asyncWrite.cb)
+    asyncWrite.cb(status);
+}
+
+/** programRow
+ * Fast-programs the row if it is erased, else (or if that fails) falls back to
+ * double-word programming.  Fast programming isn't tried again after a PGSERR.
+ * @returns true if the row reads back as written.
+ */
+static bool programRow(uint32_t row_adr, const uint64_t *row)
+{
+  if (!fastProgramUnsupported && flash_isErased(row_adr, WRITE_BLOCK_SIZE))
+  {
+    FLASH_WaitForLastOperation(FLASH_TIMEOUT_VALUE);
+    __HAL_FLASH_CLEAR_FLAG(ROW_PROGRAM_ERRORS);
+
+    bool dataCacheOn = bypassDataCache();
+    uint32_t errors = programRowFast(row_adr, row, true);
+    restoreDataCache(dataCacheOn);
+    if (!errors)
+      return memcmp((const void *)row_adr, row, WRITE_BLOCK_SIZE) == 0;
+    __HAL_FLASH_CLEAR_FLAG(errors);
+    if (errors & FLASH_SR_PGSERR)
+      fastProgramUnsupported = true;
+  }
+
+  programRowByDoubleword(row_adr, row);
+  return memcmp((const void *)row_adr, row, WRITE_BLOCK_SIZE) == 0;
+}
+
+/** programRowFast
+ * Constraints of fast programming (reference manual, "Fast programming"):
+ * - The 32 double-words must reach the flash interface within ~20us of each
+ *   other, or MISSERR aborts the row.  So interrupts are masked.
+ * - A read of the bank being programmed silently aborts the row, and this
+ *   code may be programming its own bank (e.g. a bootloader copy).  So this
+ *   runs from RAM and reads only RAM.
+ * - The row must be erased, and HCLK must be at least 8 MHz.
+ * @param wait false to return once the row is loaded, for writes to the other
+ * bank; the end-of-operation interrupt follows.
+ * @returns the FLASH_SR error flags, 0 on success.
+ */
+__attribute__((section(".RamFunc"), noinline))
+static uint32_t programRowFast(uint32_t row_adr, const uint64_t *row,
+                               bool wait)
+{
+  volatile uint32_t *dest = (volatile uint32_t *)row_adr;
+  const uint32_t *src = (const uint32_t *)row;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  SET_BIT(FLASH->CR, FLASH_CR_FSTPG);
+  for (int i = 0; i < 2 * DOUBLEWORDS_PER_WRITE_BLOCK; i++)
+    dest[i] = src[i];
+  if (!wait)
+  {
+    __set_PRIMASK(primask);
+    return 0;
+  }
+  while (READ_BIT(FLASH->SR, FLASH_SR_BSY))
+    ;
+  CLEAR_BIT(FLASH->CR, FLASH_CR_FSTPG);
+  __set_PRIMASK(primask);
+
+  if (READ_BIT(FLASH->SR, FLASH_SR_EOP))
+    WRITE_REG(FLASH->SR, FLASH_SR_EOP);
+  return READ_BIT(FLASH->SR, ROW_PROGRAM_ERRORS);
+}
+
+static void programRowByDoubleword(uint32_t row_adr, const uint64_t *row)
+{
+  const volatile uint64_t *flash = (const volatile uint64_t *)row_adr;
+  for (int i = 0; i < DOUBLEWORDS_PER_WRITE_BLOCK; i++)
+  {
+    // Skips what an aborted fast row already programmed.
+    if (flash[i] != row[i])
+      HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, row_adr + (8 * i), row[i]);
+  }
+}
+
+int fmt_flash_startErase(uint32_t address, uint32_t len)
+{
+  while (fmt_flash_pollWrite() > 0 || fmt_flash_pollErase() > 0)
+    ;
+  if (len == 0)
+    return -1;
+
+  uint32_t end_address = address + len - 1;
+  int start_page = getPageContainingAddress(address);
+  int end_page = getPageContainingAddress(end_address);
+  unsigned bank = getBankContainingAddress(address);
+  if (start_page < 0 || end_page < 0 ||
+      bank != getBankContainingAddress(end_address))
+    return -1;
+
+  HAL_FLASH_Unlock();
+  FLASH_WaitForLastOperation(FLASH_TIMEOUT_VALUE);
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  eraseJob.active = true;
+  eraseJob.start_address = getPageStart(address);
+  eraseJob.end_address = getPageStart(end_address) + FLASH_PAGE_SIZE;
+  eraseJob.bank = bank;
+  eraseJob.nextPage = start_page + 1;
+  eraseJob.endPage = end_page;
+  FLASH_PageErase(start_page, bank); // Sets STRT and returns.
+  return 0;
+}
+
+int fmt_flash_pollErase(void)
+{
+  if (!eraseJob.active)
+    return 0;
+  if (READ_BIT(FLASH->SR, FLASH_SR_BSY))
+    return 1;
+
+  CLEAR_BIT(FLASH->CR, (FLASH_CR_PER | FLASH_CR_PNB));
+  if (READ_BIT(FLASH->SR, FLASH_SR_EOP))
+    WRITE_REG(FLASH->SR, FLASH_SR_EOP);
+  uint32_t errors = READ_BIT(FLASH->SR, FLASH_FLAG_ALL_ERRORS);
+
+  if (!errors && eraseJob.nextPage <= eraseJob.endPage)
+  {
+    FLASH_PageErase(eraseJob.nextPage++, eraseJob.bank);
+    return 1;
+  }
+
+  eraseJob.active = false;
+  __HAL_FLASH_CLEAR_FLAG(errors);
+  flushDataCache(); // It may still hold what was erased.
+  HAL_FLASH_Lock();
+  if (errors)
+    return -1;
+  flash_markErased(eraseJob.start_address,
+                   eraseJob.end_address - eraseJob.start_address);
+  return 0;
+}
+
+static uint32_t getPageStart(uint32_t address)
+{
+  return address - ((address - FLASH_BASE) % FLASH_PAGE_SIZE);
+}
+
+/** Flash reads that check a program operation must not come from the data
+ * cache.  @returns whether it was on. */
+static bool bypassDataCache(void)
+{
+  bool dataCacheOn = READ_BIT(FLASH->ACR, FLASH_ACR_DCEN);
+  if (dataCacheOn)
+    __HAL_FLASH_DATA_CACHE_DISABLE();
+  return dataCacheOn;
+}
+
+static void restoreDataCache(bool dataCacheOn)
+{
+  if (dataCacheOn)
+  {
+    __HAL_FLASH_DATA_CACHE_RESET();
+    __HAL_FLASH_DATA_CACHE_ENABLE();
+  }
+}
+
+static void flushDataCache(void)
+{
+  if (READ_BIT(FLASH->ACR, FLASH_ACR_DCEN))
+  {
+    __HAL_FLASH_DATA_CACHE_DISABLE();
+    __HAL_FLASH_DATA_CACHE_RESET();
+    __HAL_FLASH_DATA_CACHE_ENABLE();
+  }
+}
+
 static int flash_erase(uint32_t start_address, uint32_t len)
 {
   uint32_t end_address = start_address + len - 1;
@@ -125,7 +470,10 @@ static int flash_erase(uint32_t start_address, uint32_t len)
       .Page = start_page, // is page zero at bottom of this bank, or absolute number?
   };
   uint32_t pageError = FLASH_ERROR_NONE; // check this.
-  HAL_FLASHEx_Erase(&eraseInit, &pageError);
+  if (HAL_FLASHEx_Erase(&eraseInit, &pageError) == HAL_OK)
+    flash_markErased(getPageStart(start_address),
+                     getPageStart(end_address) + FLASH_PAGE_SIZE -
+                         getPageStart(start_address));
 
   return 0;
 }
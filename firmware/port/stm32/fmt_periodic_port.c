@@ -1,26 +1,44 @@
-
-#include <fmt_periodic.h>
-#include <timer_pcbDetails.h>
-
 #define HAL_BASE_ENABLED
+#define HAL_RCC_ENABLED
 #define HAL_TIM_ENABLED
+#include <fmt_periodic_port.h>
+#include <timer_pcbDetails.h>
 #include <stm32_hal_dispatch.h> // NVIC
 
+#define TIMER_COUNT (sizeof(timerConfigs) / sizeof(timerResource_t))
+#define PERIOD_MAX_16B 0x10000U
+#define PRESCALER_MAX 0x10000U // PSC is 16 bits.
 
 const timerResource_t timerConfigs[] = AVAILABLE_TIMERS;
+static periodicTimer_t timers[TIMER_COUNT];
 
-bool enableTimerAndStoreCallback(IRQn_Type irqNumber, callback_t callback);
+bool enableTimerAndStoreCallback(IRQn_Type irqNumber, periodicTimer_t *timer);
 
 bool fmt_initPeriodic(
     uint8_t timerId, uint32_t intervalUs, uint32_t priority, callback_t callback)
 {
-  if (timerId >= sizeof(timerConfigs) / sizeof(timerResource_t))
+  if (timerId >= TIMER_COUNT)
     return false;
 
   timerResource_t timer = timerConfigs[timerId];
 
-  // Store the supplied callback, associating to the correct IRQ handler.
-  bool success = enableTimerAndStoreCallback(timer.irqNumber, callback);
+  // The finest period resolution the counter's width allows.
+  uint32_t clockHz = port_timerClockHz(timer.base);
+  uint32_t periodMax =
+      IS_TIM_32B_COUNTER_INSTANCE(timer.base) ? UINT32_MAX : PERIOD_MAX_16B;
+  timerDivide_t divide;
+  if (!fmt_periodic_divide(clockHz, intervalUs, periodMax, PRESCALER_MAX,
+                           false, &divide))
+    return false;
+
+  timers[timerId] = (periodicTimer_t){
+      .callback = callback,
+      .clockHz = clockHz,
+      .divide = divide,
+      .minLatency = UINT32_MAX};
+
+  // Associate the timer's state with the correct IRQ handler.
+  bool success = enableTimerAndStoreCallback(timer.irqNumber, &timers[timerId]);
   if (!success)
     return false;
 
@@ -28,9 +46,9 @@ bool fmt_initPeriodic(
       .Instance = timer.base,
       .Channel = HAL_TIM_ACTIVE_CHANNEL_1,
       .Init = {
-          .Prescaler = (8 - 1), // (80 MHz) / 8 = 10MHz
+          .Prescaler = divide.prescaler - 1,
           .CounterMode = TIM_COUNTERMODE_UP,
-          .Period = (10000 - 1), // 10MHz / 10k = 1kHz
+          .Period = divide.period - 1,
           .ClockDivision = TIM_CLOCKDIVISION_DIV1,
           .AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE,
       },
@@ -65,14 +83,27 @@ bool fmt_initPeriodic(
   return true;
 }
 
-#define TIM_IRQ_HANDLER(n)                                    \
-  callback_t TIM##n##_callback = NULL;                        \
-  void TIM##n##_IRQHandler(void);                             \
-  void TIM##n##_IRQHandler(void)                              \
-  {                                                           \
-    if (TIM##n##_callback)                                    \
-      TIM##n##_callback();                                    \
-    TIM##n->SR = ~TIM_FLAG_UPDATE; /*clear the update flag.*/ \
+periodicTimer_t *port_getPeriodicTimer(uint8_t timerId)
+{
+  return timerId < TIMER_COUNT ? &timers[timerId] : NULL;
+}
+
+/* CNT counts up from 0 at the update event, so reading it first thing is the
+ISR's entry latency.  The update flag is cleared before the callback, so if it's
+set again after, the next tick came while the callback ran. */
+#define TIM_IRQ_HANDLER(n)                                                     \
+  static periodicTimer_t *TIM##n##_timer = NULL;                               \
+  void TIM##n##_IRQHandler(void);                                              \
+  void TIM##n##_IRQHandler(void)                                               \
+  {                                                                            \
+    uint32_t latency = TIM##n->CNT;                                            \
+    TIM##n->SR = ~TIM_FLAG_UPDATE; /*clear the update flag.*/                  \
+    if (TIM##n##_timer)                                                        \
+    {                                                                          \
+      fmt_periodic_tick(TIM##n##_timer, latency);                              \
+      if (TIM##n->SR & TIM_FLAG_UPDATE)                                        \
+        TIM##n##_timer->overruns++;                                            \
+    }                                                                          \
   }
 
 #if PERIODIC_USES_TIM2
@@ -97,11 +128,11 @@ TIM_IRQ_HANDLER(5)
 
 #define ENABLE_AND_STORE_CALLBACK(n) \
   case TIM##n##_IRQn:                \
-    TIM##n##_callback = callback;    \
+    TIM##n##_timer = timer;          \
     __HAL_RCC_TIM##n##_CLK_ENABLE(); \
     break;
 
-bool enableTimerAndStoreCallback(IRQn_Type irqNumber, callback_t callback)
+bool enableTimerAndStoreCallback(IRQn_Type irqNumber, periodicTimer_t *timer)
 {
   switch (irqNumber)
   {
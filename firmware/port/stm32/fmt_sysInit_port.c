@@ -1,4 +1,5 @@
 #include <fmt_sysInit.h>
+#include <cycles_port.h>
 
 #define HAL_BASE_ENABLED
 #define HAL_RCC_ENABLED
@@ -13,6 +14,7 @@ void fmt_initSys(void)
 {
   HAL_Init();
   SystemClock_Config();
+  port_initCycleCounter(); // ISRs may be profiled before fmt_sched_start().
 }
 
 void SystemClock_Config(void)
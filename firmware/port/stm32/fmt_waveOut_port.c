@@ -0,0 +1,166 @@
+#include <fmt_waveOut.h>
+#include <fmt_gpio_port.h> // port_initWaveOutPin()
+#include <timer_pcbDetails.h>
+
+#ifndef FMT_USES_WAVE_OUT
+#error "ENABLE_WAVE_OUT requires FMT_USES_WAVE_OUT in timer_pcbDetails.h"
+#endif
+
+#define MAX_PRESCALER 0x10000UL
+
+static TIM_HandleTypeDef htim;
+static DMA_HandleTypeDef hdma;
+static int16_t *samples = NULL;
+static uint32_t samplesPerBlock = 0;
+static blockCallback_t fillBlock = NULL;
+static uint32_t fullScale = 0;
+
+static void enableClocks(void);
+
+static void firstHalfSent(DMA_HandleTypeDef *dma)
+{
+  (void)dma;
+  fillBlock(samples, samplesPerBlock);
+}
+
+static void secondHalfSent(DMA_HandleTypeDef *dma)
+{
+  (void)dma;
+  fillBlock(samples + samplesPerBlock, samplesPerBlock);
+}
+
+bool fmt_initWaveOut(uint32_t intervalUs, uint32_t priority,
+                     int16_t *buffer, uint32_t blockLen, blockCallback_t fill)
+{
+  // Samples are int16: the full scale (100% duty) must be at most INT16_MAX.
+  uint32_t clockHz = port_timerClockHz(FMT_WAVE_OUT_TIMER);
+  uint64_t ticks = (uint64_t)(clockHz / 1000000U) * intervalUs;
+  uint32_t prescaler = (uint32_t)((ticks + INT16_MAX - 1) / INT16_MAX);
+  if (prescaler == 0 || prescaler > MAX_PRESCALER || !buffer ||
+      blockLen == 0 || !fill)
+    return false;
+
+  samples = buffer;
+  samplesPerBlock = blockLen;
+  fillBlock = fill;
+  fullScale = (uint32_t)(ticks / prescaler);
+
+  enableClocks();
+  port_initWaveOutPin();
+
+  htim = (TIM_HandleTypeDef){
+      .Instance = FMT_WAVE_OUT_TIMER,
+      .Init = {
+          .Prescaler = prescaler - 1,
+          .CounterMode = TIM_COUNTERMODE_UP,
+          .Period = fullScale - 1,
+          .ClockDivision = TIM_CLOCKDIVISION_DIV1,
+          .AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE,
+      },
+  };
+  if (HAL_TIM_PWM_Init(&htim) != HAL_OK)
+    return false;
+
+  // Preload means a sample written by DMA takes effect on the next update.
+  TIM_OC_InitTypeDef pwm = {
+      .OCMode = TIM_OCMODE_PWM1,
+      .Pulse = 0,
+      .OCPolarity = TIM_OCPOLARITY_HIGH,
+      .OCFastMode = TIM_OCFAST_DISABLE,
+  };
+  if (HAL_TIM_PWM_ConfigChannel(&htim, &pwm, FMT_WAVE_OUT_CHANNEL) != HAL_OK)
+    return false;
+
+  hdma = (DMA_HandleTypeDef){
+      .Instance = FMT_WAVE_OUT_DMA,
+      .Init = {
+          .Request = FMT_WAVE_OUT_DMA_REQUEST, // the timer's update request.
+          .Direction = DMA_MEMORY_TO_PERIPH,
+          .PeriphInc = DMA_PINC_DISABLE,
+          .MemInc = DMA_MINC_ENABLE,
+          .PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD,
+          .MemDataAlignment = DMA_MDATAALIGN_HALFWORD,
+          .Mode = DMA_CIRCULAR,
+          .Priority = DMA_PRIORITY_HIGH,
+      },
+  };
+  if (HAL_DMA_Init(&hdma) != HAL_OK)
+    return false;
+  hdma.XferHalfCpltCallback = firstHalfSent;
+  hdma.XferCpltCallback = secondHalfSent;
+
+  fill(samples, 2 * blockLen);
+
+  HAL_NVIC_SetPriority(FMT_WAVE_OUT_DMA_IRQn, priority, 0);
+  HAL_NVIC_EnableIRQ(FMT_WAVE_OUT_DMA_IRQn);
+
+  // CCR1..CCR4 are consecutive, and TIM_CHANNEL_n is 4 * (n - 1).
+  volatile uint32_t *ccr =
+      &FMT_WAVE_OUT_TIMER->CCR1 + (FMT_WAVE_OUT_CHANNEL / 4U);
+  if (HAL_DMA_Start_IT(&hdma, (uint32_t)samples, (uint32_t)ccr,
+                       2 * blockLen) != HAL_OK)
+    return false;
+
+  __HAL_TIM_ENABLE_DMA(&htim, TIM_DMA_UPDATE);
+  return HAL_TIM_PWM_Start(&htim, FMT_WAVE_OUT_CHANNEL) == HAL_OK;
+}
+
+uint32_t fmt_getWaveOutFullScale(void)
+{
+  return fullScale;
+}
+
+void FMT_WAVE_OUT_DMA_IRQ_HANDLER(void);
+void FMT_WAVE_OUT_DMA_IRQ_HANDLER(void)
+{
+  HAL_DMA_IRQHandler(&hdma);
+}
+
+#define CASE_TIM_CLK(n)            \
+  case (uint32_t)TIM##n:             \
+    __HAL_RCC_TIM##n##_CLK_ENABLE(); \
+    break;
+
+void enableClocks(void)
+{
+  switch ((uint32_t)FMT_WAVE_OUT_TIMER)
+  {
+#ifdef TIM1
+    CASE_TIM_CLK(1)
+#endif
+#ifdef TIM2
+    CASE_TIM_CLK(2)
+#endif
+#ifdef TIM3
+    CASE_TIM_CLK(3)
+#endif
+#ifdef TIM4
+    CASE_TIM_CLK(4)
+#endif
+#ifdef TIM5
+    CASE_TIM_CLK(5)
+#endif
+#ifdef TIM8
+    CASE_TIM_CLK(8)
+#endif
+#ifdef TIM15
+    CASE_TIM_CLK(15)
+#endif
+#ifdef TIM16
+    CASE_TIM_CLK(16)
+#endif
+#ifdef TIM17
+    CASE_TIM_CLK(17)
+#endif
+  }
+
+#ifdef DMA2
+  if ((uint32_t)FMT_WAVE_OUT_DMA >= (uint32_t)DMA2_Channel1)
+    __HAL_RCC_DMA2_CLK_ENABLE();
+  else
+#endif
+    __HAL_RCC_DMA1_CLK_ENABLE();
+#ifdef __HAL_RCC_DMAMUX1_CLK_ENABLE
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+#endif
+}
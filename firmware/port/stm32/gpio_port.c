@@ -2,6 +2,7 @@
 #define HAL_RCC_ENABLED
 #include <fmt_gpio_port.h>
 #include <comm_pcbDetails.h>
+#include <timer_pcbDetails.h> // FMT_USES_WAVE_OUT
 #define USE_FULL_ASSERT
 #include <stm32_hal_dispatch.h>
 
@@ -119,22 +120,17 @@ void port_initUartPins(void)
 }
 #endif
 
-uint32_t port_readPort(void *const port)
+#ifdef FMT_USES_WAVE_OUT
+void port_initWaveOutPin(void)
 {
-  return ((GPIO_TypeDef *)port)->IDR;
+  GPIO_InitTypeDef config = {
+      .Pin = FMT_WAVE_OUT_GPIO_Pin,
+      .Mode = GPIO_MODE_AF_PP,
+      .Pull = GPIO_NOPULL,
+      .Speed = GPIO_SPEED_FREQ_VERY_HIGH,
+      .Alternate = FMT_WAVE_OUT_GPIO_AF,
+  };
+  enableRelevantClock((uint32_t)FMT_WAVE_OUT_GPIOx);
+  HAL_GPIO_Init((GPIO_TypeDef *)FMT_WAVE_OUT_GPIOx, &config);
 }
-
-/** set pin
- * @note pin is a uint_fast8 because setting a pin should be performant.
- */
-void port_setPin(void *const port, uint_fast8_t pin, outLevel_t level)
-{
-  if (level == OUTPUT_TOGGLE)
-  {
-    HAL_GPIO_TogglePin((GPIO_TypeDef *)port, (0x1 << pin));
-  }
-  else
-  {
-    HAL_GPIO_WritePin((GPIO_TypeDef *)port, (0x1 << pin), (GPIO_PinState)level);
-  }
-}
\ No newline at end of file
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#include <gpio_mcuDetails.h> // GPIO_TypeDef
+#include <stdbool.h>
+#include <stdint.h>
+
+/** A resolved pin: its port's registers and its mask.  See fmt_getPin(). */
+typedef struct
+{
+  GPIO_TypeDef *port;
+  uint32_t mask;
+} fmt_pin_t;
+
+static inline fmt_pin_t port_getPin(void *const port, uint8_t pin)
+{
+  fmt_pin_t handle = {(GPIO_TypeDef *)port, 1U << pin};
+  return handle;
+}
+
+static inline void port_pinHigh(fmt_pin_t pin)
+{
+  pin.port->BSRR = pin.mask;
+}
+
+static inline void port_pinLow(fmt_pin_t pin)
+{
+  pin.port->BRR = pin.mask;
+}
+
+/** Sets or resets in one BSRR store, so an ISR changing another pin of the
+ * port between the ODR read and the store isn't undone. */
+static inline void port_pinToggle(fmt_pin_t pin)
+{
+  uint32_t odr = pin.port->ODR;
+  pin.port->BSRR = ((odr & pin.mask) << 16) | (~odr & pin.mask);
+}
+
+static inline bool port_pinRead(fmt_pin_t pin)
+{
+  return (pin.port->IDR & pin.mask) != 0;
+}
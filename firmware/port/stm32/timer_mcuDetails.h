@@ -15,6 +15,7 @@
 
 #define HAL_BASE_ENABLED
 #define HAL_DMA_ENABLED
+#define HAL_RCC_ENABLED
 #define HAL_TIM_ENABLED
 #include <stm32_hal_dispatch.h>
 
@@ -24,4 +25,19 @@ typedef struct timerResource_s {
   IRQn_Type irqNumber;
 } timerResource_t;
 
+/** A timer's counter clock: its APB clock, doubled when that APB's prescaler
+ * isn't 1.  TIM1/8/15/16/17 are on APB2, the others on APB1. */
+static inline uint32_t port_timerClockHz(const TIM_TypeDef *timer)
+{
+  if ((uintptr_t)timer >= APB2PERIPH_BASE)
+  {
+    uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE2) == RCC_CFGR_PPRE2_DIV1) ? pclk2
+                                                                  : 2U * pclk2;
+  }
+  uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+  return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1
+                                                                : 2U * pclk1;
+}
+
 #endif // timer_mcuDetails_h
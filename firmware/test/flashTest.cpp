@@ -0,0 +1,64 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_flash.h>
+#include <fmt_flash_port.h>
+}
+#include <string.h>
+
+// Clear of the partitions other tests use.
+#define SECTOR_ADDRESS 0x0C0C0000U
+#define SECTOR_SIZE 0x4000U
+
+TEST_GROUP(flash_common)
+{
+  uint8_t row[WRITE_BLOCK_SIZE];
+  void setup()
+  {
+    memset(row, 0xA5, sizeof(row));
+    fmt_flash_startErase(SECTOR_ADDRESS, SECTOR_SIZE);
+  }
+};
+
+TEST(flash_common, erasedSector_readsErased)
+{
+  CHECK_TRUE(flash_isErased(SECTOR_ADDRESS, SECTOR_SIZE));
+}
+
+TEST(flash_common, write_rowsNoLongerErased)
+{
+  fmt_flash_write(SECTOR_ADDRESS, row, sizeof(row));
+  CHECK_FALSE(flash_isErased(SECTOR_ADDRESS, WRITE_BLOCK_SIZE));
+  CHECK_FALSE(flash_isErased(SECTOR_ADDRESS, SECTOR_SIZE));
+  CHECK_TRUE(flash_isErased(SECTOR_ADDRESS + WRITE_BLOCK_SIZE,
+                            SECTOR_SIZE - WRITE_BLOCK_SIZE));
+}
+
+TEST(flash_common, partialRowWrite_wholeRowNoLongerErased)
+{
+  fmt_flash_write(SECTOR_ADDRESS + 8, row, 4);
+  CHECK_FALSE(flash_isErased(SECTOR_ADDRESS, WRITE_BLOCK_SIZE));
+}
+
+TEST(flash_common, scanBeforeProgramming_notRecordedAsErased)
+{
+  // Ports mark a row written, then scan it (eg. to pick fast programming)
+  // before it's programmed.
+  flash_markWritten(SECTOR_ADDRESS, WRITE_BLOCK_SIZE);
+  CHECK_TRUE(flash_isErased(SECTOR_ADDRESS, WRITE_BLOCK_SIZE));
+  uint8_t *flash = const_cast<uint8_t *>(mock_flashPointer(SECTOR_ADDRESS));
+  memcpy(flash, row, sizeof(row));
+
+  CHECK_FALSE(flash_isErased(SECTOR_ADDRESS, WRITE_BLOCK_SIZE));
+  CHECK_FALSE(flash_isErased(SECTOR_ADDRESS, SECTOR_SIZE));
+}
+
+TEST(flash_common, read_returnsWrittenData)
+{
+  fmt_flash_write(SECTOR_ADDRESS + 3, row, 5);
+  uint8_t readBack[8];
+  fmt_flash_read(SECTOR_ADDRESS, readBack, sizeof(readBack));
+  const uint8_t expected[8] = {0xFF, 0xFF, 0xFF, 0xA5, 0xA5, 0xA5, 0xA5, 0xA5};
+  MEMCMP_EQUAL(expected, readBack, sizeof(expected));
+}
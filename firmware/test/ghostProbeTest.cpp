@@ -0,0 +1,184 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <ghostProbe.h>
+#include <fmt_log.h>   // fmt_drainLog()
+#include <fmt_sizes.h> // LOG_RING_LENGTH
+#include "stub_comms.h"
+}
+
+#define PERIODIC_FREQ_HZ 100U
+
+static float negate(volatile void *rawValue)
+{
+  return -*(volatile float *)rawValue;
+}
+
+TEST_GROUP(ghostProbe)
+{
+  float chanA = 1.5F;
+  int16_t chanB = -7;
+  RunScanCtl scanCtl;
+  Top msgSent;
+
+  void setup()
+  {
+    UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
+    UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
+    UT_PTR_SET(fmt_getSendSpace, fmt_getSendSpace_test);
+
+    gp_init(PERIODIC_FREQ_HZ);
+    gp_initTestPoint(TestPointId_CHAN_A, &chanA, SRC_TYPE_FLOAT, NULL);
+    gp_initTestPoint(TestPointId_CHAN_B, &chanB, SRC_TYPE_INT16, NULL);
+
+    // Scan on every gp_periodic() call.
+    scanCtl = (RunScanCtl){.freq = (SampleFreq)PERIODIC_FREQ_HZ};
+    msgSent = (Top){0};
+  }
+
+  void teardown()
+  {
+    // Stop scanning so other tests don't see probe traffic.
+    handleRunScanCtl((RunScanCtl){.freq = SampleFreq_SCAN_DISABLED});
+    for (uint32_t i = 0; i < LOG_RING_LENGTH; i++)
+      fmt_drainLog();
+    fmt_sendMsg((Top){0});
+  }
+
+  void addProbe(TestPointId id)
+  {
+    scanCtl.probes[scanCtl.probes_count++] = id;
+  }
+
+  ProbeSignals scanOnce(void)
+  {
+    handleRunScanCtl(scanCtl);
+    gp_periodic();
+    fmt_getMsg(&msgSent);
+    ENUMS_EQUAL_INT(Top_ProbeSignals_tag, msgSent.which_sub);
+    return msgSent.sub.ProbeSignals;
+  }
+};
+
+TEST(ghostProbe, singleProbe_sendsValue)
+{
+  addProbe(TestPointId_CHAN_A);
+  ProbeSignals signals = scanOnce();
+
+  LONGS_EQUAL(1, signals.probeSignals_count);
+  LONGS_EQUAL(0, signals.remaining);
+  ENUMS_EQUAL_INT(TestPointId_CHAN_A, signals.probeSignals[0].id);
+  DOUBLES_EQUAL(chanA, signals.probeSignals[0].value, 0.0);
+}
+
+TEST(ghostProbe, intTestPoint_convertedToFloat)
+{
+  addProbe(TestPointId_CHAN_B);
+  ProbeSignals signals = scanOnce();
+
+  DOUBLES_EQUAL(chanB, signals.probeSignals[0].value, 0.0);
+}
+
+TEST(ghostProbe, converter_overridesSrcType)
+{
+  gp_initTestPoint(TestPointId_CHAN_A_INV, &chanA, SRC_TYPE_INT8, negate);
+  addProbe(TestPointId_CHAN_A_INV);
+  ProbeSignals signals = scanOnce();
+
+  DOUBLES_EQUAL(-chanA, signals.probeSignals[0].value, 0.0);
+}
+
+TEST(ghostProbe, valueReadAtSampleTime_notScanStart)
+{
+  addProbe(TestPointId_CHAN_A);
+  handleRunScanCtl(scanCtl);
+  chanA = 42.0F;
+  gp_periodic();
+  fmt_getMsg(&msgSent);
+
+  DOUBLES_EQUAL(42.0F, msgSent.sub.ProbeSignals.probeSignals[0].value, 0.0);
+}
+
+TEST(ghostProbe, unregisteredTestPoint_skipped)
+{
+  addProbe(TestPointId_CHAN_A_PLUS);
+  addProbe(TestPointId_CHAN_A);
+  ProbeSignals signals = scanOnce();
+
+  LONGS_EQUAL(1, signals.probeSignals_count);
+  ENUMS_EQUAL_INT(TestPointId_CHAN_A, signals.probeSignals[0].id);
+}
+
+TEST(ghostProbe, initTestPoint_badType_fails)
+{
+  CHECK_FALSE(gp_initTestPoint(
+      TestPointId_CHAN_A_PLUS, &chanA, (srcType_t)100, NULL));
+}
+
+TEST(ghostProbe, disconnectedProbes_skipped)
+{
+  addProbe(TestPointId_DISCONNECTED);
+  addProbe(TestPointId_CHAN_B);
+  addProbe(TestPointId_DISCONNECTED);
+  ProbeSignals signals = scanOnce();
+
+  LONGS_EQUAL(1, signals.probeSignals_count);
+  ENUMS_EQUAL_INT(TestPointId_CHAN_B, signals.probeSignals[0].id);
+}
+
+TEST(ghostProbe, maxProbes_splitAcrossMessages)
+{
+  const unsigned maxProbes = sizeof(scanCtl.probes) / sizeof(TestPointId);
+  const unsigned perMsg =
+      sizeof(msgSent.sub.ProbeSignals.probeSignals) / sizeof(ProbeSignal);
+  while (scanCtl.probes_count < maxProbes)
+    addProbe(TestPointId_CHAN_A);
+
+  // stub_comms keeps only the last message sent: the tail of the sample.
+  ProbeSignals signals = scanOnce();
+
+  unsigned expectedLast = maxProbes % perMsg ? maxProbes % perMsg : perMsg;
+  LONGS_EQUAL(expectedLast, signals.probeSignals_count);
+  LONGS_EQUAL(0, signals.remaining);
+  LONGS_EQUAL(maxProbes - expectedLast, signals.first);
+}
+
+/* The host build has no linker-provided probe window, so every address is
+rejected.  On-target acceptance depends on the project's linker script. */
+TEST(ghostProbe, addrScan_outsideWindow_logsAndStopsScan)
+{
+  addProbe(TestPointId_CHAN_A);
+  handleRunScanCtl(scanCtl);
+
+  RunAddrScan addrScan = {
+      .freq = (SampleFreq)PERIODIC_FREQ_HZ,
+      .addresses_count = 1,
+      .addresses = {0x20000000},
+      .types_count = 1,
+      .types = {ProbeSrcType_SRC_FLOAT}};
+  handleRunAddrScan(addrScan);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_Log_tag, msgSent.which_sub);
+
+  // The previous test-point scan no longer runs.
+  fmt_sendMsg((Top){0});
+  gp_periodic();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(0, msgSent.which_sub);
+}
+
+TEST(ghostProbe, addrScan_typesCountMismatch_logs)
+{
+  RunAddrScan addrScan = {
+      .freq = (SampleFreq)PERIODIC_FREQ_HZ,
+      .addresses_count = 2,
+      .addresses = {0x20000000, 0x20000004},
+      .types_count = 1,
+      .types = {ProbeSrcType_SRC_FLOAT}};
+  handleRunAddrScan(addrScan);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_Log_tag, msgSent.which_sub);
+}
@@ -35,4 +35,51 @@ TEST(fmt_gpio, initGpioOutPin)
 TEST(fmt_gpio, initGpioOutPin_pinIdUnavailable_fails)
 {
   CHECK_FALSE(fmt_initGpioOutPin(255, OUTPUT_MODE_PUSH_PULL));
-}
\ No newline at end of file
+}
+
+TEST(fmt_gpio, getPin_pinIdUnavailable_fails)
+{
+  fmt_pin_t pin;
+  CHECK_FALSE(fmt_getPin(255, &pin));
+}
+
+TEST(fmt_gpio, pinHighLowToggle_setsOnlyItsBit)
+{
+  fmt_pin_t pin;
+  CHECK_TRUE(fmt_getPin(LED_0_PIN_ID, &pin)); // P5_8
+  hostGpioOut[5] = 0;
+
+  fmt_pinHigh(pin);
+  CHECK_EQUAL(1U << 8, hostGpioOut[5]);
+  fmt_pinToggle(pin);
+  CHECK_EQUAL(0, hostGpioOut[5]);
+  fmt_pinToggle(pin);
+  CHECK_EQUAL(1U << 8, hostGpioOut[5]);
+  hostGpioOut[5] |= 1U << 9;
+  fmt_pinLow(pin);
+  CHECK_EQUAL(1U << 9, hostGpioOut[5]);
+}
+
+TEST(fmt_gpio, pinRead_followsInput)
+{
+  fmt_pin_t pin;
+  fmt_getPin(LED_0_PIN_ID, &pin);
+  hostGpioIn[5] = ~(1U << 8);
+  CHECK_FALSE(fmt_pinRead(pin));
+  hostGpioIn[5] = 1U << 8;
+  CHECK_TRUE(fmt_pinRead(pin));
+}
+
+TEST(fmt_gpio, setPinAndReadPin_byPinId)
+{
+  hostGpioOut[5] = 0;
+  CHECK_TRUE(fmt_setPin(LED_0_PIN_ID, OUTPUT_HIGH));
+  CHECK_EQUAL(1U << 8, hostGpioOut[5]);
+  CHECK_TRUE(fmt_setPin(LED_0_PIN_ID, OUTPUT_TOGGLE));
+  CHECK_EQUAL(0, hostGpioOut[5]);
+  CHECK_FALSE(fmt_setPin(255, OUTPUT_HIGH));
+
+  hostGpioIn[5] = 1U << 8;
+  CHECK_TRUE(fmt_readPin(LED_0_PIN_ID));
+  CHECK_FALSE(fmt_readPin(255));
+}
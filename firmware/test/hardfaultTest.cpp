@@ -0,0 +1,81 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_hardfault.h>
+#include <fmt_log.h>
+#include <fmt_sizes.h>
+#include "stub_comms.h"
+}
+
+#define MAX_SENT 16
+
+static Top sent[MAX_SENT];
+static uint32_t numSent;
+
+static bool fmt_sendMsg_spy(Top message)
+{
+  if (numSent < MAX_SENT)
+    sent[numSent] = message;
+  numSent++;
+  return true;
+}
+
+TEST_GROUP(fmt_hardfault)
+{
+  void setup()
+  {
+    UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_spy);
+    UT_PTR_SET(fmt_getSendSpace, fmt_getSendSpace_test);
+    numSent = 0;
+    fmt_setLogLevel(LOG_VERBOSE);
+  }
+};
+
+TEST(fmt_hardfault, noFault_nothingSent)
+{
+  CHECK_FALSE(fmt_sendCrashReport());
+  LONGS_EQUAL(0, numSent);
+}
+
+/* On the host the handlers capture a fake frame and return instead of
+resetting. */
+TEST(fmt_hardfault, fault_reportedOnceAfterReset)
+{
+  fmt_sendLog(LOG_ERROR, "before fault", 1);
+  BusFault_Handler();
+
+  CHECK(fmt_sendCrashReport());
+  ENUMS_EQUAL_INT(Top_CrashReport_tag, sent[0].which_sub);
+  ENUMS_EQUAL_INT(FaultType_FAULT_BUS, sent[0].sub.CrashReport.faultType);
+
+  // The stack slice follows, 8 words per message.
+  ENUMS_EQUAL_INT(Top_CrashStack_tag, sent[1].which_sub);
+  LONGS_EQUAL(0, sent[1].sub.CrashStack.offset);
+  LONGS_EQUAL(8, sent[1].sub.CrashStack.words_count);
+
+  // Then the logs saved at the fault, newest last.
+  uint32_t lastSent = numSent - 1;
+  ENUMS_EQUAL_INT(Top_Log_tag, sent[lastSent].which_sub);
+  STRCMP_EQUAL("before fault", sent[lastSent].sub.Log.text);
+
+  numSent = 0;
+  CHECK_FALSE(fmt_sendCrashReport());
+  LONGS_EQUAL(0, numSent);
+
+  // Don't leave the log in the ring for other tests.
+  for (uint32_t i = 0; i < LOG_RING_LENGTH; i++)
+    fmt_drainLog();
+}
+
+TEST(fmt_hardfault, threadStackFault_onlyFrameSaved)
+{
+  // The end of a PSP stack isn't known: words past the frame aren't read.
+  uint32_t frame[2 * CRASH_STACK_WORDS] = {0};
+  fmt_captureFault(frame, 0xFFFFFFFDU, FaultType_FAULT_USAGE);
+
+  CHECK(fmt_sendCrashReport());
+  ENUMS_EQUAL_INT(Top_CrashStack_tag, sent[1].which_sub);
+  LONGS_EQUAL(8, sent[1].sub.CrashStack.words_count);
+  CHECK(numSent < 3 || sent[2].which_sub != Top_CrashStack_tag);
+}
@@ -0,0 +1,18 @@
+#include "logCalls.h"
+
+void test_logNoArgs(void)
+{
+  FMT_LOG(LOG_INFO, "no args");
+}
+
+void test_logOneArg(int value)
+{
+  FMT_LOG(LOG_INFO, "one arg %d", value);
+}
+
+void test_logMaxArgs(int count, float seconds, const void *address,
+                     double ratio)
+{
+  FMT_LOG(LOG_WARN, "%d at %f from %p ratio %g", count, seconds, address,
+          ratio);
+}
@@ -0,0 +1,7 @@
+#include <fmt_log.h>
+
+// FMT_LOG() relies on C11 _Generic, so the calls under test are made from C.
+void test_logNoArgs(void);
+void test_logOneArg(int value);
+void test_logMaxArgs(int count, float seconds, const void *address,
+                     double ratio);
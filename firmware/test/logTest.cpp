@@ -3,8 +3,11 @@
 extern "C"
 {
 #include <fmt_log.h>
+#include <fmt_sizes.h>
 #include "stub_comms.h"
+#include "logCalls.h"
 }
+#include <string.h>
 
 TEST_GROUP(fmt_log)
 {
@@ -21,16 +24,24 @@ TEST_GROUP(fmt_log)
     fmt_setLogLevel(LOG_VERBOSE);
     UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
     UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
+    UT_PTR_SET(fmt_getSendSpace, fmt_getSendSpace_test);
+    test_setSendSpace(SEND_QUEUE_LENGTH);
   }
 
   void teardown()
   {
+    // Empty the log ring so logs don't carry over to other tests.
+    test_setSendSpace(SEND_QUEUE_LENGTH);
+    for (uint32_t i = 0; i < LOG_RING_LENGTH; i++)
+      fmt_drainLog();
+    fmt_setLogRateLimit(0, 0, 0);
     msgSent = (Top){0};
     fmt_sendMsg(msgSent); // clear the stored message.
   }
 
   void checkSentEqualsInput(void)
   {
+    fmt_drainLog();
     fmt_getMsg(&msgSent);
     ENUMS_EQUAL_INT(Top_Log_tag, msgSent.which_sub);
     STRCMP_EQUAL(textIn, msgSent.sub.Log.text);
@@ -39,6 +50,7 @@ TEST_GROUP(fmt_log)
 
   void checkLogNotSent(void)
   {
+    fmt_drainLog();
     fmt_getMsg(&msgSent);
     // msgSent having sub type 0 indicates no log was sent.
     ENUMS_EQUAL_INT(0, msgSent.which_sub);
@@ -69,6 +81,7 @@ TEST(fmt_log, sendLog_msgNull)
   // Log still sends what it can (the number) if the text is NULL.
   textIn = NULL;
   fmt_sendLog(LOG_VERBOSE, textIn, numIn);
+  fmt_drainLog();
   fmt_getMsg(&msgSent);
   LONGS_EQUAL(numIn, msgSent.sub.Log.value);
   ENUMS_EQUAL_INT(Top_Log_tag, msgSent.which_sub);
@@ -94,3 +107,249 @@ TEST(fmt_log, sendLog_levelEqualActive)
   fmt_sendLog(LOG_INFO, textIn, numIn);
   checkSentEqualsInput();
 }
+
+TEST(fmt_log, sendLogFmt_msgWellFormed)
+{
+  // Only the address is used, so any pointer stands in for a string in the
+  // (unloaded) .fmt_log_strings section.
+  const char *format = (const char *)(uintptr_t)0x12345678;
+  const uint32_t args[] = {7, 0xFFFFFFFF, fmt_logFloatWord(1.5)};
+  fmt_sendLogFmt(LOG_WARN, format, 3, args);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_LogFmt_tag, msgSent.which_sub);
+  LONGS_EQUAL(0x5678, msgSent.sub.LogFmt.id);
+  LONGS_EQUAL(LOG_WARN, msgSent.sub.LogFmt.level);
+  LONGS_EQUAL(3, msgSent.sub.LogFmt.args_count);
+  LONGS_EQUAL(7, msgSent.sub.LogFmt.args[0]);
+  LONGS_EQUAL(0xFFFFFFFF, msgSent.sub.LogFmt.args[1]);
+  LONGS_EQUAL(0x3FC00000, msgSent.sub.LogFmt.args[2]);
+}
+
+TEST(fmt_log, sendLogFmt_argCountClamped)
+{
+  const uint32_t args[FMT_LOG_MAX_ARGS + 1] = {1, 2, 3, 4, 5};
+  fmt_sendLogFmt(LOG_INFO, textIn, FMT_LOG_MAX_ARGS + 1, args);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  LONGS_EQUAL(FMT_LOG_MAX_ARGS, msgSent.sub.LogFmt.args_count);
+}
+
+TEST(fmt_log, sendLogFmt_levelBelowActive)
+{
+  fmt_setLogLevel(LOG_INFO);
+  CHECK_FALSE(fmt_sendLogFmt(LOG_VERBOSE, textIn, 0, NULL));
+  checkLogNotSent();
+}
+
+TEST(fmt_log, sendLogFmt_countSharedWithLog)
+{
+  fmt_sendLog(LOG_VERBOSE, textIn, numIn);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  uint32_t logCount = msgSent.sub.Log.count;
+
+  fmt_sendLogFmt(LOG_VERBOSE, textIn, 0, NULL);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  LONGS_EQUAL(logCount + 1, msgSent.sub.LogFmt.count);
+}
+
+TEST(fmt_log, drainLog_waitsForSpareSendSpace)
+{
+  test_setSendSpace(LOG_SEND_RESERVE);
+  CHECK(fmt_sendLog(LOG_ERROR, textIn, numIn));
+  checkLogNotSent();
+
+  test_setSendSpace(LOG_SEND_RESERVE + 1);
+  checkSentEqualsInput();
+}
+
+TEST(fmt_log, drainLog_sendsInOrder)
+{
+  fmt_sendLog(LOG_VERBOSE, textIn, 1);
+  fmt_sendLog(LOG_VERBOSE, textIn, 2);
+
+  // Room for one log per drain.
+  test_setSendSpace(LOG_SEND_RESERVE + 1);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  LONGS_EQUAL(1, msgSent.sub.Log.value);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  LONGS_EQUAL(2, msgSent.sub.Log.value);
+}
+
+TEST(fmt_log, sendLog_ringFull_dropCounted)
+{
+  test_setSendSpace(0);
+  for (uint32_t i = 0; i < LOG_RING_LENGTH; i++)
+    CHECK(fmt_sendLog(LOG_INFO, textIn, i));
+  CHECK_FALSE(fmt_sendLog(LOG_WARN, textIn, numIn));
+
+  // The drop report goes out ahead of the queued logs.
+  test_setSendSpace(LOG_SEND_RESERVE + 1);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_LogDropTlm_tag, msgSent.which_sub);
+  CHECK(msgSent.sub.LogDropTlm.warn > 0);
+}
+
+#define DRAIN_FREQ_HZ 1000U
+
+TEST(fmt_log, rateLimit_burstThenSuppressed)
+{
+  fmt_setLogRateLimit(10, 3, DRAIN_FREQ_HZ);
+  for (int i = 0; i < 3; i++)
+    CHECK(fmt_sendLog(LOG_ERROR, textIn, i));
+  CHECK_FALSE(fmt_sendLog(LOG_ERROR, textIn, 3));
+
+  // Other call sites have their own budget.
+  CHECK(fmt_sendLog(LOG_ERROR, "another site", numIn));
+}
+
+TEST(fmt_log, rateLimit_refillsAtRate)
+{
+  fmt_setLogRateLimit(10, 1, DRAIN_FREQ_HZ);
+  CHECK(fmt_sendLog(LOG_INFO, textIn, 1));
+  CHECK_FALSE(fmt_sendLog(LOG_INFO, textIn, 2));
+
+  // 10 per second: one more log allowed each 100 drain ticks.
+  for (uint32_t i = 0; i < DRAIN_FREQ_HZ / 10; i++)
+    fmt_drainLog();
+  CHECK(fmt_sendLog(LOG_INFO, textIn, 3));
+}
+
+TEST(fmt_log, rateLimit_repeatsReportedWhenQuiet)
+{
+  fmt_setLogRateLimit(10, 1, DRAIN_FREQ_HZ);
+  for (int i = 0; i < 3; i++)
+    fmt_sendLog(LOG_WARN, textIn, numIn);
+
+  for (uint32_t i = 0; i < DRAIN_FREQ_HZ; i++)
+    fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_Log_tag, msgSent.which_sub);
+  STRCMP_EQUAL("repeated: Hello, Firment.", msgSent.sub.Log.text);
+  LONGS_EQUAL(2, msgSent.sub.Log.value);
+}
+
+TEST(fmt_log, duplicates_collapsedWithoutRateLimit)
+{
+  CHECK(fmt_sendLog(LOG_WARN, textIn, numIn));
+  CHECK_FALSE(fmt_sendLog(LOG_WARN, textIn, numIn));
+  CHECK_FALSE(fmt_sendLog(LOG_WARN, textIn, numIn));
+
+  // A different log from the site sends the count ahead of itself.
+  CHECK(fmt_sendLog(LOG_WARN, textIn, numIn + 1));
+  test_setSendSpace(LOG_SEND_RESERVE + 1);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  LONGS_EQUAL(numIn, msgSent.sub.Log.value);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  STRCMP_EQUAL("repeated: Hello, Firment.", msgSent.sub.Log.text);
+  LONGS_EQUAL(2, msgSent.sub.Log.value);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  LONGS_EQUAL(numIn + 1, msgSent.sub.Log.value);
+}
+
+TEST(fmt_log, duplicates_sentAgainOnceQuiet)
+{
+  fmt_setLogRateLimit(0, 0, DRAIN_FREQ_HZ);
+  CHECK(fmt_sendLog(LOG_WARN, textIn, numIn));
+  CHECK_FALSE(fmt_sendLog(LOG_WARN, textIn, numIn));
+  for (uint32_t i = 0; i < DRAIN_FREQ_HZ; i++)
+    fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  STRCMP_EQUAL("repeated: Hello, Firment.", msgSent.sub.Log.text);
+  LONGS_EQUAL(1, msgSent.sub.Log.value);
+
+  CHECK(fmt_sendLog(LOG_WARN, textIn, numIn));
+}
+
+static uint32_t repeatReports;
+static bool countRepeatReports(Top message)
+{
+  if (message.which_sub == Top_Log_tag &&
+      strncmp(message.sub.Log.text, "repeated: ", 10) == 0)
+  {
+    repeatReports++;
+    CHECK(message.sub.Log.value <= DRAIN_FREQ_HZ);
+  }
+  return true;
+}
+
+TEST(fmt_log, duplicates_reportedEachSecondWhileRepeating)
+{
+  fmt_setLogRateLimit(0, 0, DRAIN_FREQ_HZ);
+  UT_PTR_SET(fmt_sendMsg, countRepeatReports);
+  repeatReports = 0;
+
+  // The same fault logged on every tick for 3.5 seconds.
+  for (uint32_t i = 0; i < 7 * DRAIN_FREQ_HZ / 2; i++)
+  {
+    fmt_sendLog(LOG_ERROR, textIn, numIn);
+    fmt_drainLog();
+  }
+  LONGS_EQUAL(3, repeatReports);
+}
+
+TEST(fmt_log, duplicateLogFmt_collapsed)
+{
+  const uint32_t args[] = {1, 2};
+  const uint32_t otherArgs[] = {1, 3};
+  CHECK(fmt_sendLogFmt(LOG_INFO, textIn, 2, args));
+  CHECK_FALSE(fmt_sendLogFmt(LOG_INFO, textIn, 2, args));
+  CHECK(fmt_sendLogFmt(LOG_INFO, textIn, 2, otherArgs));
+  CHECK(fmt_sendLogFmt(LOG_INFO, textIn, 1, args));
+}
+
+TEST(fmt_log, fmtLog_noArgs)
+{
+  test_logNoArgs();
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_LogFmt_tag, msgSent.which_sub);
+  LONGS_EQUAL(LOG_INFO, msgSent.sub.LogFmt.level);
+  LONGS_EQUAL(0, msgSent.sub.LogFmt.args_count);
+}
+
+TEST(fmt_log, fmtLog_oneArg)
+{
+  test_logOneArg(-2);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_LogFmt_tag, msgSent.which_sub);
+  LONGS_EQUAL(1, msgSent.sub.LogFmt.args_count);
+  LONGS_EQUAL(0xFFFFFFFE, msgSent.sub.LogFmt.args[0]);
+}
+
+TEST(fmt_log, fmtLog_maxMixedArgs)
+{
+  // int, float, pointer and double: one word each, floats as float bits.
+  test_logMaxArgs(7, 1.5f, (const void *)(uintptr_t)0x20001234, -2.0);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  ENUMS_EQUAL_INT(Top_LogFmt_tag, msgSent.which_sub);
+  LONGS_EQUAL(LOG_WARN, msgSent.sub.LogFmt.level);
+  LONGS_EQUAL(FMT_LOG_MAX_ARGS, msgSent.sub.LogFmt.args_count);
+  LONGS_EQUAL(7, msgSent.sub.LogFmt.args[0]);
+  LONGS_EQUAL(0x3FC00000, msgSent.sub.LogFmt.args[1]);
+  LONGS_EQUAL(0x20001234, msgSent.sub.LogFmt.args[2]);
+  LONGS_EQUAL(0xC0000000, msgSent.sub.LogFmt.args[3]);
+}
+
+TEST(fmt_log, fmtLog_idsDifferBySite)
+{
+  test_logNoArgs();
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  uint32_t noArgsId = msgSent.sub.LogFmt.id;
+
+  test_logOneArg(1);
+  fmt_drainLog();
+  fmt_getMsg(&msgSent);
+  CHECK(noArgsId != msgSent.sub.LogFmt.id);
+}
@@ -0,0 +1,216 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_params.h>
+#include "stub_comms.h"
+#include <fmt_flash.h>
+}
+#include <string.h>
+
+#define STORE_SIZE (FMT_PARAMS_SECTOR_COUNT * FMT_PARAMS_SECTOR_SIZE)
+#define BLOCKS_PER_SECTOR (FMT_PARAMS_SECTOR_SIZE / 256)
+
+TEST_GROUP(fmt_params)
+{
+  uint32_t value;
+  Top rxMsg;
+  void setup()
+  {
+    UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
+    UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
+    fmt_flash_startErase(FMT_PARAMS_ADDRESS, STORE_SIZE);
+    fmt_params_init();
+    value = 0;
+  }
+
+  // Appends whatever is pending, through a compaction if one starts.
+  void flush(void)
+  {
+    for (int i = 0; i < 4; i++)
+      fmt_params_handle();
+  }
+
+  TouchParam touchParam(TouchParam msg)
+  {
+    handleTouchParam(msg);
+    CHECK_TRUE(fmt_getMsg(&rxMsg));
+    CHECK_EQUAL(Top_TouchParam_tag, rxMsg.which_sub);
+    CHECK_EQUAL(ParamOperation_CURRENT_VAL, rxMsg.sub.TouchParam.operation);
+    return rxMsg.sub.TouchParam;
+  }
+
+  ParamValues paramValues(ParamValues msg)
+  {
+    handleParamValues(msg);
+    CHECK_TRUE(fmt_getMsg(&rxMsg));
+    CHECK_EQUAL(Top_ParamValues_tag, rxMsg.which_sub);
+    CHECK_EQUAL(ParamOperation_CURRENT_VAL, rxMsg.sub.ParamValues.operation);
+    CHECK_EQUAL(fmt_paramTableHash, rxMsg.sub.ParamValues.tableHash);
+    return rxMsg.sub.ParamValues;
+  }
+};
+
+TEST(fmt_params, neverSet_absent)
+{
+  CHECK_FALSE(fmt_params_get(1, &value));
+  CHECK_FALSE(fmt_params_get(FMT_PARAMS_ID_MAX, &value));
+  CHECK_FALSE(fmt_params_set(FMT_PARAMS_ID_MAX, 1));
+}
+
+TEST(fmt_params, set_readFromRamAtOnce)
+{
+  CHECK_TRUE(fmt_params_set(5, 42));
+  CHECK_TRUE(fmt_params_get(5, &value));
+  CHECK_EQUAL(42, value);
+}
+
+TEST(fmt_params, appended_survivesInit)
+{
+  fmt_params_set(5, 42);
+  fmt_params_set(6, 43);
+  flush();
+  fmt_params_init();
+  CHECK_TRUE(fmt_params_get(5, &value));
+  CHECK_EQUAL(42, value);
+  CHECK_TRUE(fmt_params_get(6, &value));
+  CHECK_EQUAL(43, value);
+}
+
+TEST(fmt_params, notAppended_lostOnInit)
+{
+  fmt_params_set(5, 42);
+  fmt_params_init();
+  CHECK_FALSE(fmt_params_get(5, &value));
+}
+
+TEST(fmt_params, manySets_compactedAcrossSectors)
+{
+  fmt_params_set(2, 100);
+  for (uint32_t i = 0; i < 3 * BLOCKS_PER_SECTOR; i++)
+  {
+    fmt_params_set(1, i);
+    fmt_params_handle();
+  }
+  flush();
+  fmt_params_init();
+  CHECK_TRUE(fmt_params_get(1, &value));
+  CHECK_EQUAL(3 * BLOCKS_PER_SECTOR - 1, value);
+  CHECK_TRUE(fmt_params_get(2, &value));
+  CHECK_EQUAL(100, value);
+}
+
+TEST(fmt_params, tornBlock_skipped)
+{
+  fmt_params_set(5, 42);
+  flush();
+  // A reset in the middle of writing the next block.
+  uint8_t torn[16] = {0x50, 0x52, 0x4D, 0x31, 2, 0, 0, 0, 1, 0};
+  fmt_flash_write(FMT_PARAMS_ADDRESS + 256, torn, sizeof(torn));
+
+  fmt_params_init();
+  fmt_params_set(5, 44);
+  flush();
+  fmt_params_init();
+  CHECK_TRUE(fmt_params_get(5, &value));
+  CHECK_EQUAL(44, value);
+}
+
+TEST(fmt_params, touchParam_setThenGet)
+{
+  TouchParam set = {
+      .operation = ParamOperation_SET,
+      .which_param = TouchParam_paramA_tag,
+      .param = {.paramA = 1.5F}};
+  TouchParam reply = touchParam(set);
+  CHECK_EQUAL(TouchParam_paramA_tag, reply.which_param);
+  DOUBLES_EQUAL(1.5, reply.param.paramA, 0);
+
+  TouchParam get = {
+      .operation = ParamOperation_GET,
+      .which_param = TouchParam_paramA_tag};
+  reply = touchParam(get);
+  DOUBLES_EQUAL(1.5, reply.param.paramA, 0);
+}
+
+TEST(fmt_params, touchParam_setOutOfRange_ignored)
+{
+  TouchParam set = {
+      .operation = ParamOperation_SET,
+      .which_param = TouchParam_paramA_tag,
+      .param = {.paramA = 1e9F}};
+  TouchParam reply = touchParam(set);
+  DOUBLES_EQUAL(1.5, reply.param.paramA, 0); // The default.
+  CHECK_FALSE(fmt_params_get(TouchParam_paramA_tag, &value));
+}
+
+TEST(fmt_params, touchParam_idNotInTable_noReply)
+{
+  fmt_sendMsg((Top){0}); // Clear the spy.
+  TouchParam set = {
+      .operation = ParamOperation_SET,
+      .which_param = FMT_PARAMS_ID_MAX - 1,
+      .param = {.paramB = 7}};
+  handleTouchParam(set);
+  CHECK_TRUE(fmt_getMsg(&rxMsg));
+  CHECK_EQUAL(0, rxMsg.which_sub);
+  CHECK_FALSE(fmt_params_get(FMT_PARAMS_ID_MAX - 1, &value));
+}
+
+TEST(fmt_params, paramValues_getNeverSet_defaults)
+{
+  ParamValues get = {
+      .operation = ParamOperation_GET,
+      .tableHash = fmt_paramTableHash,
+      .firstIndex = 0};
+  ParamValues reply = paramValues(get);
+  CHECK_TRUE(reply.values_count > 0);
+  CHECK_TRUE(reply.values_count <= fmt_paramCount);
+  for (uint32_t i = 0; i < reply.values_count; i++)
+    CHECK_EQUAL(fmt_paramTable[i].initial.u, reply.values[i]);
+}
+
+TEST(fmt_params, paramValues_setInRange_stored)
+{
+  const fmt_paramInfo_t *param = &fmt_paramTable[0];
+  ParamValues set = {
+      .operation = ParamOperation_SET,
+      .tableHash = fmt_paramTableHash,
+      .firstIndex = 0,
+      .values_count = 1,
+      .values = {param->max.u}};
+  ParamValues reply = paramValues(set);
+  CHECK_EQUAL(1, reply.values_count);
+  CHECK_EQUAL(param->max.u, reply.values[0]);
+  CHECK_TRUE(fmt_params_get(param->id, &value));
+  CHECK_EQUAL(param->max.u, value);
+}
+
+TEST(fmt_params, paramValues_setOutOfRange_ignored)
+{
+  const fmt_paramInfo_t *param = &fmt_paramTable[0];
+  CHECK_EQUAL(FMT_PARAM_FLOAT, param->type);
+  fmt_paramValue_t tooBig = {.f = param->max.f * 2 + 1};
+  ParamValues set = {
+      .operation = ParamOperation_SET,
+      .tableHash = fmt_paramTableHash,
+      .firstIndex = 0,
+      .values_count = 1,
+      .values = {tooBig.u}};
+  ParamValues reply = paramValues(set);
+  CHECK_EQUAL(param->initial.u, reply.values[0]);
+  CHECK_FALSE(fmt_params_get(param->id, &value));
+}
+
+TEST(fmt_params, paramValues_otherTable_noValues)
+{
+  ParamValues set = {
+      .operation = ParamOperation_SET,
+      .tableHash = fmt_paramTableHash + 1,
+      .firstIndex = 0,
+      .values_count = 1,
+      .values = {fmt_paramTable[0].initial.u}};
+  ParamValues reply = paramValues(set);
+  CHECK_EQUAL(0, reply.values_count);
+  CHECK_FALSE(fmt_params_get(fmt_paramTable[0].id, &value));
+}
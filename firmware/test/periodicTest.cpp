@@ -0,0 +1,134 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_periodic_port.h>
+#include "stub_comms.h"
+}
+
+#define HOST_CLOCK_HZ 80000000U
+
+static uint32_t callbackRuns;
+static void callback(void) { callbackRuns++; }
+
+TEST_GROUP(fmt_periodic)
+{
+  timerDivide_t divide;
+  fmt_periodicStats_t stats;
+  periodicTimer_t *timer;
+  void setup()
+  {
+    UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
+    UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
+    test_setNextSendReturn(true);
+    callbackRuns = 0;
+    divide = (timerDivide_t){0};
+    timer = port_getPeriodicTimer(0);
+  }
+};
+
+TEST(fmt_periodic, divide_fitsPeriod_noPrescaler)
+{
+  CHECK_TRUE(fmt_periodic_divide(HOST_CLOCK_HZ, 50, 0x10000, 0x10000, false,
+                                 &divide));
+  CHECK_EQUAL(1, divide.prescaler);
+  CHECK_EQUAL(4000, divide.period); // 20kHz
+}
+
+TEST(fmt_periodic, divide_longInterval_leastPrescaler)
+{
+  CHECK_TRUE(fmt_periodic_divide(HOST_CLOCK_HZ, 1000, 0x10000, 0x10000, false,
+                                 &divide));
+  CHECK_EQUAL(2, divide.prescaler);
+  CHECK_EQUAL(40000, divide.period);
+}
+
+TEST(fmt_periodic, divide_pow2Prescaler)
+{
+  CHECK_TRUE(fmt_periodic_divide(144000000U, 10000, 0x10000, 0x8000, true,
+                                 &divide));
+  CHECK_EQUAL(32, divide.prescaler); // 22 would do, but isn't a power of 2.
+  CHECK_EQUAL(45000, divide.period);
+}
+
+TEST(fmt_periodic, divide_inexact_nearestPeriod)
+{
+  CHECK_TRUE(fmt_periodic_divide(144000000U, 1000, 0x10000, 0x8000, true,
+                                 &divide));
+  CHECK_EQUAL(4, divide.prescaler);
+  CHECK_EQUAL(36000, divide.period);
+  CHECK_TRUE(fmt_periodic_divide(HOST_CLOCK_HZ, 33334, 0x10000, 0x10000, false,
+                                 &divide));
+  CHECK_EQUAL(41, divide.prescaler);
+  CHECK_EQUAL(65042, divide.period); // 2666722 clocks, for 2666720.
+}
+
+TEST(fmt_periodic, divide_outOfRange_rejected)
+{
+  CHECK_FALSE(fmt_periodic_divide(HOST_CLOCK_HZ, FMT_PERIODIC_INTERVAL_MIN_US - 1,
+                                  0x10000, 0x10000, false, &divide));
+  CHECK_FALSE(fmt_periodic_divide(HOST_CLOCK_HZ, 100000000, 0x10000, 0x10000,
+                                  false, &divide));
+}
+
+TEST(fmt_periodic, init_invalid_rejected)
+{
+  CHECK_FALSE(fmt_initPeriodic(0, 1000, 0, NULL));
+  CHECK_FALSE(fmt_initPeriodic(0, FMT_PERIODIC_INTERVAL_MIN_US - 1, 0, callback));
+  CHECK_FALSE(fmt_initPeriodic(UINT8_MAX, 1000, 0, callback));
+  CHECK_FALSE(fmt_periodic_getStats(UINT8_MAX, &stats));
+}
+
+TEST(fmt_periodic, tick_runsCallbackAndRecordsLatency)
+{
+  CHECK_TRUE(fmt_initPeriodic(0, 50, 0, callback));
+  fmt_periodic_tick(timer, 16);
+  fmt_periodic_tick(timer, 8);
+  fmt_periodic_tick(timer, 40);
+  timer->overruns++; // As the port's ISR counts them.
+
+  CHECK_EQUAL(3, callbackRuns);
+  CHECK_TRUE(fmt_periodic_getStats(0, &stats));
+  CHECK_EQUAL(50000, stats.periodNs);
+  CHECK_EQUAL(3, stats.ticks);
+  CHECK_EQUAL(1, stats.overruns);
+  CHECK_EQUAL(100, stats.minLatencyNs); // 8 counts at 80MHz
+  CHECK_EQUAL(500, stats.maxLatencyNs);
+}
+
+TEST(fmt_periodic, latency_scaledByPrescaler)
+{
+  CHECK_TRUE(fmt_initPeriodic(0, 1000, 0, callback)); // prescaler 2
+  fmt_periodic_tick(timer, 8);
+  fmt_periodic_getStats(0, &stats);
+  CHECK_EQUAL(200, stats.minLatencyNs);
+  CHECK_EQUAL(1000000, stats.periodNs);
+}
+
+TEST(fmt_periodic, sendTlm_sendsThenResets)
+{
+  CHECK_TRUE(fmt_initPeriodic(0, 50, 0, callback));
+  fmt_periodic_tick(timer, 8);
+
+  CHECK_TRUE(fmt_periodic_sendTlm(0));
+  Top rxMsg;
+  CHECK_TRUE(fmt_getMsg(&rxMsg));
+  CHECK_EQUAL(Top_PeriodicTlm_tag, rxMsg.which_sub);
+  CHECK_EQUAL(0, rxMsg.sub.PeriodicTlm.timerId);
+  CHECK_EQUAL(1, rxMsg.sub.PeriodicTlm.ticks);
+  CHECK_EQUAL(100, rxMsg.sub.PeriodicTlm.maxLatencyNs);
+
+  fmt_periodic_getStats(0, &stats);
+  CHECK_EQUAL(0, stats.ticks);
+  CHECK_EQUAL(0, stats.maxLatencyNs);
+}
+
+TEST(fmt_periodic, sendTlmFails_statsKept)
+{
+  CHECK_TRUE(fmt_initPeriodic(0, 50, 0, callback));
+  fmt_periodic_tick(timer, 8);
+  test_setNextSendReturn(false);
+  CHECK_FALSE(fmt_periodic_sendTlm(0));
+  fmt_periodic_getStats(0, &stats);
+  CHECK_EQUAL(1, stats.ticks);
+}
@@ -0,0 +1,161 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_profile.h>
+#include <fmt_sched.h>
+#include "stub_comms.h"
+}
+#include <string.h>
+
+static void work(void) { hostCycles += 1000; }
+
+TEST_GROUP(fmt_profile)
+{
+  Top rxMsg;
+  fmt_profileStats_t stats;
+  void setup()
+  {
+    UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
+    UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
+    test_setNextSendReturn(true);
+    fmt_profile_reset();
+    fmt_sched_reset();
+    hostCycles = 0;
+  }
+
+  ProfileTlm sent(void)
+  {
+    CHECK_TRUE(fmt_getMsg(&rxMsg));
+    CHECK_EQUAL(Top_ProfileTlm_tag, rxMsg.which_sub);
+    return rxMsg.sub.ProfileTlm;
+  }
+};
+
+TEST(fmt_profile, beginEnd_recordsCycles)
+{
+  uint32_t begin = fmt_profile_begin();
+  hostCycles += 500;
+  fmt_profile_end(FMT_PROFILE_SPI_ISR, begin);
+
+  CHECK_TRUE(fmt_profile_getStats(FMT_PROFILE_SPI_ISR, &stats));
+  CHECK_EQUAL(1, stats.count);
+  CHECK_EQUAL(500, stats.minCycles);
+  CHECK_EQUAL(500, stats.maxCycles);
+}
+
+TEST(fmt_profile, record_minMaxMean)
+{
+  int32_t site = fmt_profile_addSite("user");
+  CHECK_EQUAL((int32_t)FMT_PROFILE_FIRMENT_SITES, site);
+  fmt_profile_record(site, 300);
+  fmt_profile_record(site, 100);
+  fmt_profile_record(site, 200);
+
+  fmt_profile_getStats(site, &stats);
+  CHECK_EQUAL(3, stats.count);
+  CHECK_EQUAL(100, stats.minCycles);
+  CHECK_EQUAL(300, stats.maxCycles);
+  CHECK_EQUAL(200, stats.meanCycles);
+}
+
+TEST(fmt_profile, record_binsByPowerOf2)
+{
+  const uint32_t runs[] = {0, 127, 128, 255, 256, 8191, 8192, UINT32_MAX};
+  const uint32_t expected[FMT_PROFILE_BINS] = {2, 2, 1, 0, 0, 0, 1, 2};
+  for (uint32_t run : runs)
+    fmt_profile_record(FMT_PROFILE_WAVEFORM, run);
+
+  fmt_profile_getStats(FMT_PROFILE_WAVEFORM, &stats);
+  for (uint32_t bin = 0; bin < FMT_PROFILE_BINS; bin++)
+    CHECK_EQUAL(expected[bin], stats.bins[bin]);
+}
+
+TEST(fmt_profile, unknownSite_ignored)
+{
+  fmt_profile_record(-1, 100);
+  fmt_profile_record(FMT_PROFILE_FIRMENT_SITES, 100);
+  CHECK_FALSE(fmt_profile_getStats(FMT_PROFILE_FIRMENT_SITES, &stats));
+}
+
+TEST(fmt_profile, addSite_full_rejected)
+{
+  for (uint32_t i = FMT_PROFILE_FIRMENT_SITES; i < FMT_PROFILE_SITE_MAX; i++)
+    CHECK_EQUAL((int32_t)i, fmt_profile_addSite("user"));
+  CHECK_EQUAL(-1, fmt_profile_addSite("user"));
+}
+
+TEST(fmt_profile, send_reportsThenClears)
+{
+  fmt_profile_record(FMT_PROFILE_UART_ISR, 100);
+  fmt_profile_record(FMT_PROFILE_UART_ISR, 100);
+  fmt_profile_record(FMT_PROFILE_UART_ISR, 1000);
+
+  CHECK_TRUE(fmt_profile_send());
+  ProfileTlm tlm = sent();
+  STRCMP_EQUAL("uartIsr", tlm.name);
+  CHECK_EQUAL(3, tlm.count);
+  CHECK_EQUAL(100, tlm.minCycles);
+  CHECK_EQUAL(1000, tlm.maxCycles);
+  CHECK_EQUAL(400, tlm.meanCycles);
+  CHECK_EQUAL(HOST_CYCLES_PER_US, tlm.cyclesPerUs);
+  CHECK_EQUAL(FMT_PROFILE_BINS, tlm.histogram.size);
+  CHECK_EQUAL(170, tlm.histogram.bytes[0]); // 2/3 of 255
+  CHECK_EQUAL(85, tlm.histogram.bytes[3]);
+  CHECK_EQUAL(0, tlm.histogram.bytes[1]);
+
+  fmt_profile_getStats(FMT_PROFILE_UART_ISR, &stats);
+  CHECK_EQUAL(0, stats.count);
+  CHECK_FALSE(fmt_profile_send());
+}
+
+TEST(fmt_profile, send_rareRuns_stillShown)
+{
+  for (int i = 0; i < 1000; i++)
+    fmt_profile_record(FMT_PROFILE_SPI_ISR, 10);
+  fmt_profile_record(FMT_PROFILE_SPI_ISR, 10000);
+
+  fmt_profile_send();
+  CHECK_EQUAL(255, sent().histogram.bytes[0]);
+  CHECK_EQUAL(1, sent().histogram.bytes[FMT_PROFILE_BINS - 1]);
+}
+
+TEST(fmt_profile, send_sitesInTurn)
+{
+  int32_t site = fmt_profile_addSite("userSiteLongName");
+  fmt_profile_record(site, 10);
+  fmt_profile_record(FMT_PROFILE_GHOST_PROBE, 10);
+
+  fmt_profile_send();
+  STRCMP_EQUAL("ghostProbe", sent().name);
+  fmt_profile_record(FMT_PROFILE_GHOST_PROBE, 10);
+  fmt_profile_send();
+  STRCMP_EQUAL("userSiteLong", sent().name); // Truncated to fit.
+  fmt_profile_send();
+  STRCMP_EQUAL("ghostProbe", sent().name);
+}
+
+TEST(fmt_profile, sendFails_runsKept)
+{
+  fmt_profile_record(FMT_PROFILE_SPI_ISR, 10);
+  test_setNextSendReturn(false);
+  CHECK_FALSE(fmt_profile_send());
+  test_setNextSendReturn(true);
+  fmt_profile_record(FMT_PROFILE_SPI_ISR, 20);
+
+  CHECK_TRUE(fmt_profile_send());
+  CHECK_EQUAL(2, sent().count);
+}
+
+TEST(fmt_profile, namedTask_profiled)
+{
+  fmt_taskCfg_t cfg = {.run = work, .periodTicks = 1, .name = "work"};
+  fmt_sched_addTask(&cfg);
+  CHECK_TRUE(fmt_sched_start(0, 100, 0));
+  fmt_sched_tick();
+  fmt_sched_tick();
+
+  fmt_profile_getStats(FMT_PROFILE_FIRMENT_SITES, &stats);
+  CHECK_EQUAL(2, stats.count);
+  CHECK_EQUAL(1000, stats.maxCycles);
+}
@@ -0,0 +1,156 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_sched.h>
+#include <cycles_port.h>
+}
+#include <string.h>
+
+#define TICK_US 100U
+#define TICK_CYCLES (TICK_US * HOST_CYCLES_PER_US)
+
+// Which task ran, in order, on each tick.
+static char runLog[64];
+static uint32_t runCount;
+static uint32_t taskCycles; // each run takes this long.
+
+static void logRun(char name)
+{
+  if (runCount < sizeof(runLog) - 1)
+    runLog[runCount++] = name;
+}
+static void taskA(void) { logRun('A'); hostCycles += taskCycles; }
+static void taskB(void) { logRun('B'); hostCycles += taskCycles; }
+static void taskC(void) { logRun('C'); hostCycles += taskCycles; }
+
+TEST_GROUP(fmt_sched)
+{
+  void setup()
+  {
+    fmt_sched_reset();
+    memset(runLog, 0, sizeof(runLog));
+    runCount = 0;
+    taskCycles = 0;
+    hostCycles = 0;
+  }
+
+  int32_t add(callback_t run, uint32_t period, uint32_t phase,
+              uint8_t priority = 0, uint32_t deadlineUs = 0)
+  {
+    fmt_taskCfg_t cfg = {
+        .run = run,
+        .periodTicks = period,
+        .phaseTicks = phase,
+        .deadlineUs = deadlineUs,
+        .priority = priority};
+    return fmt_sched_addTask(&cfg);
+  }
+
+  // Runs ticks, marking the end of each in the log with '.'.
+  void tick(uint32_t count)
+  {
+    CHECK_TRUE(fmt_sched_start(0, TICK_US, 0));
+    for (uint32_t i = 0; i < count; i++)
+    {
+      fmt_sched_tick();
+      logRun('.');
+    }
+  }
+};
+
+TEST(fmt_sched, invalidTask_rejected)
+{
+  CHECK_EQUAL(-1, add(NULL, 1, 0));
+  CHECK_EQUAL(-1, add(taskA, 0, 0));
+  CHECK_EQUAL(-1, add(taskA, 4, 4));
+}
+
+TEST(fmt_sched, tableFull_rejected)
+{
+  for (uint32_t i = 0; i < FMT_SCHED_TASK_MAX; i++)
+    CHECK_EQUAL((int32_t)i, add(taskA, 1, 0));
+  CHECK_EQUAL(-1, add(taskA, 1, 0));
+}
+
+TEST(fmt_sched, periodAndPhase_followed)
+{
+  add(taskA, 2, 0, 0);
+  add(taskB, 3, 1, 1);
+  tick(7);
+  STRCMP_EQUAL("A.B.A..AB..A.", runLog);
+}
+
+TEST(fmt_sched, sameTick_priorityOrder)
+{
+  add(taskA, 1, 0, 2);
+  add(taskB, 1, 0, 0);
+  add(taskC, 1, 0, 1);
+  tick(2);
+  STRCMP_EQUAL("BCA.BCA.", runLog);
+}
+
+TEST(fmt_sched, periodLongerThanWheel_runsOnItsTick)
+{
+  add(taskA, FMT_SCHED_WHEEL_SLOTS + 1, 1);
+  add(taskB, FMT_SCHED_WHEEL_SLOTS, 1); // Same slot, other turns of the wheel.
+  tick(FMT_SCHED_WHEEL_SLOTS + 3);
+  fmt_taskStats_t stats;
+  fmt_sched_getTaskStats(0, &stats);
+  CHECK_EQUAL(2, stats.runs);
+  fmt_sched_getTaskStats(1, &stats);
+  CHECK_EQUAL(2, stats.runs);
+  STRNCMP_EQUAL(".AB.", runLog, 4);
+}
+
+TEST(fmt_sched, autoPhase_spreadsEqualPeriods)
+{
+  add(taskA, 4, FMT_SCHED_PHASE_AUTO);
+  add(taskB, 4, FMT_SCHED_PHASE_AUTO);
+  add(taskC, 2, FMT_SCHED_PHASE_AUTO);
+  tick(4);
+  // C can't avoid both; it shares with one of them.
+  STRCMP_EQUAL("AC.B.C..", runLog);
+}
+
+TEST(fmt_sched, runTimes_recorded)
+{
+  add(taskA, 1, 0);
+  taskCycles = 100;
+  tick(1);
+  taskCycles = 300;
+  tick(1);
+  fmt_taskStats_t stats;
+  CHECK_TRUE(fmt_sched_getTaskStats(0, &stats));
+  CHECK_EQUAL(2, stats.runs);
+  CHECK_EQUAL(300, stats.lastCycles);
+  CHECK_EQUAL(300, stats.maxCycles);
+  CHECK_EQUAL(200, stats.meanCycles);
+  CHECK_EQUAL(0, stats.deadlineMisses);
+  CHECK_FALSE(fmt_sched_getTaskStats(1, &stats));
+}
+
+TEST(fmt_sched, lateFinish_deadlineMissed)
+{
+  add(taskA, 1, 0, 0);
+  add(taskB, 1, 0, 1, 2 * TICK_US); // May finish in the next tick.
+  taskCycles = TICK_CYCLES * 3 / 4;
+  tick(1);
+
+  fmt_taskStats_t stats;
+  fmt_sched_getTaskStats(0, &stats);
+  CHECK_EQUAL(0, stats.deadlineMisses);
+  fmt_sched_getTaskStats(1, &stats);
+  CHECK_EQUAL(0, stats.deadlineMisses);
+
+  add(taskC, 1, 0, 2);
+  tick(1);
+  fmt_sched_getTaskStats(2, &stats);
+  CHECK_EQUAL(1, stats.deadlineMisses);
+
+  fmt_schedStats_t schedStats;
+  fmt_sched_getStats(&schedStats);
+  CHECK_EQUAL(2, schedStats.ticks);
+  CHECK_EQUAL(2, schedStats.overruns);
+  CHECK_EQUAL(3 * taskCycles, schedStats.maxTickCycles);
+}
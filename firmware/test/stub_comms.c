@@ -1,7 +1,9 @@
 #include "stub_comms.h"
+#include <fmt_sizes.h>
 
 static Top storedMsg = {0};
 static bool toReturnOnSend = true;
+static uint32_t sendSpace = SEND_QUEUE_LENGTH;
 
 bool fmt_sendMsg_test(Top message)
 {
@@ -15,5 +17,11 @@ bool fmt_getMsg_test(Top *message)
   return true;
 }
 
+uint32_t fmt_getSendSpace_test(void)
+{
+  return sendSpace;
+}
+
 /* Test-utilities */
-void test_setNextSendReturn(bool toReturn) { toReturnOnSend = toReturn; }
\ No newline at end of file
+void test_setNextSendReturn(bool toReturn) { toReturnOnSend = toReturn; }
+void test_setSendSpace(uint32_t space) { sendSpace = space; }
\ No newline at end of file
@@ -2,4 +2,6 @@
 
 bool fmt_getMsg_test(Top *message);
 bool fmt_sendMsg_test(Top message);
-void test_setNextSendReturn(bool toReturn);
\ No newline at end of file
+uint32_t fmt_getSendSpace_test(void);
+void test_setNextSendReturn(bool toReturn);
+void test_setSendSpace(uint32_t space);
\ No newline at end of file
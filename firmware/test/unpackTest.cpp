@@ -0,0 +1,110 @@
+#include <CppUTest/TestHarness.h>
+
+extern "C"
+{
+#include <fmt_unpack.h>
+#include <fmt_flash.h>
+}
+
+#define OUT_SIZE 16
+#define BASE_ADDRESS 0x1000
+#define BASE_SIZE 8
+
+TEST_GROUP(fmt_unpack)
+{
+  uint8_t out[OUT_SIZE];
+  unpackBase_t base;
+  void setup()
+  {
+    memset(out, 0, sizeof(out));
+    fmt_flash_write(BASE_ADDRESS, (const uint8_t *)"01234567", BASE_SIZE);
+    // out[0] corresponds to base byte 2.
+    base = (unpackBase_t){
+        .address = BASE_ADDRESS, .size = BASE_SIZE, .offset = 2};
+  }
+};
+
+TEST(fmt_unpack, emptyStream_unpacksToNothing)
+{
+  LONGS_EQUAL(0, fmt_unpack(NULL, 0, out, OUT_SIZE, NULL));
+}
+
+TEST(fmt_unpack, literalRun_copied)
+{
+  const uint8_t in[] = {2, 'a', 'b', 'c'};
+  LONGS_EQUAL(3, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+  MEMCMP_EQUAL("abc", out, 3);
+}
+
+TEST(fmt_unpack, match_copiesFromEarlierOutput)
+{
+  // "abc", then 3 bytes from 3 back.
+  const uint8_t in[] = {2, 'a', 'b', 'c', 0x80, 2};
+  LONGS_EQUAL(6, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+  MEMCMP_EQUAL("abcabc", out, 6);
+}
+
+TEST(fmt_unpack, overlappingMatch_repeatsByte)
+{
+  // One 0xFF, then 9 more from 1 back.
+  const uint8_t in[] = {0, 0xFF, 0x86, 0};
+  const uint8_t expected[10] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  LONGS_EQUAL(10, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+  MEMCMP_EQUAL(expected, out, sizeof(expected));
+}
+
+TEST(fmt_unpack, matchBeforeStartOfOutput_fails)
+{
+  const uint8_t in[] = {0, 'a', 0x80, 1};
+  LONGS_EQUAL(-1, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+}
+
+TEST(fmt_unpack, truncatedLiteralRun_fails)
+{
+  const uint8_t in[] = {3, 'a', 'b'};
+  LONGS_EQUAL(-1, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+}
+
+TEST(fmt_unpack, truncatedMatch_fails)
+{
+  const uint8_t in[] = {0, 'a', 0x80};
+  LONGS_EQUAL(-1, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+}
+
+TEST(fmt_unpack, outputOverflow_fails)
+{
+  // 1 + 66 bytes.
+  const uint8_t in[] = {0, 'a', 0xBF, 0};
+  LONGS_EQUAL(-1, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+}
+
+TEST(fmt_unpack, baseCopy_readsRelativeToOutputPosition)
+{
+  // "x", then 3 bytes from 1 before the base position matching out[1], then 2
+  // from the position matching out[4].
+  const uint8_t in[] = {0, 'x', 0xFF, 0xFF, 0xFF, 2, 0xC0, 0, 0, 1};
+  LONGS_EQUAL(6, fmt_unpack(in, sizeof(in), out, OUT_SIZE, &base));
+  MEMCMP_EQUAL("x23467", out, 6);
+}
+
+TEST(fmt_unpack, baseCopyWithoutBase_fails)
+{
+  const uint8_t in[] = {0xC0, 0, 0, 0};
+  LONGS_EQUAL(-1, fmt_unpack(in, sizeof(in), out, OUT_SIZE, NULL));
+}
+
+TEST(fmt_unpack, baseCopyOutsideBase_fails)
+{
+  const uint8_t beforeStart[] = {0xFF, 0xFD, 0xFF, 0};
+  const uint8_t pastEnd[] = {0xC0, 0, 0, BASE_SIZE - 2};
+  LONGS_EQUAL(-1, fmt_unpack(beforeStart, sizeof(beforeStart), out, OUT_SIZE,
+                             &base));
+  LONGS_EQUAL(-1, fmt_unpack(pastEnd, sizeof(pastEnd), out, OUT_SIZE, &base));
+}
+
+TEST(fmt_unpack, truncatedBaseCopy_fails)
+{
+  const uint8_t in[] = {0xC0, 0, 0};
+  LONGS_EQUAL(-1, fmt_unpack(in, sizeof(in), out, OUT_SIZE, &base));
+}
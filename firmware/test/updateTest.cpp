@@ -16,9 +16,29 @@ extern "C"
 {
 #include <fmt_update.h>
 #include "stub_comms.h"
+#include <fmt_flash.h>
+#include <fmt_version.h>
 }
+#include <string.h>
 #define TOO_GREAT 1000
 
+static int downloadStartCount, downloadFinishCount;
+static uint32_t crc32(const uint8_t *data, uint32_t len)
+{
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+  }
+  return ~crc;
+}
+
+static void onDownloadStart(void) { downloadStartCount++; }
+static void onDownloadFinish(void) { downloadFinishCount++; }
+static uint32_t getBuildId(void) { return 0xB1D; }
+
 TEST_GROUP(fmt_update)
 {
   int onFirstPageCount, onLastPageCount;
@@ -30,9 +50,14 @@ TEST_GROUP(fmt_update)
     // Insert fmt_comms spy.
     UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
     UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
-    
-    // Send an invalid message to reset the download.
-    msg.chunkIndex = TOO_GREAT;
+    downloadStartCount = downloadFinishCount = 0;
+
+    // Write out pages completed by the previous test.
+    for (int i = 0; i < UPDATE_WINDOW_PAGES; i++)
+      fmt_handleUpdate();
+
+    // Send an invalid message; it is answered with WRITE_FAIL.
+    msg = (ImageData){.pageIndex = 0, .chunkIndex = TOO_GREAT};
     handleImageData(msg);
 
     // Replace good data
@@ -45,6 +70,59 @@ TEST_GROUP(fmt_update)
   }
   void teardown()
   {
+    fmt_setFirstPageReceivedCallback(NULL);
+    fmt_setDownloadFinishCallback(NULL);
+    fmt_setBuildIdGetter(NULL);
+  }
+
+  // A whole page in one chunk.
+  bool sendPage(uint32_t pageIndex, uint32_t pageCount)
+  {
+    msg.pageIndex = pageIndex;
+    msg.pageCount = pageCount;
+    msg.chunkIndex = 0;
+    msg.chunkCountInPage = 1;
+    return handleImageData(msg);
+  }
+
+  bool sendChunk(uint32_t chunkIndex, uint32_t chunkCount, uint32_t pageCount)
+  {
+    msg.pageIndex = 0;
+    msg.pageCount = pageCount;
+    msg.chunkIndex = chunkIndex;
+    msg.chunkCountInPage = chunkCount;
+    msg.payload.size = sizeof(msg.payload.bytes);
+    return handleImageData(msg);
+  }
+
+  // CRC of the page sendPage() sends: one chunk, then erased flash.
+  uint32_t sentPageCrc(void)
+  {
+    uint8_t page[UPDATE_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, msg.payload.bytes, msg.payload.size);
+    return crc32(page, sizeof(page));
+  }
+
+  uint32_t checkPagesPresent(uint32_t pageCount, uint32_t crc0, uint32_t crc1)
+  {
+    handlePageCrcs((PageCrcs){
+        .pageCount = pageCount,
+        .firstPageIndex = 0,
+        .crcs_count = 2,
+        .crcs = {crc0, crc1}});
+    CHECK_TRUE(fmt_getMsg(&rxMsg));
+    CHECK_EQUAL(Top_PagesPresent_tag, rxMsg.which_sub);
+    CHECK_EQUAL(0, rxMsg.sub.PagesPresent.firstPageIndex);
+    return rxMsg.sub.PagesPresent.present;
+  }
+
+  void checkStatusSent(uint32_t pageIndex, PageStatusEnum status)
+  {
+    CHECK_TRUE(fmt_getMsg(&rxMsg));
+    CHECK_EQUAL(Top_PageStatus_tag, rxMsg.which_sub);
+    CHECK_EQUAL(pageIndex, rxMsg.sub.PageStatus.pageIndex);
+    CHECK_EQUAL(status, rxMsg.sub.PageStatus.status);
   }
   void onLastPageSaved(void)
   {
@@ -71,17 +149,287 @@ TEST(fmt_update, firstOfSeveralChunks_returnsOk)
   CHECK_TRUE(handleImageData(msg));
 }
 
+/* Written pages are remembered until an image with a different pageCount
+ * starts, so each test below uses a pageCount no other test uses. */
+
 TEST(fmt_update, singleMessageImage_NoCallbacks_returnsOk)
 {
   msg.chunkCountInPage = 1;
-  msg.pageCount = 1;
+  msg.pageCount = 3;
+  CHECK_TRUE(handleImageData(msg));
+}
+
+TEST(fmt_update, windowOfPages_bufferedUntilHandleUpdate)
+{
+  for (uint32_t page = 0; page < UPDATE_WINDOW_PAGES; page++)
+    CHECK_TRUE(sendPage(page, 8));
+
+  // Pages are written and acked one per call, in the order they completed.
+  for (uint32_t page = 0; page < UPDATE_WINDOW_PAGES; page++)
+  {
+    fmt_handleUpdate();
+    checkStatusSent(page, PageStatusEnum_WRITE_SUCCESS);
+  }
+}
+
+TEST(fmt_update, pageBeyondWindow_fails)
+{
+  for (uint32_t page = 0; page < UPDATE_WINDOW_PAGES; page++)
+    sendPage(page, 9);
+  CHECK_FALSE(sendPage(UPDATE_WINDOW_PAGES, 9));
+  checkStatusSent(UPDATE_WINDOW_PAGES, PageStatusEnum_WRITE_FAIL);
+
+  // A written page frees its buffer.
+  fmt_handleUpdate();
+  CHECK_TRUE(sendPage(UPDATE_WINDOW_PAGES, 9));
+}
+
+TEST(fmt_update, outOfOrderPages_callbacksOnFirstAndLastWrite)
+{
+  fmt_setFirstPageReceivedCallback(onDownloadStart);
+  fmt_setDownloadFinishCallback(onDownloadFinish);
+  sendPage(1, 2);
+  sendPage(0, 2);
+
+  fmt_handleUpdate();
+  CHECK_EQUAL(1, downloadStartCount);
+  CHECK_EQUAL(0, downloadFinishCount);
+  fmt_handleUpdate();
+  CHECK_EQUAL(1, downloadStartCount);
+  CHECK_EQUAL(1, downloadFinishCount);
+}
+TEST(fmt_update, gapBeforeLastChunk_requestsResendOfMissing)
+{
+  sendChunk(0, 4, 4);
+  sendChunk(2, 4, 4);
+  CHECK_TRUE(sendChunk(3, 4, 4));
+  checkStatusSent(0, PageStatusEnum_REQUEST_RESEND);
+  CHECK_EQUAL(1 << 1, rxMsg.sub.PageStatus.missingChunks);
+
+  // Only the missing chunk is resent.
+  CHECK_TRUE(sendChunk(1, 4, 4));
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+}
+
+TEST(fmt_update, shortChunkThatIsntLast_requestsResend)
+{
+  sendChunk(0, 4, 5);
+  msg.chunkIndex = 1;
+  msg.payload.size = 1;
+  CHECK_FALSE(handleImageData(msg));
+  checkStatusSent(0, PageStatusEnum_REQUEST_RESEND);
+  CHECK_EQUAL(0xE, rxMsg.sub.PageStatus.missingChunks);
+}
+
+TEST(fmt_update, duplicateChunk_ignored)
+{
+  sendChunk(0, 2, 6);
+  CHECK_TRUE(sendChunk(0, 2, 6));
+  CHECK_TRUE(sendChunk(1, 2, 6));
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+}
+
+TEST(fmt_update, writtenPageResent_ackedAgain)
+{
+  fmt_setFirstPageReceivedCallback(onDownloadStart);
+  sendPage(0, 7);
+  fmt_handleUpdate();
+  fmt_sendMsg((Top){0}); // Clear the spy.
+
+  // The ack was lost, so the sender resends the page.
+  CHECK_TRUE(sendPage(0, 7));
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+  fmt_handleUpdate();
+  CHECK_EQUAL(1, downloadStartCount);
+}
+
+TEST(fmt_update, pageCrcs_matchPagesAlreadyInFlash)
+{
+  sendPage(0, 12);
+  fmt_handleUpdate();
+
+  // The target restarted, so it only knows the image from flash.
+  uint32_t crc = sentPageCrc();
+  CHECK_EQUAL(0x1, checkPagesPresent(13, crc, crc + 1));
+  CHECK_EQUAL(0x0, checkPagesPresent(14, crc + 1, crc + 1));
+}
+
+TEST(fmt_update, pageCrcs_pagesPresentNotRewritten)
+{
+  fmt_setFirstPageReceivedCallback(onDownloadStart);
+  fmt_setDownloadFinishCallback(onDownloadFinish);
+  sendPage(0, 15);
+  fmt_handleUpdate();
+
+  CHECK_EQUAL(0x1, checkPagesPresent(2, sentPageCrc(), 0));
+  CHECK_EQUAL(0, downloadFinishCount);
+  sendPage(1, 2);
+  fmt_handleUpdate();
+  CHECK_EQUAL(1, downloadFinishCount);
+  CHECK_EQUAL(0x3, checkPagesPresent(2, sentPageCrc(), sentPageCrc()));
+}
+
+TEST(fmt_update, packedPage_unpackedIntoFlash)
+{
+  // A page of 7s: a literal, then matches of 66, 66, 66 and 57 bytes from 1
+  // back.
+  const uint8_t packed[] = {0, 7, 0xBF, 0, 0xBF, 0, 0xBF, 0, 0xB6, 0};
+  memcpy(msg.payload.bytes, packed, sizeof(packed));
+  msg.payload.size = sizeof(packed);
+  msg.packed = true;
+  msg.pageIndex = 0;
+  msg.pageCount = 16;
+  msg.chunkIndex = 0;
+  msg.chunkCountInPage = 1;
   CHECK_TRUE(handleImageData(msg));
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+
+  uint8_t page[UPDATE_PAGE_SIZE];
+  memset(page, 7, sizeof(page));
+  CHECK_EQUAL(0x1, checkPagesPresent(17, crc32(page, sizeof(page)), 0));
 }
 
-// TEST(fmt_update, singleMessageImage_firsPageCallback_calledOnce)
-// {
-// }
+TEST(fmt_update, packedPageOfWrongSize_fails)
+{
+  // 1 + 4 * 66 bytes.
+  const uint8_t packed[] = {0, 7, 0xBF, 0, 0xBF, 0, 0xBF, 0, 0xBF, 0};
+  memcpy(msg.payload.bytes, packed, sizeof(packed));
+  msg.payload.size = sizeof(packed);
+  msg.packed = true;
+  msg.pageCount = 18;
+  msg.chunkCountInPage = 1;
+  CHECK_TRUE(handleImageData(msg));
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_FAIL);
+}
 
-// TEST(fmt_update, badImageData_triggersFailMessage)
-// {
-// }
\ No newline at end of file
+TEST(fmt_update, deltaPage_copiesFromRunningImage)
+{
+  uint8_t page[UPDATE_PAGE_SIZE];
+  memset(page, 5, sizeof(page));
+  fmt_flash_write(FMT_IMAGE_ACTIVE_ADDRESS + UPDATE_PAGE_SIZE, page,
+                  sizeof(page));
+  fmt_setBuildIdGetter(getBuildId);
+
+  // Page 1 is the running image's page 1 with its first byte changed.
+  const uint8_t delta[] = {0, 9, 0xC0, 0, 0, UPDATE_PAGE_SIZE - 2};
+  memcpy(msg.payload.bytes, delta, sizeof(delta));
+  msg.payload.size = sizeof(delta);
+  msg.packed = true;
+  msg.baseBuildId = 0xB1D;
+  msg.pageIndex = 1;
+  msg.pageCount = 19;
+  msg.chunkIndex = 0;
+  msg.chunkCountInPage = 1;
+  CHECK_TRUE(handleImageData(msg));
+  fmt_handleUpdate();
+  checkStatusSent(1, PageStatusEnum_WRITE_SUCCESS);
+
+  page[0] = 9;
+  handlePageCrcs((PageCrcs){
+      .pageCount = 20, .firstPageIndex = 1, .crcs_count = 1,
+      .crcs = {crc32(page, sizeof(page))}});
+  CHECK_TRUE(fmt_getMsg(&rxMsg));
+  CHECK_EQUAL(0x1, rxMsg.sub.PagesPresent.present);
+}
+
+TEST(fmt_update, deltaForOtherBuild_fails)
+{
+  fmt_setBuildIdGetter(getBuildId);
+  msg.packed = true;
+  msg.baseBuildId = 0xB1E;
+  msg.pageCount = 21;
+  msg.chunkCountInPage = 1;
+  CHECK_FALSE(handleImageData(msg));
+  checkStatusSent(0, PageStatusEnum_WRITE_FAIL);
+}
+
+TEST(fmt_update, sectorErasedAheadOfFirstWrite)
+{
+  uint8_t stale[UPDATE_PAGE_SIZE] = {1, 2, 3};
+  uint32_t page1Address = FMT_IMAGE_DOWNLOAD_ADDRESS + UPDATE_PAGE_SIZE;
+  fmt_flash_write(page1Address, stale, sizeof(stale));
+
+  sendPage(0, 22);
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+  CHECK_TRUE(flash_isErased(page1Address, UPDATE_PAGE_SIZE));
+}
+
+TEST(fmt_update, resumedPageBesideStaleData_requestedAgain)
+{
+  sendPage(0, 23);
+  fmt_handleUpdate();
+  // The target restarted mid-way through writing page 1.
+  uint8_t stale[UPDATE_PAGE_SIZE] = {1, 2, 3};
+  fmt_flash_write(FMT_IMAGE_DOWNLOAD_ADDRESS + UPDATE_PAGE_SIZE, stale,
+                  sizeof(stale));
+  CHECK_EQUAL(0x1, checkPagesPresent(24, sentPageCrc(), 0));
+
+  // Page 0's sector must be erased before page 1 can be written.
+  sendPage(1, 24);
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_REQUEST_RESEND);
+  fmt_handleUpdate();
+  checkStatusSent(1, PageStatusEnum_WRITE_SUCCESS);
+  CHECK_EQUAL(0x2, checkPagesPresent(24, sentPageCrc(), sentPageCrc()));
+}
+
+TEST(fmt_update, pageCrcs_donePageOfOtherImage_notPresent)
+{
+  sendPage(0, 25);
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+
+  // That upload was abandoned; another build of the same size follows.
+  CHECK_EQUAL(0x0, checkPagesPresent(25, sentPageCrc() + 1, 0));
+  msg.payload.bytes[0] = 9;
+  sendPage(0, 25);
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+  CHECK_EQUAL(0x1, checkPagesPresent(25, sentPageCrc(), 0));
+}
+
+TEST(fmt_update, pageCountBeyondPartition_rejectedWithoutErasing)
+{
+  // The sector past the download partition holds another image.
+  const uint32_t pagesMax = FMT_IMAGE_DOWNLOAD_PARTITION_SIZE / UPDATE_PAGE_SIZE;
+  const uint32_t beyond =
+      FMT_IMAGE_DOWNLOAD_ADDRESS + FMT_IMAGE_DOWNLOAD_PARTITION_SIZE;
+  uint8_t other[UPDATE_PAGE_SIZE] = {1, 2, 3};
+  fmt_flash_write(beyond, other, sizeof(other));
+
+  CHECK_EQUAL(0x0, checkPagesPresent(pagesMax + 1, sentPageCrc(), 0));
+  CHECK_FALSE(sendPage(0, pagesMax + 1));
+  checkStatusSent(0, PageStatusEnum_WRITE_FAIL);
+  CHECK_FALSE(sendPage(0, 0));
+  checkStatusSent(0, PageStatusEnum_WRITE_FAIL);
+  for (uint32_t i = 0; i < pagesMax; i++)
+    fmt_handleUpdate();
+
+  CHECK_FALSE(flash_isErased(beyond, UPDATE_PAGE_SIZE));
+  uint8_t readBack[UPDATE_PAGE_SIZE];
+  fmt_flash_read(beyond, readBack, sizeof(readBack));
+  MEMCMP_EQUAL(other, readBack, sizeof(other));
+}
+
+TEST(fmt_update, newImageId_dropsPagesDoneForTheLast)
+{
+  msg.imageId = 1;
+  sendPage(0, 26);
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+
+  // Another build of the same size, sent without PageCrcs first.
+  msg.imageId = 2;
+  msg.payload.bytes[0] = 9;
+  sendPage(0, 26);
+  fmt_handleUpdate();
+  checkStatusSent(0, PageStatusEnum_WRITE_SUCCESS);
+  uint8_t written;
+  fmt_flash_read(FMT_IMAGE_DOWNLOAD_ADDRESS, &written, 1);
+  CHECK_EQUAL(9, written);
+}
@@ -0,0 +1,227 @@
+#include <CppUTest/TestHarness.h>
+#include <math.h>
+#include <string.h>
+
+extern "C"
+{
+#include <fmt_waveform.h>
+#include <fmt_waveform_cfg.h> // MAX_NUM_WAVES
+#include <fmt_log.h>             // fmt_drainLog()
+#include <fmt_sizes.h>           // LOG_RING_LENGTH
+#include "stub_comms.h"
+}
+
+#define UPDATE_FREQ_HZ 1000.0F
+#define TWO_PI 6.283185307F
+// Linear interpolation of a 256-entry LUT is good to ~8e-5.
+#define SINE_TOLERANCE 2e-4
+
+// waves can't be removed, so the registered wave is added only once.
+static wave_t registered;
+static bool registeredAdded = false;
+
+TEST_GROUP(fmt_waveform)
+{
+  wave_t wave;
+  void setup()
+  {
+    UT_PTR_SET(fmt_sendMsg, fmt_sendMsg_test);
+    UT_PTR_SET(fmt_getMsg, fmt_getMsg_test);
+    UT_PTR_SET(fmt_getSendSpace, fmt_getSendSpace_test);
+    wave_initAll(UPDATE_FREQ_HZ);
+    wave = (wave_t){
+        .offset = 0.0F,
+        .amplitude = 1.0F,
+        .max = 10.0F,
+        .min = -10.0F,
+        .shape = WAVE_SHAPE_SINE};
+    if (!registeredAdded)
+    {
+      CHECK(wave_add(&registered));
+      registeredAdded = true;
+    }
+    registered = wave;
+  }
+
+  void teardown()
+  {
+    // Send the table-upload logs so they don't fill the log ring.
+    for (uint32_t i = 0; i < LOG_RING_LENGTH; i++)
+      fmt_drainLog();
+  }
+};
+
+TEST(fmt_waveform, sine_matchesSinf)
+{
+  for (float rad = 0.0F; rad < TWO_PI; rad += 0.01F)
+  {
+    wave_setPhase(&wave, rad);
+    DOUBLES_EQUAL(sinf(rad), wave_getValue(&wave), SINE_TOLERANCE);
+  }
+}
+
+TEST(fmt_waveform, setPhase_wrapsNegativeAndLarge)
+{
+  wave_setPhase(&wave, -1.0F);
+  DOUBLES_EQUAL(sinf(-1.0F), wave_getValue(&wave), SINE_TOLERANCE);
+  wave_setPhase(&wave, 100.0F);
+  DOUBLES_EQUAL(sinf(100.0F), wave_getValue(&wave), 1e-3);
+}
+
+TEST(fmt_waveform, squareAndSawtooth_fromPhase)
+{
+  wave.shape = WAVE_SHAPE_SQUARE;
+  wave_setPhase(&wave, 1.0F);
+  DOUBLES_EQUAL(-1.0F, wave_getValue(&wave), 0.0);
+  wave_setPhase(&wave, 4.0F);
+  DOUBLES_EQUAL(1.0F, wave_getValue(&wave), 0.0);
+
+  wave.shape = WAVE_SHAPE_SAWTOOTH;
+  wave_setPhase(&wave, 0.0F);
+  DOUBLES_EQUAL(-1.0F, wave_getValue(&wave), 1e-6);
+  wave_setPhase(&wave, TWO_PI / 2);
+  DOUBLES_EQUAL(0.0F, wave_getValue(&wave), 1e-6);
+  wave_setPhase(&wave, TWO_PI * 0.75F);
+  DOUBLES_EQUAL(0.5F, wave_getValue(&wave), 1e-6);
+}
+
+TEST(fmt_waveform, getValue_clampsToLimits)
+{
+  wave.offset = 0.5F;
+  wave.max = 1.0F;
+  wave.min = 0.0F;
+  wave_setPhase(&wave, TWO_PI / 4);
+  DOUBLES_EQUAL(1.0F, wave_getValue(&wave), 0.0);
+  wave_setPhase(&wave, TWO_PI * 0.75F);
+  DOUBLES_EQUAL(0.0F, wave_getValue(&wave), 0.0);
+}
+
+TEST(fmt_waveform, updateAll_noDriftOverManyPeriods)
+{
+  // 0.1 Hz at 1 kHz: a float phase accumulator drifts noticeably by now.
+  wave_setFrequency(0, 0.1F);
+  for (uint32_t i = 0; i < 250000; i++)
+    wave_updateAll();
+  // 25 periods in; the integer delta is truncated, so allow a few counts.
+  DOUBLES_EQUAL(0.0F, wave_getValue(&registered), 1e-3);
+}
+
+TEST(fmt_waveform, updateAll_negativeFrequencyRunsBackwards)
+{
+  wave_setFrequency(0, -250.0F); // quarter period per update, backwards.
+  wave_updateAll();
+  DOUBLES_EQUAL(-1.0F, wave_getValue(&registered), SINE_TOLERANCE);
+}
+
+TEST(fmt_waveform, fillBlock_matchesGetValueAndAdvancesPhase)
+{
+  // Values in output counts, e.g. a 12-bit DAC.
+  registered.offset = 2048.0F;
+  registered.amplitude = 2000.0F;
+  registered.max = 4095.0F;
+  registered.min = 0.0F;
+  wave_setFrequency(0, 7.0F);
+  wave_t reference = registered;
+
+  int16_t block[64];
+  CHECK_EQUAL(64, wave_fillBlock(0, block, 64));
+  for (uint32_t i = 0; i < 64; i++)
+  {
+    DOUBLES_EQUAL(wave_getValue(&reference), block[i], 0.5);
+    reference.phase += reference.deltaPhasePerUpdate;
+  }
+  CHECK_EQUAL(reference.phase, registered.phase);
+}
+
+TEST(fmt_waveform, fillBlock_saturatesToInt16)
+{
+  registered.shape = WAVE_SHAPE_SQUARE;
+  registered.amplitude = 1e6F;
+  registered.max = 1e6F;
+  registered.min = -1e6F;
+  int16_t block[2];
+  wave_setFrequency(0, 500.0F); // half a period per sample.
+  wave_setPhase(&registered, 1.0F);
+  wave_fillBlock(0, block, 2);
+  CHECK_EQUAL(INT16_MIN, block[0]);
+  CHECK_EQUAL(INT16_MAX, block[1]);
+}
+
+TEST(fmt_waveform, fillBlock_badIdWritesNothing)
+{
+  int16_t block[1] = {123};
+  CHECK_EQUAL(0, wave_fillBlock(MAX_NUM_WAVES, block, 1));
+  CHECK_EQUAL(123, block[0]);
+}
+
+TEST(fmt_waveform, arbitrary_interpolatesBetweenSamples)
+{
+  const int16_t table[] = {0, 16384, 0, -16384, -32768};
+  CHECK(wave_setTable(0, table, 5));
+  registered.shape = WAVE_SHAPE_ARBITRARY;
+
+  registered.phase = 0;
+  DOUBLES_EQUAL(0.0F, wave_getValue(&registered), 1e-4);
+  registered.phase = 0x80000000U / 5; // half way from sample 0 to 1.
+  DOUBLES_EQUAL(0.25F, wave_getValue(&registered), 1e-4);
+  registered.phase = 0xFFFFFFFFU; // last sample, interpolating back to first.
+  DOUBLES_EQUAL(0.0F, wave_getValue(&registered), 1e-3);
+}
+
+TEST(fmt_waveform, arbitrary_withoutTableIsOffset)
+{
+  CHECK(wave_setTable(0, NULL, 0));
+  registered.shape = WAVE_SHAPE_ARBITRARY;
+  registered.offset = 0.5F;
+  DOUBLES_EQUAL(0.5F, wave_getValue(&registered), 0.0);
+  CHECK_FALSE(wave_setTable(0, NULL, 4));
+}
+
+TEST(fmt_waveform, harmonics_sumTones)
+{
+  const waveHarmonic_t tones[] = {
+      {.multiple = 1, .amplitude = 1.0F},
+      {.multiple = 3, .amplitude = 0.5F, .phase = 0x40000000U}, // cos
+  };
+  CHECK(wave_setHarmonics(0, tones, 2));
+  registered.shape = WAVE_SHAPE_HARMONICS;
+  for (float rad = 0.0F; rad < TWO_PI; rad += 0.1F)
+  {
+    wave_setPhase(&registered, rad);
+    DOUBLES_EQUAL(sinf(rad) + 0.5F * cosf(3 * rad),
+                  wave_getValue(&registered), 2 * SINE_TOLERANCE);
+  }
+}
+
+TEST(fmt_waveform, waveTable_uploadInChunks)
+{
+  WaveTable msg = {.waveId = 0, .chunkCount = 2};
+  msg.payload.size = 4;
+  const uint8_t first[] = {0x00, 0x40, 0x00, 0x00}; // 16384, 0
+  memcpy(msg.payload.bytes, first, sizeof(first));
+  handleWaveTable(msg);
+
+  msg.chunkIndex = 1;
+  msg.payload.size = 2;
+  const uint8_t second[] = {0x00, 0xC0}; // -16384
+  memcpy(msg.payload.bytes, second, sizeof(second));
+  handleWaveTable(msg);
+
+  CHECK_EQUAL(3, registered.tableLen);
+  CHECK_EQUAL(16384, registered.table[0]);
+  CHECK_EQUAL(-16384, registered.table[2]);
+}
+
+TEST(fmt_waveform, waveTable_outOfOrderChunkRejected)
+{
+  CHECK(wave_setTable(0, NULL, 0));
+  WaveTable msg = {.waveId = 0, .chunkIndex = 1, .chunkCount = 2};
+  msg.payload.size = 2;
+  handleWaveTable(msg);
+
+  Top sent = {0};
+  fmt_drainLog();
+  CHECK(fmt_getMsg(&sent));
+  CHECK_EQUAL(Top_Log_tag, sent.which_sub);
+  CHECK_EQUAL(0, registered.tableLen);
+}
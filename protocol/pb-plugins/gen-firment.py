@@ -1,10 +1,12 @@
 #!/usr/bin/env python3
 
+import math
 import sys
 from pathlib import Path
 from google.protobuf.compiler.plugin_pb2 import CodeGeneratorResponse, CodeGeneratorRequest
 from google.protobuf.descriptor_pb2 import FileDescriptorProto, DescriptorProto
 from google.protobuf.descriptor import FieldDescriptor
+from param_table import Param, get_param_table, get_table_hash
 
 MARKER = '/*--GENERATED CONTENT MARKER--*/'
 
@@ -38,9 +40,50 @@ def generate_code(request: CodeGeneratorRequest) -> str:
 
   return static_content_with_marker.replace(MARKER, dynamic_content)
 
+def get_c_value(param: Param, value) -> str:
+  if param.type == "FLOAT":
+    if value in (-math.inf, math.inf):
+      return f'{{.f = {"-" if value < 0 else ""}INFINITY}}'
+    return f"{{.f = {float(value)!r}F}}"
+  if param.type == "INT":
+    # INT32_MIN can't be written as a literal.
+    return f"{{.i = {value}}}" if value > -2**31 else "{.i = INT32_MIN}"
+  return f"{{.u = {value}U}}"
+
+def generate_param_table(request: CodeGeneratorRequest) -> str:
+  params = get_param_table(request)
+  entries = ""
+  for param in params:
+    entries += f'''    {{.name = "{param.name}",
+     .id = {param.id},
+     .type = FMT_PARAM_{param.type},
+     .min = {get_c_value(param, param.min)},
+     .max = {get_c_value(param, param.max)},
+     .initial = {get_c_value(param, param.initial)}}},
+'''
+  max_id = max((param.id for param in params), default=0)
+  return f'''// Generated file, do not track.  Made by gen-firment.py from the Params
+// message; see param_table.py.
+#include <fmt_params.h>
+#include <math.h>
+
+_Static_assert({max_id} < FMT_PARAMS_ID_MAX, "Params field number too big");
+
+const fmt_paramInfo_t fmt_paramTable[] = {{
+{entries.rstrip() or "    {0},"}
+}};
+const uint32_t fmt_paramCount = {len(params)};
+const uint32_t fmt_paramTableHash = {get_table_hash(params):#010x};
+'''
+
 if __name__ == "__main__":
   request = CodeGeneratorRequest.FromString(sys.stdin.buffer.read())
   response = CodeGeneratorResponse()
   widgets_file = response.file.add(name="fmt_rx.pb.c")
   widgets_file.content = generate_code(request)
+  try:
+    response.file.add(name="fmt_params.pb.c",
+                      content=generate_param_table(request))
+  except ValueError as error:
+    response.error = str(error)
   sys.stdout.buffer.write(response.SerializeToString())
\ No newline at end of file
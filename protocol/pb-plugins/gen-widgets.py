@@ -1,11 +1,19 @@
 #!/usr/bin/env python3
 
+import math
 import sys
+from pathlib import Path
 from typing import Dict
 from google.protobuf.compiler.plugin_pb2 import CodeGeneratorResponse, CodeGeneratorRequest
 from google.protobuf.descriptor_pb2 import FileDescriptorProto, DescriptorProto, EnumDescriptorProto, FieldDescriptorProto
 from google.protobuf.descriptor import FieldDescriptor
 
+# Importing nanopb_pb2 registers the (nanopb) field options, so values such as
+# max_count can be read from field.options once the request is parsed.
+sys.path.insert(0, str(Path(__file__).parent.parent / "nanopb/generator"))
+from proto import nanopb_pb2
+from param_table import Param, get_param_table, get_table_hash
+
 
 header = """\
 // Generated File, do not track.
@@ -49,6 +57,9 @@ def get_ctl_widget(message: DescriptorProto, enums: Dict[str, EnumDescriptorProt
   initial_state = {}
 
   for field in message.field:
+    if field.label == FieldDescriptorProto.LABEL_REPEATED:
+      field_strings += get_repeated_ctl_field(field, enums, initial_state)
+      continue
     if field.type in integer_fields:
       initial_state[field.name] = 0
       field_strings += f'''
@@ -114,6 +125,29 @@ export function {message.name}({{}}) {{
 }}
 '''
 
+def get_repeated_ctl_field(field: FieldDescriptorProto, enums, initial_state):
+  """ Repeated enums get one <select> per element, up to the nanopb max_count.
+  Other repeated types are not yet supported by Ctl widgets. """
+  if field.type != FieldDescriptor.TYPE_ENUM:
+    return ""
+  max_count = field.options.Extensions[nanopb_pb2.nanopb].max_count
+  initial_state[field.name] = [0] * max_count
+  options = get_options_from_enum(enums, field)
+
+  field_strings = ""
+  for index in range(max_count):
+    field_strings += f'''
+      <label>
+        <select name="{field.name}_{index}" value={{state.{field.name}[{index}]}}
+          onChange={{e => setState({{
+            ...state, {field.name}:state.{field.name}.map((v, i) =>
+              i === {index} ? Number(e.target.value) : v)}})}}>{options}
+        </select>
+        {field.name}_{index}
+      </label>
+      <br/>'''
+  return field_strings
+
 def get_tlm_widget(message: DescriptorProto, enums: Dict[str, EnumDescriptorProto]):
   # spec a div with a name
   message_name = message.name
@@ -222,9 +256,43 @@ def generate_widgets(request: CodeGeneratorRequest) -> str:
   # body += request.source_file_descriptors + "\n"
   return header + enum_strings + widget_functions
 
+def get_ts_value(value) -> str:
+  if value in (-math.inf, math.inf):
+    return "-Infinity" if value < 0 else "Infinity"
+  return repr(value)
+
+def generate_param_table(request: CodeGeneratorRequest) -> str:
+  params = get_param_table(request)
+  entries = ""
+  for param in params:
+    entries += (f'\n  {{ name: "{param.name}", id: {param.id}, '
+                f'type: "{param.type.lower()}", min: {get_ts_value(param.min)}, '
+                f'max: {get_ts_value(param.max)}, '
+                f'initial: {get_ts_value(param.initial)} }},')
+  return f'''// Generated File, do not track.
+// The parameter table of fmt_params.pb.c, in the same order.  See param_table.py
+export type ParamType = "float" | "int" | "uint" | "bool";
+export interface ParamInfo {{
+  name: string;
+  id: number;
+  type: ParamType;
+  min: number;
+  max: number;
+  initial: number;
+}}
+export const paramTableHash = {get_table_hash(params):#010x};
+export const paramTable: ParamInfo[] = [{entries}
+];
+'''
+
 if __name__ == "__main__":
   request = CodeGeneratorRequest.FromString(sys.stdin.buffer.read())
   response = CodeGeneratorResponse()
   widgets_file = response.file.add(name="widgets.pb.tsx")
   widgets_file.content = generate_widgets(request)
+  try:
+    response.file.add(name="params.pb.ts",
+                      content=generate_param_table(request))
+  except ValueError as error:
+    response.error = str(error)
   sys.stdout.buffer.write(response.SerializeToString())
\ No newline at end of file
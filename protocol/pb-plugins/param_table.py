@@ -0,0 +1,104 @@
+"""Reads the parameter table from the project's Params message.
+
+Each field of Params is a persistent parameter (see fmt_params.h) and its field
+number is the parameter id.  A field's trailing comment may give its range and
+default value, eg.
+
+    float gainA = 4; // [0, 10] default 1
+
+Unranged parameters may take any value of their type; the default default is 0.
+Parameters are listed in id order; a parameter's index in the table is how
+ParamValues addresses it.  The table hash changes with any name, id, type,
+range or default, so the UI and target can tell when they were built from
+different tables.
+"""
+
+import math
+import re
+import zlib
+from typing import List, NamedTuple
+
+from google.protobuf.compiler.plugin_pb2 import CodeGeneratorRequest
+from google.protobuf.descriptor_pb2 import FileDescriptorProto, FieldDescriptorProto
+from google.protobuf.descriptor import FieldDescriptor
+
+PARAMS_MESSAGE = "Params"
+
+# Parameter type: (proto field types, lowest value, highest value)
+TYPES = {
+  "FLOAT": ((FieldDescriptor.TYPE_FLOAT,), -math.inf, math.inf),
+  "INT": ((FieldDescriptor.TYPE_INT32, FieldDescriptor.TYPE_SINT32,
+           FieldDescriptor.TYPE_SFIXED32), -2**31, 2**31 - 1),
+  "UINT": ((FieldDescriptor.TYPE_UINT32, FieldDescriptor.TYPE_FIXED32),
+           0, 2**32 - 1),
+  "BOOL": ((FieldDescriptor.TYPE_BOOL,), 0, 1),
+}
+
+NUMBER = r"[-+]?(?:\d+\.?\d*|\.\d+)(?:[eE][-+]?\d+)?"
+RANGE_RE = re.compile(rf"\[\s*({NUMBER})\s*,\s*({NUMBER})\s*\]")
+DEFAULT_RE = re.compile(rf"\bdefault\s+({NUMBER}|true|false)\b")
+
+class Param(NamedTuple):
+  name: str
+  id: int
+  type: str  # a key of TYPES
+  min: float
+  max: float
+  initial: float
+
+
+def parse_number(text: str, param_type: str):
+  if text in ("true", "false"):
+    return int(text == "true")
+  return float(text) if param_type == "FLOAT" else int(float(text))
+
+
+def get_param(field, comment: str) -> Param:
+  param_type = next((name for name, (field_types, _, _) in TYPES.items()
+                     if field.type in field_types), None)
+  if param_type is None or field.label == FieldDescriptorProto.LABEL_REPEATED:
+    raise ValueError(f"Params.{field.name}: parameters must be a single "
+                     "float, int32, uint32 or bool.")
+  _, low, high = TYPES[param_type]
+
+  range_match = RANGE_RE.search(comment)
+  if range_match:
+    low, high = (parse_number(text, param_type) for text in range_match.groups())
+  default_match = DEFAULT_RE.search(comment)
+  initial = parse_number(default_match.group(1), param_type) if default_match \
+    else max(low, min(high, 0))
+  if not low <= initial <= high:
+    raise ValueError(f"Params.{field.name}: default {initial} is outside "
+                     f"[{low}, {high}].")
+  return Param(field.name, field.number, param_type, low, high, initial)
+
+
+def get_trailing_comments(proto: FileDescriptorProto, message_index: int):
+  """ Maps field index to its trailing comment. """
+  comments = {}
+  for location in proto.source_code_info.location:
+    path = list(location.path)
+    # 4: FileDescriptorProto.message_type, 2: DescriptorProto.field
+    if len(path) == 4 and path[:3] == [4, message_index, 2]:
+      comments[path[3]] = location.trailing_comments
+  return comments
+
+
+def get_param_table(request: CodeGeneratorRequest) -> List[Param]:
+  for file_name in request.file_to_generate:
+    proto = next(file for file in request.proto_file if file.name == file_name)
+    for message_index, message in enumerate(proto.message_type):
+      if message.name != PARAMS_MESSAGE:
+        continue
+      comments = get_trailing_comments(proto, message_index)
+      params = [get_param(field, comments.get(index, ""))
+                for index, field in enumerate(message.field)]
+      return sorted(params, key=lambda param: param.id)
+  return []
+
+
+def get_table_hash(params: List[Param]) -> int:
+  text = "".join(f"{p.name}:{p.id}:{p.type}:{p.min!r}:{p.max!r}:{p.initial!r}\n"
+                 for p in params)
+  return zlib.crc32(text.encode())
+
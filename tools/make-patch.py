@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Makes a delta-update patch for the FW Update widget of the web UI.
+
+Each page of the new image is packed in the fmt_unpack.h format, copying from
+the old image (the build running on the target) wherever they match, so an
+update that changes a few functions costs a few pages of literals.  The target
+checks Version.buildId before applying it, so pass the buildId the FW Meta
+widget shows for the running build.
+
+Patch file (little-endian):
+    "FMTP", u32 baseBuildId, u32 pageSize, u32 pageCount
+    per page: u32 crc32 of the page (padded with 0xFF), u8 packed, u16 size,
+              size bytes of page data.
+
+Usage: make-patch.py old.bin new.bin <baseBuildId> patch.fmtp [--page-size N]
+"""
+
+import argparse
+import struct
+import zlib
+
+MATCH_MIN = 3
+MATCH_MAX = 0x3F + MATCH_MIN
+DISTANCE_MAX = 256
+LITERAL_RUN_MAX = 0x80
+BASE_COPY_MIN = 5  # a base copy token is 4 bytes.
+BASE_COPY_MAX = 256
+BASE_OFFSET_LIMIT = 1 << 21  # signed 22-bit
+KEY_SIZE = 4
+CANDIDATES_MAX = 16
+
+
+def match_length(a, a_pos, b, b_pos, max_len):
+    length = 0
+    while (length < max_len and b_pos + length < len(b)
+           and a[a_pos + length] == b[b_pos + length]):
+        length += 1
+    return length
+
+
+class Packer:
+    def __init__(self, old):
+        self.old = old
+        self.index = {}
+        for pos in range(len(old) - KEY_SIZE + 1):
+            self.index.setdefault(old[pos:pos + KEY_SIZE], []).append(pos)
+        self.last_offset = 0
+
+    def best_base_copy(self, page, pos, base_pos):
+        max_len = min(BASE_COPY_MAX, len(page) - pos)
+        # Unchanged code usually sits where the previous copy left off.
+        candidates = [base_pos + self.last_offset]
+        positions = self.index.get(page[pos:pos + KEY_SIZE], [])
+        positions = sorted(positions, key=lambda p: abs(p - base_pos))
+        candidates += positions[:CANDIDATES_MAX]
+
+        best_len, best_offset = 0, 0
+        for cand in candidates:
+            offset = cand - base_pos
+            if not (0 <= cand < len(self.old)) or abs(offset) >= BASE_OFFSET_LIMIT:
+                continue
+            length = match_length(page, pos, self.old, cand, max_len)
+            if length > best_len:
+                best_len, best_offset = length, offset
+        return best_len, best_offset
+
+    @staticmethod
+    def best_match(page, pos):
+        max_len = min(MATCH_MAX, len(page) - pos)
+        best_len, best_distance = 0, 0
+        for distance in range(1, min(DISTANCE_MAX, pos) + 1):
+            length = match_length(page, pos, page, pos - distance, max_len)
+            if length > best_len:
+                best_len, best_distance = length, distance
+        return best_len, best_distance
+
+    def pack(self, page, page_start):
+        out = bytearray()
+        literal_start = 0
+
+        def flush_literals(end):
+            for start in range(literal_start, end, LITERAL_RUN_MAX):
+                run = page[start:min(end, start + LITERAL_RUN_MAX)]
+                out.append(len(run) - 1)
+                out.extend(run)
+
+        pos = 0
+        while pos < len(page):
+            copy_len, offset = self.best_base_copy(page, pos, page_start + pos)
+            match_len, distance = self.best_match(page, pos)
+            if copy_len >= BASE_COPY_MIN and copy_len - 4 >= match_len - 2:
+                flush_literals(pos)
+                field = offset & (BASE_OFFSET_LIMIT * 2 - 1)
+                out += bytes([0xC0 | (field >> 16), field & 0xFF,
+                              (field >> 8) & 0xFF, copy_len - 1])
+                self.last_offset = offset
+                pos += copy_len
+                literal_start = pos
+            elif match_len >= MATCH_MIN:
+                flush_literals(pos)
+                out += bytes([0x80 | (match_len - MATCH_MIN), distance - 1])
+                pos += match_len
+                literal_start = pos
+            else:
+                pos += 1
+        flush_literals(pos)
+        return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old", help="image running on the target (.bin)")
+    parser.add_argument("new", help="image to update to (.bin)")
+    parser.add_argument("base_build_id", type=lambda s: int(s, 0),
+                        help="Version.buildId of the running image")
+    parser.add_argument("patch", help="output file")
+    parser.add_argument("--page-size", type=int, default=256,
+                        help="UPDATE_PAGE_SIZE from firmentConfig.cmake")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    page_size = args.page_size
+    page_count = (len(new) + page_size - 1) // page_size
+    packer = Packer(old)
+    out = bytearray(b"FMTP")
+    out += struct.pack("<III", args.base_build_id, page_size, page_count)
+
+    for page_index in range(page_count):
+        page = new[page_index * page_size:(page_index + 1) * page_size]
+        page = page.ljust(page_size, b"\xff")
+        packed = packer.pack(page, page_index * page_size)
+        is_packed = len(packed) < page_size
+        data = packed if is_packed else page
+        out += struct.pack("<IBH", zlib.crc32(page), is_packed, len(data))
+        out += data
+
+    with open(args.patch, "wb") as f:
+        f.write(out)
+    print(f"{args.patch}: {len(out)} bytes for a {len(new)} byte image")
+
+
+if __name__ == "__main__":
+    main()
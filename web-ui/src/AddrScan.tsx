@@ -0,0 +1,116 @@
+import { useState } from "react";
+import { addrProbeMaxCount } from "./generated/probeConfig";
+import { ProbeSrcType, SampleFreq } from "./generated/messages";
+import { sendMessage } from "./mqclient";
+import { ElfSymbol, readElfSymbols } from "./elfSymbols";
+import { setAddrProbeNames } from "./plot/plotModel";
+
+type AddrProbe = {
+  name: string;
+  type: number;
+};
+
+// A guess only: 4-byte objects could just as well be (u)int32.
+function defaultType(size: number) {
+  switch (size) {
+    case 1: return ProbeSrcType.SRC_UINT8;
+    case 2: return ProbeSrcType.SRC_INT16;
+    default: return ProbeSrcType.SRC_FLOAT;
+  }
+}
+
+export default function AddrScan({ }) {
+  const [symbols, setSymbols] = useState<ElfSymbol[]>([]);
+  const [probes, setProbes] = useState<AddrProbe[]>([]);
+  const [freq, setFreq] = useState(0);
+  const [status, setStatus] = useState("No ELF loaded");
+
+  async function handleFileChange(e: React.ChangeEvent<HTMLInputElement>) {
+    e.preventDefault();
+    if (e.currentTarget.files) {
+      try {
+        const elf = await e.currentTarget.files[0].arrayBuffer();
+        const found = readElfSymbols(elf);
+        setSymbols(found);
+        setStatus(`${found.length} symbols loaded`);
+      } catch (err) {
+        setSymbols([]);
+        setStatus(`Failed: ${(err as Error).message}`);
+      }
+    }
+  }
+
+  function setProbeName(index: number, name: string) {
+    const symbol = symbols.find((s) => s.name === name);
+    setProbes(probes.map((probe, i) => (i !== index) ? probe :
+      { name, type: symbol ? defaultType(symbol.size) : probe.type }));
+  }
+
+  function handleSubmit(e: React.FormEvent) {
+    e.preventDefault();
+    let addresses: number[] = [];
+    let types: number[] = [];
+    for (const probe of probes) {
+      const symbol = symbols.find((s) => s.name === probe.name);
+      if (!symbol) {
+        setStatus(`Failed: unknown symbol '${probe.name}'`);
+        return;
+      }
+      addresses.push(symbol.address);
+      types.push(probe.type);
+    }
+    setAddrProbeNames(probes.map((probe) => probe.name));
+    sendMessage("RunAddrScan", { freq, addresses, types });
+    setStatus(`Scanning ${addresses.length} addresses`);
+  }
+
+  const typeOptions = Object.entries(ProbeSrcType).map(([name, value]) =>
+    <option key={name} value={value}>{name}</option>);
+
+  return (
+    <details className="widget">
+      <summary>Address Scan</summary>
+      <form aria-label="Address Scan" onSubmit={handleSubmit}>
+        <label>Choose the firmware ELF<br />
+          <input type="file" name="elf-file" accept=".elf"
+            onChange={handleFileChange} />
+        </label>
+        <datalist id="elf-symbols">
+          {symbols.map((s) => <option key={s.name} value={s.name} />)}
+        </datalist>
+        {probes.map((probe, index) =>
+          <p key={index}>
+            <input list="elf-symbols" name={`symbol_${index}`} value={probe.name}
+              onChange={e => setProbeName(index, e.target.value)} />
+            <select name={`type_${index}`} value={probe.type}
+              onChange={e => setProbes(probes.map((p, i) => (i !== index) ? p :
+                { ...p, type: Number(e.target.value) }))}>
+              {typeOptions}
+            </select>
+            <button type="button"
+              onClick={() => setProbes(probes.filter((_, i) => i !== index))}>
+              Remove
+            </button>
+          </p>
+        )}
+        <button type="button" disabled={probes.length >= addrProbeMaxCount}
+          onClick={() => setProbes([...probes,
+          { name: "", type: ProbeSrcType.SRC_FLOAT }])}>
+          Add probe
+        </button>
+        <br />
+        <label>
+          <select name="freq" value={freq}
+            onChange={e => setFreq(Number(e.target.value))}>
+            {Object.entries(SampleFreq).map(([name, value]) =>
+              <option key={name} value={value}>{name}</option>)}
+          </select>
+          freq
+        </label>
+        <br />
+        <button type="submit" disabled={probes.length === 0}>Start Scan</button>
+        <p data-testid="addr-scan-status">{status}</p>
+      </form>
+    </details>
+  );
+}
@@ -1,29 +1,188 @@
 import { useState, useEffect } from "react";
-import {updatePageSize, dataMsgPayloadSizeMax} from "./generated/updatePage"
+import {updatePageSize, dataMsgPayloadSizeMax, updateWindowPages} from "./generated/updatePage"
 import { sendPacked, setMessageHandler } from "./mqclient";
-import { PageStatus, PageStatusEnum, Top } from "./generated/messages";
+import { packPage } from "./pagePack";
+import { PageStatus, PageStatusEnum, PagesPresent, Top } from "./generated/messages";
+
+// The target handles one message per fmt_handleRx() call (1 kHz in the
+// example), so pages in the window are spaced out to not overflow its rx queue.
+const pageSendIntervalMs = 10;
+// Pages in flight this long without any PageStatus are resent.
+const ackTimeoutMs = 2000;
+const allChunks = 0xFFFFFFFF;
+// PageCrcs.crcs max_count in firment_msg.proto
+const crcsPerMsg = 8;
+
+type Resend = { pageIndex: number, chunkMask: number };
+// What is sent of a page: packed (see pagePack.ts) if that is smaller.  crc is
+// of the page as written, for PageCrcs.
+type PagePayload = { data: Uint8Array, packed: boolean, crc: number };
 
 let timeoutId: ReturnType<typeof setTimeout>;
-let activePageIndex = 0;
-let pages: ArrayBuffer[] = [];
+let ackTimeoutId: ReturnType<typeof setTimeout>;
+let paceTimeoutId: ReturnType<typeof setTimeout> | undefined;
+let payloads: PagePayload[] = [];
+let baseBuildId = 0; // of the image a delta patch applies to; 0 for full images.
+let imageId = 0; // PageCrcs.imageId: CRC-32 of the page CRCs.
+let pageAcked: boolean[] = [];
+let nextPageIndex = 0;
+let ackedCount = 0;
+let checkedCount = 0; // pages whose CRCs the target has compared.
+let resends: Resend[] = [];
 
 export default function FWUpdate({ }) {
   const [progress, setProgress] = useState("No upload yet");
   const [image, setImage] = useState(new ArrayBuffer());
 
+  function resetUpload() {
+    payloads = [];
+    baseBuildId = 0;
+    imageId = 0;
+    pageAcked = [];
+    nextPageIndex = 0;
+    ackedCount = 0;
+    checkedCount = 0;
+    resends = [];
+    clearTimeout(timeoutId);
+    clearTimeout(ackTimeoutId);
+    clearTimeout(paceTimeoutId);
+    paceTimeoutId = undefined;
+  }
+
   function handleTimeout() {
-    pages = [];
-    activePageIndex = 0;
-    setProgress("Failed: timeout");
+    resetUpload();
+    setProgress("Failed: timeout.  Send the image again to resume.");
+  }
+
+  /** CRC-32 (IEEE 802.3) of a page padded with erased flash (0xFF). */
+  function pageCrc(bytes: Uint8Array) {
+    let crc = 0xFFFFFFFF;
+    for (const byte of bytes) {
+      crc ^= byte;
+      for (let bit = 0; bit < 8; bit++)
+        crc = (crc & 1) ? (crc >>> 1) ^ 0xEDB88320 : crc >>> 1;
+    }
+    return ~crc >>> 0;
+  }
+
+  /** Identifies the image to the target, so pages it did for another image
+   * of the same size aren't taken as this one's. */
+  function computeImageId() {
+    const crcs = new DataView(new ArrayBuffer(4 * payloads.length));
+    payloads.forEach((payload, i) => crcs.setUint32(4 * i, payload.crc, true));
+    return pageCrc(new Uint8Array(crcs.buffer));
+  }
+
+  /** Asks the target which of the next crcsPerMsg pages it already has.  A
+   * resend (of a PageCrcs left unanswered) doesn't put off handleTimeout(). */
+  function sendPageCrcs(resend = false) {
+    const crcs = payloads.slice(checkedCount, checkedCount + crcsPerMsg)
+      .map(payload => payload.crc);
+    const msg = {
+      PageCrcs: {
+        pageCount: payloads.length,
+        firstPageIndex: checkedCount,
+        crcs,
+        imageId,
+      }
+    };
+    sendPacked([Top.encodeDelimited(msg).finish()]);
+    if (!resend) {
+      clearTimeout(timeoutId);
+      timeoutId = setTimeout(handleTimeout, 30000);
+    }
+    clearTimeout(ackTimeoutId);
+    ackTimeoutId = setTimeout(handleAckTimeout, ackTimeoutMs);
   }
 
-  function sendPage(data: ArrayBuffer, pageIndex: number, pageCount: number) {
-    const chunkCount = Math.ceil(data.byteLength / dataMsgPayloadSizeMax);
+  function handlePagesPresent(message: PagesPresent) {
+    if (payloads.length == 0 || message.firstPageIndex !== checkedCount)
+      return;
+    for (let i = 0; i < crcsPerMsg; i++) {
+      const pageIndex = message.firstPageIndex + i;
+      if ((message.present & (1 << i)) && pageIndex < payloads.length &&
+        !pageAcked[pageIndex]) {
+        pageAcked[pageIndex] = true;
+        ackedCount++;
+      }
+    }
+    checkedCount += crcsPerMsg;
+    if (checkedCount < payloads.length)
+      sendPageCrcs();
+    else
+      startSendingPages();
+  }
+
+  function startSendingPages() {
+    checkedCount = payloads.length;
+    clearTimeout(ackTimeoutId);
+    if (ackedCount === payloads.length) {
+      resetUpload();
+      setProgress("Upload complete: image already on target");
+      return;
+    }
+    if (ackedCount > 0)
+      console.log(`Resuming upload: target has ${ackedCount} pages.`);
+    setProgress(`Upload in progress: ${ackedCount}/${payloads.length}`);
+    sendMorePages();
+  }
+
+  function handleAckTimeout() {
+    if (checkedCount < payloads.length) {
+      // Pages must not be sent until the target has checked them all: it
+      // would ack pages it still has from an abandoned upload.
+      sendPageCrcs(true);
+      return;
+    }
+    for (let pageIndex = 0; pageIndex < nextPageIndex; pageIndex++) {
+      if (!pageAcked[pageIndex])
+        queueResend(pageIndex, allChunks);
+    }
+  }
+
+  function queueResend(pageIndex: number, chunkMask: number) {
+    if (!resends.some(r => r.pageIndex === pageIndex && r.chunkMask === chunkMask))
+      resends.push({ pageIndex, chunkMask });
+    sendMorePages();
+  }
+
+  /** Sends any requested resend, else the next page if fewer than
+   * updateWindowPages are unacked. */
+  function sendMorePages() {
+    if (paceTimeoutId !== undefined)
+      return; // already pacing; this will be called again.
+    while (nextPageIndex < payloads.length && pageAcked[nextPageIndex])
+      nextPageIndex++; // Already on the target.
+    const inFlight = pageAcked.slice(0, nextPageIndex).filter(acked => !acked).length;
+    const resend = resends.shift();
+    if (resend) {
+      if (!pageAcked[resend.pageIndex])
+        sendPage(resend.pageIndex, payloads.length, resend.chunkMask);
+    }
+    else if (nextPageIndex < payloads.length && inFlight < updateWindowPages) {
+      sendPage(nextPageIndex, payloads.length);
+      nextPageIndex++;
+    }
+    else
+      return;
+    paceTimeoutId = setTimeout(() => {
+      paceTimeoutId = undefined;
+      sendMorePages();
+    }, pageSendIntervalMs);
+  }
+
+  /** Sends the chunks of a page whose bits are set in chunkMask. */
+  function sendPage(pageIndex: number, pageCount: number, chunkMask = allChunks) {
+    const { data, packed } = payloads[pageIndex];
+    const pageBaseBuildId = packed ? baseBuildId : 0;
+    const chunkCount = Math.ceil(data.length / dataMsgPayloadSizeMax);
     let dataIdx = 0;
     let messages: Uint8Array[] = [];
     for (let chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++) {
+      if (!(chunkMask & (1 << chunkIndex)))
+        continue;
       dataIdx = chunkIndex * dataMsgPayloadSizeMax;
-      const payload = new Uint8Array(data.slice(dataIdx, dataIdx + dataMsgPayloadSizeMax));
+      const payload = data.slice(dataIdx, dataIdx + dataMsgPayloadSizeMax);
       const msg = {
         ImageData: {
           pageIndex,
@@ -31,67 +190,131 @@ export default function FWUpdate({ }) {
           chunkIndex,
           chunkCountInPage: chunkCount,
           payload,
+          packed,
+          baseBuildId: pageBaseBuildId,
+          imageId,
         }
       }
-      messages[chunkIndex] = Top.encodeDelimited(msg).finish();
+      messages.push(Top.encodeDelimited(msg).finish());
     }
     sendPacked(messages);
     
     clearTimeout(timeoutId);
     timeoutId = setTimeout(handleTimeout, 30000);
+    clearTimeout(ackTimeoutId);
+    ackTimeoutId = setTimeout(handleAckTimeout, ackTimeoutMs);
   }
 
   function updateStatus(message: PageStatus) {
     console.log(`PageStatus. Page ${message.pageIndex}, success: ${message.status}`);
-    if (pages.length == 0)
+    if (payloads.length == 0)
       return
-    if (message.status === PageStatusEnum.WRITE_SUCCESS) {
-      if (message.pageIndex === (pages.length - 1 )) {
-        pages = [];
-        activePageIndex = 0;
-        clearTimeout(timeoutId);
+    clearTimeout(ackTimeoutId);
+    ackTimeoutId = setTimeout(handleAckTimeout, ackTimeoutMs);
+    if (message.status === PageStatusEnum.REQUEST_RESEND) {
+      if (pageAcked[message.pageIndex]) {
+        // The target erased it to clear a sector a resumed upload shares.
+        pageAcked[message.pageIndex] = false;
+        ackedCount--;
+      }
+      queueResend(message.pageIndex, message.missingChunks);
+    }
+    else if (message.status === PageStatusEnum.WRITE_SUCCESS) {
+      if (!pageAcked[message.pageIndex]) {
+        pageAcked[message.pageIndex] = true;
+        ackedCount++;
+      }
+      if (ackedCount === payloads.length) {
+        resetUpload();
         setProgress("Upload complete");
       }
       else {
-        activePageIndex++;
-        sendPage(pages[activePageIndex], activePageIndex, pages.length);
-        setProgress(`Upload in progress: ${activePageIndex}/${pages.length}`);
+        setProgress(`Upload in progress: ${ackedCount}/${payloads.length}`);
+        sendMorePages();
       }
     }
     else {
-      pages = [];
-      activePageIndex = 0;
-      clearTimeout(timeoutId);
+      resetUpload();
       setProgress(`Failed: bad message at page: ${message.pageIndex}`);
     }
   };
 
   useEffect(() => {
     setMessageHandler("PageStatus", updateStatus);
+    setMessageHandler("PagesPresent", handlePagesPresent);
   }, []);
 
-  async function handleSubmit(submitEvent: React.FormEvent) {
-    submitEvent.preventDefault();
+  /** Reads a patch made by tools/make-patch.py.  Throws if it doesn't fit. */
+  function readPatch(patch: ArrayBuffer) {
+    const view = new DataView(patch);
+    baseBuildId = view.getUint32(4, true);
+    const pageSize = view.getUint32(8, true);
+    const pageCount = view.getUint32(12, true);
+    if (pageSize !== updatePageSize)
+      throw new Error(`patch page size ${pageSize} isn't ${updatePageSize}`);
 
-    const imageBytes = new Uint8Array(image);
-    console.log(imageBytes.slice(0, 512));
+    let offset = 16;
+    for (let pageIdx = 0; pageIdx < pageCount; pageIdx++) {
+      const crc = view.getUint32(offset, true);
+      const packed = view.getUint8(offset + 4) !== 0;
+      const size = view.getUint16(offset + 5, true);
+      offset += 7;
+      payloads.push({ data: new Uint8Array(patch, offset, size), packed, crc });
+      offset += size;
+    }
+  }
 
+  function readImage(image: ArrayBuffer) {
     // updatePageSize comes from cmake var 'UPDATE_PAGE_SIZE' in firment CML.
     const pageCount = Math.ceil(image.byteLength / updatePageSize);
-    setProgress(`Upload in progress: 0/${pageCount}`);
-    pages = [];
-    activePageIndex = 0;
-
     for (let pageIdx = 0; pageIdx < pageCount; pageIdx++) {
       const pageStartIdx = pageIdx * updatePageSize;
       // slice won't extend past iterable's length, regardless of param: end. 
-      const pageData = image.slice(pageStartIdx, pageStartIdx + updatePageSize);
-      pages.push(pageData);
+      const pageData = new Uint8Array(
+        image.slice(pageStartIdx, pageStartIdx + updatePageSize));
+
+      // Pages are packed and checked as written: padded with erased flash.
+      const padded = new Uint8Array(updatePageSize).fill(0xFF);
+      padded.set(pageData);
+      const packedData = packPage(padded);
+      const crc = pageCrc(padded);
+      payloads.push(packedData.length < pageData.length ?
+        { data: packedData, packed: true, crc } :
+        { data: pageData, packed: false, crc });
+    }
+  }
+
+  async function handleSubmit(submitEvent: React.FormEvent) {
+    submitEvent.preventDefault();
+
+    const imageBytes = new Uint8Array(image);
+    console.log(imageBytes.slice(0, 512));
+
+    resetUpload();
+    const isPatch = new TextDecoder().decode(imageBytes.slice(0, 4)) === "FMTP";
+    try {
+      if (isPatch)
+        readPatch(image);
+      else
+        readImage(image);
     }
-    // Kick off the first page transfer.
-    sendPage(pages[activePageIndex], activePageIndex, pageCount);
+    catch (e) {
+      resetUpload();
+      setProgress(`Failed: ${e}`);
+      return;
+    }
+    const sentBytes = payloads.reduce((sum, p) => sum + p.data.length, 0);
+    console.log(`${isPatch ? "Delta patch" : "Packed image"}: ` +
+      `${sentBytes} bytes for ${payloads.length} pages`);
+
+    setProgress("Checking which pages the target already has");
+    pageAcked = new Array(payloads.length).fill(false);
+    imageId = computeImageId();
+    // Find out which pages an interrupted upload left on the target first.
+    sendPageCrcs();
   }
 
+
   async function handleFileChange(e: React.ChangeEvent<HTMLInputElement>) {
     e.preventDefault();
     if (e.currentTarget.files) {
@@ -105,8 +328,8 @@ export default function FWUpdate({ }) {
     <details className="widget">
       <summary>FW Update</summary>
     <form aria-label="FW Update" onSubmit={handleSubmit}>
-      <label>Choose an image file<br />
-        <input type="file" name="image-file" accept=".bin"
+      <label>Choose an image file (.bin, or .fmtp delta patch)<br />
+        <input type="file" name="image-file" accept=".bin,.fmtp"
           onChange={handleFileChange} />
       </label>
       <br />
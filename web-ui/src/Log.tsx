@@ -1,5 +1,6 @@
 import { useState, useEffect } from "react";
 import { setMessageHandler } from "./mqclient";
+import { readCString, readElfSection } from "./elfSymbols";
 
 
 interface LogMessage {
@@ -7,17 +8,57 @@ interface LogMessage {
   value: number;
   count: number;
 }
+interface LogFmtMessage {
+  count: number;
+  id: number;
+  level: number;
+  args: number[];
+}
+
+const levelNames = ["VERBOSE", "INFO", "WARN", "ERROR"];
+
+// FMT_LOG format strings, read from the firmware ELF.  Index is the log ID.
+let logStrings: Uint8Array | undefined;
+
+/** printf-style formatting of FMT_LOG's raw 32-bit argument words. */
+export function formatLog(format: string, args: number[]) {
+  let argIndex = 0;
+  const view = new DataView(new ArrayBuffer(4));
+  return format.replace(/%([-+ 0#]*\d*(?:\.(\d+))?)([diuxXfgecp%])/g,
+    (spec, _flags, precision, conversion) => {
+      if (conversion === "%") return "%";
+      if (argIndex >= args.length) return spec;
+      const word = args[argIndex++] >>> 0;
+      view.setUint32(0, word, true);
+      switch (conversion) {
+        case "d":
+        case "i": return String(view.getInt32(0, true));
+        case "u": return String(word);
+        case "x":
+        case "p": return word.toString(16);
+        case "X": return word.toString(16).toUpperCase();
+        case "c": return String.fromCharCode(word & 0xff);
+        case "e": return view.getFloat32(0, true).toExponential(
+          precision ? Number(precision) : 6);
+        case "f": return view.getFloat32(0, true).toFixed(
+          precision ? Number(precision) : 6);
+        default: return String(view.getFloat32(0, true));
+      }
+    });
+}
+
 export function Log({}) {
   const [LogState, setLogState] = useState([{id: 0, text: ""}]);
+  const [dictStatus, setDictStatus] = useState("No ELF: FMT_LOG lines show IDs");
 
-  function appendToLog(newLogMessage: LogMessage) {
+  function appendLine(count: number, text: string) {
     setLogState(prevLogState => {
-      if (newLogMessage.count > prevLogState[prevLogState.length - 1].id)
+      if (count > prevLogState[prevLogState.length - 1].id)
       {
         let newState = prevLogState.slice(Math.max(prevLogState.length - 10, 0));
         newState.push({
-          id: newLogMessage.count,
-          text: newLogMessage.count + "	" + newLogMessage.text + newLogMessage.value
+          id: count,
+          text: count + "	" + text
         });
         return newState;
       } else {
@@ -26,17 +67,52 @@ export function Log({}) {
       }
     });
   }
+
+  function appendToLog(newLogMessage: LogMessage) {
+    appendLine(newLogMessage.count, newLogMessage.text + newLogMessage.value);
+  }
+
+  function appendFmtToLog(message: LogFmtMessage) {
+    const level = levelNames[message.level] ?? message.level;
+    const args = message.args ?? [];
+    const text = (logStrings && message.id < logStrings.length) ?
+      formatLog(readCString(logStrings, message.id), args) :
+      `#${message.id} ${args.map((a) => (a >>> 0).toString(16)).join(" ")}`;
+    appendLine(message.count, `${level} ${text}`);
+  }
+
   useEffect( () => {
     setMessageHandler("Log", appendToLog);
+    setMessageHandler("LogFmt", appendFmtToLog);
   }, []);
 
+  async function handleElfChange(e: React.ChangeEvent<HTMLInputElement>) {
+    e.preventDefault();
+    if (e.currentTarget.files) {
+      try {
+        const elf = await e.currentTarget.files[0].arrayBuffer();
+        logStrings = readElfSection(elf, ".fmt_log_strings");
+        setDictStatus(logStrings ?
+          `${logStrings.length} bytes of log strings` :
+          "No .fmt_log_strings section in this ELF");
+      } catch (err) {
+        setDictStatus(`Failed: ${(err as Error).message}`);
+      }
+    }
+  }
+
   const messages = LogState.map((message) => 
     <p key={message.id}>{message.text}</p>)
 
   return (
     <details className="widget">
       <summary>Log</summary>
+      <label>Firmware ELF for FMT_LOG strings<br />
+        <input type="file" name="log-elf-file" accept=".elf"
+          onChange={handleElfChange} />
+      </label>
+      <p>{dictStatus}</p>
       {messages}
     </details>
   )
-}
\ No newline at end of file
+}
@@ -0,0 +1,117 @@
+import { useState, useEffect } from "react";
+import { ParamInfo, paramTable, paramTableHash } from "./generated/params.pb";
+import { paramValuesMaxCount } from "./generated/paramConfig";
+import { IParamValues, ParamOperation, Top } from "./generated/messages";
+import { sendPacked, setDeviceHandler, setMessageHandler } from "./mqclient";
+
+// ParamValues carries each value as its 32 bits.
+const bits = new DataView(new ArrayBuffer(4));
+
+function toBits(param: ParamInfo, value: number) {
+  if (param.type === "float")
+    bits.setFloat32(0, value, true);
+  else if (param.type === "int")
+    bits.setInt32(0, value, true);
+  else
+    bits.setUint32(0, value, true);
+  return bits.getUint32(0, true);
+}
+
+function fromBits(param: ParamInfo, word: number) {
+  bits.setUint32(0, word, true);
+  if (param.type === "float")
+    return bits.getFloat32(0, true);
+  if (param.type === "int")
+    return bits.getInt32(0, true);
+  return bits.getUint32(0, true);
+}
+
+/** One ParamValues per paramValuesMaxCount parameters, all sent at once. */
+function sendParamValues(operation: ParamOperation, values?: number[]) {
+  const messages: Uint8Array[] = [];
+  for (let firstIndex = 0; firstIndex < paramTable.length;
+    firstIndex += paramValuesMaxCount) {
+    const indices = paramTable.slice(firstIndex, firstIndex + paramValuesMaxCount)
+      .map((_, i) => firstIndex + i);
+    const msg = {
+      ParamValues: {
+        operation,
+        tableHash: paramTableHash,
+        firstIndex,
+        values: values ? indices.map(i => toBits(paramTable[i], values[i])) : [],
+      }
+    };
+    messages.push(Top.encodeDelimited(msg).finish());
+  }
+  sendPacked(messages);
+}
+
+export default function Params({ }) {
+  // undefined until read from the target.
+  const [values, setValues] = useState<(number | undefined)[]>(
+    paramTable.map(() => undefined));
+  const [edits, setEdits] = useState<{ [index: number]: string }>({});
+  const [status, setStatus] = useState("Not loaded");
+
+  function handleParamValues(msg: IParamValues) {
+    if (msg.tableHash !== paramTableHash) {
+      setStatus("Target was built with another Params table");
+      return;
+    }
+    const firstIndex = msg.firstIndex ?? 0;
+    const words = msg.values ?? [];
+    setValues(prev => prev.map((value, i) =>
+      (i >= firstIndex && i < firstIndex + words.length) ?
+        fromBits(paramTable[i], words[i - firstIndex]) : value));
+    setStatus("Loaded");
+  }
+
+  function load() {
+    setStatus("Loading");
+    sendParamValues(ParamOperation.GET);
+  }
+
+  useEffect(() => {
+    setMessageHandler("ParamValues", handleParamValues);
+    return setDeviceHandler(load);
+  }, []);
+
+  function handleSubmit(e: React.FormEvent) {
+    e.preventDefault();
+    // Save is only enabled once every value has been loaded.
+    const toWrite = paramTable.map((_, i) =>
+      (i in edits) ? Number(edits[i]) : values[i] as number);
+    sendParamValues(ParamOperation.SET, toWrite);
+    setEdits({});
+    setStatus("Saving");
+  }
+
+  const rows = paramTable.map((param, i) => {
+    const step = param.type === "float" ? "any" : "1";
+    const shown = (i in edits) ? edits[i] : (values[i] ?? "");
+    return (
+      <label key={param.id}>
+        <input className="field" type="number" size={8} step={step}
+          min={isFinite(param.min) ? param.min : undefined}
+          max={isFinite(param.max) ? param.max : undefined}
+          value={shown} name={param.name}
+          onChange={e => setEdits({ ...edits, [i]: e.target.value })} />
+        {param.name} [{param.min}, {param.max}]
+        <br />
+      </label>
+    );
+  });
+
+  return (
+    <details className="widget">
+      <summary>Params</summary>
+      <form aria-label="Params" onSubmit={handleSubmit}>
+        {rows}
+        <button type="button" onClick={load}>Load</button>
+        <button type="submit"
+          disabled={values.some(value => value === undefined)}>Save</button>
+      </form>
+      <p data-testid="params-status">{status}</p>
+    </details>
+  );
+}
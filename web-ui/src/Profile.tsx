@@ -0,0 +1,76 @@
+import { useState, useEffect } from "react";
+import { setMessageHandler } from "./mqclient";
+
+
+interface ProfileTlm {
+  name: string;
+  count: number;
+  minCycles: number;
+  maxCycles: number;
+  meanCycles: number;
+  histogram: Uint8Array;
+  cyclesPerUs: number;
+}
+
+// Bins as in fmt_profile.h: bin 0 is under 2^7 cycles, each after it twice as
+// long, and the last holds every longer run.
+const BIN0_BITS = 7;
+
+function binLabel(bin: number, binCount: number) {
+  const lower = bin === 0 ? 0 : 2 ** (BIN0_BITS + bin - 1);
+  return (bin === binCount - 1) ? `${lower}+ cycles` :
+    `${lower}-${2 ** (BIN0_BITS + bin) - 1} cycles`;
+}
+
+function us(cycles: number, cyclesPerUs: number) {
+  return cyclesPerUs ? (cycles / cyclesPerUs).toFixed(2) : "-";
+}
+
+/** Run times of each profiled site, as of the last ProfileTlm it sent. */
+export default function Profile({ }) {
+  const [sites, setSites] = useState<Record<string, ProfileTlm>>({});
+
+  useEffect(() => {
+    setMessageHandler("ProfileTlm", (tlm: ProfileTlm) =>
+      setSites(prevSites => ({ ...prevSites, [tlm.name]: tlm })));
+  }, []);
+
+  const rows = Object.values(sites)
+    .sort((a, b) => a.name.localeCompare(b.name))
+    .map(site => {
+      const histogram = Array.from(site.histogram ?? []);
+      return (
+        <tr key={site.name}>
+          <td>{site.name}</td>
+          <td>{site.count}</td>
+          <td>{us(site.minCycles, site.cyclesPerUs)}</td>
+          <td>{us(site.meanCycles, site.cyclesPerUs)}</td>
+          <td>{us(site.maxCycles, site.cyclesPerUs)}</td>
+          <td>
+            <div className="histogram">
+              {histogram.map((share, bin) =>
+                <div key={bin} className="histogram-bar"
+                  title={`${binLabel(bin, histogram.length)}: ` +
+                    `${(share * 100 / 255).toFixed(0)}%`}
+                  style={{ height: `${share * 100 / 255}%` }} />)}
+            </div>
+          </td>
+        </tr>
+      );
+    });
+
+  return (
+    <details className="widget">
+      <summary>Profile</summary>
+      <table aria-label="Profile">
+        <thead>
+          <tr>
+            <th>Site</th><th>Runs</th>
+            <th>Min us</th><th>Mean us</th><th>Max us</th><th>Histogram</th>
+          </tr>
+        </thead>
+        <tbody>{rows}</tbody>
+      </table>
+    </details>
+  );
+}
@@ -0,0 +1,79 @@
+import { useState } from "react";
+import { dataMsgPayloadSizeMax } from "./generated/updatePage";
+import { sendPacked } from "./mqclient";
+import { Top } from "./generated/messages";
+
+// Payloads carry whole int16 samples.
+const samplesPerChunk = Math.floor(dataMsgPayloadSizeMax / 2);
+// Like FWUpdate pages: keep each burst within the target's receive queue.
+const chunksPerBurst = 8;
+const burstIntervalMs = 100;
+
+/** Parses samples in [-1, 1], separated by commas or whitespace, into Q15. */
+function toQ15(text: string) {
+  const values = text.split(/[\s,]+/).filter((s) => s.length).map(Number);
+  if (values.some(isNaN)) throw new Error("non-numeric sample");
+  return Int16Array.from(values, (v) =>
+    Math.max(-32768, Math.min(32767, Math.round(v * 32768))));
+}
+
+export default function WaveTable({ }) {
+  const [waveId, setWaveId] = useState(0);
+  const [samples, setSamples] = useState(new Int16Array());
+  const [status, setStatus] = useState("No table loaded");
+
+  async function handleFileChange(e: React.ChangeEvent<HTMLInputElement>) {
+    e.preventDefault();
+    if (e.currentTarget.files) {
+      try {
+        const parsed = toQ15(await e.currentTarget.files[0].text());
+        setSamples(parsed);
+        setStatus(`${parsed.length} samples ready`);
+      } catch (err) {
+        setStatus(`Failed: ${(err as Error).message}`);
+      }
+    }
+  }
+
+  function handleSubmit(e: React.FormEvent) {
+    e.preventDefault();
+    const chunkCount = Math.ceil(samples.length / samplesPerChunk);
+    let messages: Uint8Array[] = [];
+    for (let chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++) {
+      const start = chunkIndex * samplesPerChunk;
+      const chunk = samples.slice(start, start + samplesPerChunk);
+      // Int16Array is little-endian on every platform browsers run on.
+      const payload = new Uint8Array(chunk.buffer);
+      messages.push(Top.encodeDelimited(
+        { WaveTable: { waveId, chunkIndex, chunkCount, payload } }).finish());
+    }
+    for (let burst = 0; burst * chunksPerBurst < chunkCount; burst++) {
+      const start = burst * chunksPerBurst;
+      setTimeout(() => sendPacked(messages.slice(start, start + chunksPerBurst)),
+        burst * burstIntervalMs);
+    }
+    setStatus(`Sent ${samples.length} samples to wave ${waveId}`);
+  }
+
+  return (
+    <details className="widget">
+      <summary>Wave Table</summary>
+      <form aria-label="Wave Table" onSubmit={handleSubmit}>
+        <label>Samples in [-1, 1] (.csv or .txt)<br />
+          <input type="file" name="table-file" accept=".csv,.txt"
+            onChange={handleFileChange} />
+        </label>
+        <br />
+        <label>
+          <input className="field" type="number" size={5} step="1" min="0"
+            value={waveId} name="waveId"
+            onChange={e => setWaveId(Number(e.target.value))} />
+          waveId
+        </label>
+        <br />
+        <button type="submit" disabled={samples.length === 0}>Send Table</button>
+        <p data-testid="wave-table-status">{status}</p>
+      </form>
+    </details>
+  );
+}
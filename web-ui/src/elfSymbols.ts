@@ -0,0 +1,91 @@
+/** Minimal ELF32 (little-endian) reader.
+ * 
+ * Only what the UI needs from a firmware image:
+ * - Ghost Probe turns variable names into RAM addresses with the data objects
+ *   (STT_OBJECT) from .symtab.
+ * - Log reads FMT_LOG format strings from the unloaded .fmt_log_strings.
+ */
+
+export interface ElfSymbol {
+  name: string;
+  address: number;
+  size: number;
+};
+
+const SHT_SYMTAB = 2;
+const STT_OBJECT = 1;
+const SYMBOL_SIZE = 16;
+const SECTION_HEADER_SIZE = 40;
+
+// Throws if the file is not a little-endian ELF32 image (ARM Cortex-M builds).
+function readSectionHeaders(elf: ArrayBuffer) {
+  const view = new DataView(elf);
+  const isElf = view.byteLength > 52 && view.getUint32(0, false) === 0x7f454c46;
+  if (!isElf || view.getUint8(4) !== 1 || view.getUint8(5) !== 1) {
+    throw new Error("Not a little-endian ELF32 file");
+  }
+
+  const shOffset = view.getUint32(32, true);
+  const shCount = view.getUint16(48, true);
+  const shStrIndex = view.getUint16(50, true);
+  const section = (index: number) => {
+    const base = shOffset + index * SECTION_HEADER_SIZE;
+    return {
+      nameOffset: view.getUint32(base, true),
+      type: view.getUint32(base + 4, true),
+      offset: view.getUint32(base + 16, true),
+      size: view.getUint32(base + 20, true),
+      link: view.getUint32(base + 24, true),
+    };
+  };
+  return { view, shCount, shStrIndex, section };
+}
+
+/** Returns the null-terminated string at start, e.g. an offset into a section
+ * returned by readElfSection(). */
+export function readCString(bytes: Uint8Array, start: number) {
+  let end = start;
+  while (end < bytes.length && bytes[end] !== 0) end++;
+  return new TextDecoder().decode(bytes.subarray(start, end));
+}
+
+/** Returns the contents of the named section, or undefined if absent. */
+export function readElfSection(elf: ArrayBuffer, name: string) {
+  const { shCount, shStrIndex, section } = readSectionHeaders(elf);
+  const bytes = new Uint8Array(elf);
+  const names = section(shStrIndex);
+  for (let index = 0; index < shCount; index++) {
+    const candidate = section(index);
+    if (readCString(bytes, names.offset + candidate.nameOffset) === name) {
+      return bytes.slice(candidate.offset, candidate.offset + candidate.size);
+    }
+  }
+  return undefined;
+}
+
+/** Returns the data symbols in the file, sorted by name. */
+export function readElfSymbols(elf: ArrayBuffer): ElfSymbol[] {
+  const { view, shCount, section } = readSectionHeaders(elf);
+  const bytes = new Uint8Array(elf);
+  let symbols: ElfSymbol[] = [];
+
+  for (let index = 0; index < shCount; index++) {
+    const symtab = section(index);
+    if (symtab.type !== SHT_SYMTAB) continue;
+    const strtab = section(symtab.link);
+
+    for (let pos = symtab.offset; pos < symtab.offset + symtab.size;
+      pos += SYMBOL_SIZE) {
+      const info = view.getUint8(pos + 12);
+      const size = view.getUint32(pos + 8, true);
+      if ((info & 0xf) !== STT_OBJECT || size === 0) continue;
+
+      symbols.push({
+        name: readCString(bytes, strtab.offset + view.getUint32(pos, true)),
+        address: view.getUint32(pos + 4, true),
+        size,
+      });
+    }
+  }
+  return symbols.sort((a, b) => a.name.localeCompare(b.name));
+}
@@ -0,0 +1,2 @@
+const paramValuesMaxCount = 10;
+export {paramValuesMaxCount};
@@ -0,0 +1,2 @@
+const addrProbeMaxCount = 8;
+export {addrProbeMaxCount};
@@ -0,0 +1,4 @@
+const dataMsgPayloadSizeMax = 32;
+const updatePageSize = 256;
+const updateWindowPages = 4;
+export {dataMsgPayloadSizeMax, updatePageSize, updateWindowPages};
@@ -1,13 +1,17 @@
+import AddrScan from './AddrScan';
 import BrokerAddress from './BrokerAddress'
 import FWUpdate from './FWUpdate'
 import Plot from './plot/Plot';
 import { Log } from './Log';
+import Params from './Params';
+import Profile from './Profile';
 import Reset from './Reset';
 import Version from './Version';
+import WaveTable from './WaveTable';
 import * as widgets from './generated/widgets.pb';
 import { setMessageHandler, sendMessage } from './mqclient';
 
 export {
-  BrokerAddress, FWUpdate, Plot, Log, Reset, Version, widgets,
+  AddrScan, BrokerAddress, FWUpdate, Plot, Log, Params, Profile, Reset, Version, WaveTable, widgets,
   setMessageHandler, sendMessage
 };
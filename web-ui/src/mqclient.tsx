@@ -9,6 +9,7 @@ let client: MqttClient;
  * which will be the same as the name of a widget.  That lets us call the 
  * right widget's setState function, passing it that message's data.*/
 let messageHandlers: { [index: string]: ({ }) => void } = {}
+let deviceHandlers: (() => void)[] = [];
 let ranOnce = false;
 let activeTopicPrefix = "";
 
@@ -109,6 +110,13 @@ export function setMessageHandler(messageName: string, callback: MessageHandler)
   return () => { delete messageHandlers[messageName]; }
 }
 
+/** Registers a callback for when a device has been selected and its messages
+ * subscribed to, eg. to read state from the device.  Returns its remover. */
+export function setDeviceHandler(callback: () => void) {
+  deviceHandlers.push(callback);
+  return () => { deviceHandlers = deviceHandlers.filter(h => h !== callback); }
+}
+
 export function sendMessage(message_name: string, state_obj: object, verbose = true) {
   let message = { [message_name]: state_obj }
   const packet: Uint8Array = pb.Top.encodeDelimited(message).finish();
@@ -126,6 +134,7 @@ export function selectDevice(topicPrefix: string) {
   client.subscribe(newHqBound, (err) => {
     if (!err) {
       console.log(`Subscribed to ${newHqBound}`);
+      deviceHandlers.forEach(handler => handler());
     }
     else { console.error(`Failed to subscribe to ${newHqBound}`); }
   });
@@ -0,0 +1,60 @@
+/** Packer for the fmt_unpack.h page format.
+ *
+ * Byte-aligned LZ77: a control byte c < 0x80 is followed by a literal run of
+ * c + 1 bytes; 0x80 <= c < 0xC0 is followed by (distance - 1) and copies
+ * (c & 0x3F) + 3 bytes from distance bytes back in the output.  Base copies
+ * (c >= 0xC0) are only made by tools/make-patch.py.  Each page is packed on
+ * its own so pages can still be sent, resent and written in any order.
+ */
+
+const MATCH_MIN = 3;
+const MATCH_MAX = 0x3F + MATCH_MIN;
+const DISTANCE_MAX = 256;
+const LITERAL_RUN_MAX = 0x80;
+
+// Greedy longest match.  Pages are small, so brute force is fast enough.
+function longestMatch(data: Uint8Array, pos: number) {
+  let bestLen = 0;
+  let bestDistance = 0;
+  const maxLen = Math.min(MATCH_MAX, data.length - pos);
+  for (let distance = 1; distance <= Math.min(DISTANCE_MAX, pos); distance++) {
+    let len = 0;
+    // The match may run into the bytes it produces, as the decoder allows.
+    while (len < maxLen && data[pos + len] === data[pos - distance + len])
+      len++;
+    if (len > bestLen) {
+      bestLen = len;
+      bestDistance = distance;
+      if (len === maxLen)
+        break;
+    }
+  }
+  return { len: bestLen, distance: bestDistance };
+}
+
+export function packPage(data: Uint8Array) {
+  const out: number[] = [];
+  let literalStart = 0;
+
+  function flushLiterals(end: number) {
+    for (let start = literalStart; start < end; start += LITERAL_RUN_MAX) {
+      const runLen = Math.min(LITERAL_RUN_MAX, end - start);
+      out.push(runLen - 1, ...data.subarray(start, start + runLen));
+    }
+  }
+
+  let pos = 0;
+  while (pos < data.length) {
+    const match = longestMatch(data, pos);
+    if (match.len >= MATCH_MIN) {
+      flushLiterals(pos);
+      out.push(0x80 | (match.len - MATCH_MIN), match.distance - 1);
+      pos += match.len;
+      literalStart = pos;
+    }
+    else
+      pos++;
+  }
+  flushLiterals(pos);
+  return new Uint8Array(out);
+}
@@ -10,6 +10,8 @@ type ProbeSignal = {  // candidate rename: ProbeSample
 };
 type ProbeSignals = { // SampleSet
   probeSignals: ProbeSignal[];
+  remaining?: number; // signals of this sample still to come in later msgs.
+  first?: number;     // index in the sample of this msg's first signal.
 };
 export interface Trace {
   testPointId: number;
@@ -27,31 +29,58 @@ export interface Record {
 
 let data: Trace[][] = [];
 let lastSignals: ProbeSignal[] = [];
+let partialSignals: ProbeSignal[] = [];
+// Address probes all arrive as DISCONNECTED; they're named by their position.
+let addrProbeNames: string[] = [];
+
+/** Names the signals of an address scan, in the order the addresses were sent.
+ * Always starts a new record, since a new set of addresses keeps the same ids. */
+export function setAddrProbeNames(names: string[]) {
+  addrProbeNames = names;
+  lastSignals = [];
+}
 
 
 export function handleProbeSignals(signals: ProbeSignals) {
-  if (signals.probeSignals.length === 0) return;
+  // Scans with many probes arrive split over several messages. Collect them
+  // until the last part of the sample (remaining == 0) has arrived.  A part
+  // that doesn't start where the last one ended means one was lost: drop the
+  // sample rather than shift every trace after the gap.
+  const first = signals.first ?? 0;
+  if (first === 0)
+    partialSignals = [];
+  else if (first !== partialSignals.length) {
+    partialSignals = [];
+    return;
+  }
+  partialSignals = partialSignals.concat(signals.probeSignals);
+  if (signals.remaining) return;
+  const sample = partialSignals;
+  partialSignals = [];
+
+  if (sample.length === 0) return;
 
   const idsSame =
-    (signals.probeSignals.length == lastSignals.length) &&
-    signals.probeSignals.reduce((accum, signal, index) =>
+    (sample.length == lastSignals.length) &&
+    sample.reduce((accum, signal, index) =>
       accum && (signal.id == lastSignals[index].id), true);
 
-  lastSignals = signals.probeSignals;
+  lastSignals = sample;
 
   // If probes->signals routing has changed, start new data row.
   if (!idsSame) {
-    const newRecord = signals.probeSignals.map((signal) => (
+    const newRecord = sample.map((signal, index) => (
       {
         testPointId: signal.id,
-        testPointName: TestPointId[signal.id],
+        testPointName: (signal.id === TestPointId.DISCONNECTED) ?
+          (addrProbeNames[index] ?? `addr_${index}`) : TestPointId[signal.id],
         data: [],
       }
     ));
     data.push(newRecord);
     console.log("newRecord: ", newRecord);
   }
-  signals.probeSignals.forEach((signal, index) => {
+  sample.forEach((signal, index) => {
     data[data.length - 1][index].data.push(signal.value);
   })
 }